@@ -0,0 +1,66 @@
+#include "access_heatmap.h"
+
+namespace E6502 {
+
+	AccessHeatmap::AccessHeatmap(bool perAddress) {
+		if (perAddress) addressCounts.resize(MAX_MEM);
+	}
+
+	/* Counts for <address>, all zero unless counting per address */
+	AccessCounts AccessHeatmap::address(Word address) const {
+		return addressCounts.empty() ? AccessCounts() : addressCounts[address];
+	}
+
+	/* Zeroes every count */
+	void AccessHeatmap::clear() {
+		for (AccessCounts& counts : pageCounts)
+			counts = AccessCounts();
+		for (AccessCounts& counts : addressCounts)
+			counts = AccessCounts();
+	}
+
+	static bool touched(const AccessCounts& counts) {
+		return counts.reads != 0 || counts.writes != 0 || counts.fetches != 0;
+	}
+
+	void AccessHeatmap::writeRow(FILE* out, Word address, const AccessCounts& counts) {
+		fprintf(out, "$%04X,%llu,%llu,%llu\n", address, (unsigned long long)counts.reads,
+			(unsigned long long)counts.writes, (unsigned long long)counts.fetches);
+	}
+
+	void AccessHeatmap::writeObject(FILE* out, const char* key, Word address, const AccessCounts& counts) {
+		fprintf(out, "{\"%s\":%u,\"reads\":%llu,\"writes\":%llu,\"fetches\":%llu}", key, address,
+			(unsigned long long)counts.reads, (unsigned long long)counts.writes, (unsigned long long)counts.fetches);
+	}
+
+	/* Writes a CSV row for each page, or each address touched */
+	void AccessHeatmap::writeCSV(FILE* out, bool addresses) const {
+		fputs("address,reads,writes,fetches\n", out);
+		if (addresses) {
+			for (size_t address = 0; address < addressCounts.size(); address++)
+				if (touched(addressCounts[address])) writeRow(out, (Word)address, addressCounts[address]);
+		}
+		else {
+			for (int page = 0; page < 0x100; page++)
+				writeRow(out, (Word)(page << 8), pageCounts[page]);
+		}
+	}
+
+	/* Writes every page and each address touched as JSON */
+	void AccessHeatmap::writeJSON(FILE* out) const {
+		fputs("{\"pages\":[", out);
+		for (int page = 0; page < 0x100; page++) {
+			if (page != 0) fputc(',', out);
+			writeObject(out, "page", (Word)page, pageCounts[page]);
+		}
+		fputs("],\"addresses\":[", out);
+		bool first = true;
+		for (size_t address = 0; address < addressCounts.size(); address++) {
+			if (!touched(addressCounts[address])) continue;
+			if (!first) fputc(',', out);
+			writeObject(out, "address", (Word)address, addressCounts[address]);
+			first = false;
+		}
+		fputs("]}\n", out);
+	}
+}
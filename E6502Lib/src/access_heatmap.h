@@ -0,0 +1,72 @@
+#pragma once
+#include <stdio.h>
+#include <vector>
+#include "types.h"
+#include "memory.h"
+
+namespace E6502 {
+
+	/* How often a page or address was touched */
+	struct AccessCounts {
+		u64 reads = 0;			// Data reads, including stack pulls and vector reads
+		u64 writes = 0;			// Data writes, including stack pushes
+		u64 fetches = 0;		// Opcode and operand bytes read through the PC
+	};
+
+	/**
+	 * Counts the bus accesses the CPU makes, per 256 byte page and optionally per address (attach with
+	 * CPUInternal::setAccessHeatmap). Shows which pages are worth a fast path and how hard guest code works the
+	 * zero page and stack.
+	 *
+	 * Accesses are counted as the CPU makes them, so a read-modify-write instruction counts a read and a write of
+	 * its operand. Per address counts take 1.5MB, so they are only kept when asked for.
+	 */
+	class AccessHeatmap {
+	private:
+		AccessCounts pageCounts[0x100];
+		std::vector<AccessCounts> addressCounts;		// Empty unless counting per address
+
+		/* Writes one CSV row */
+		static void writeRow(FILE* out, Word address, const AccessCounts& counts);
+
+		/* Writes one JSON object */
+		static void writeObject(FILE* out, const char* key, Word address, const AccessCounts& counts);
+
+	public:
+		/* Counts per page, and per address if <perAddress> */
+		AccessHeatmap(bool perAddress = false);
+
+		void read(Word address) {
+			pageCounts[address >> 8].reads++;
+			if (!addressCounts.empty()) addressCounts[address].reads++;
+		}
+
+		void write(Word address) {
+			pageCounts[address >> 8].writes++;
+			if (!addressCounts.empty()) addressCounts[address].writes++;
+		}
+
+		void fetch(Word address) {
+			pageCounts[address >> 8].fetches++;
+			if (!addressCounts.empty()) addressCounts[address].fetches++;
+		}
+
+		/* Counts for <page> */
+		const AccessCounts& page(Byte page) const { return pageCounts[page]; }
+
+		/* Counts for <address>, all zero unless counting per address */
+		AccessCounts address(Word address) const;
+
+		/* True if counting per address */
+		bool hasAddresses() const { return !addressCounts.empty(); }
+
+		/* Zeroes every count */
+		void clear();
+
+		/* Writes "address,reads,writes,fetches" rows for each page (addresses as $xx00), or each address touched if <addresses> */
+		void writeCSV(FILE* out, bool addresses = false) const;
+
+		/* Writes {"pages":[...], "addresses":[...]} - every page and, when counting per address, each address touched */
+		void writeJSON(FILE* out) const;
+	};
+}
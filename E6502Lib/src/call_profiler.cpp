@@ -0,0 +1,127 @@
+#include <algorithm>
+#include "call_profiler.h"
+#include "cpu.h"
+#include "symbol_table.h"
+
+namespace E6502 {
+
+	CallProfiler::CallProfiler(CPUInternal* cpu) : cpu(cpu) {}
+
+	CallProfiler::~CallProfiler() {
+		if (!stack.empty()) finish();
+	}
+
+	/* Clears any previous profile and attaches to the CPU */
+	void CallProfiler::start() {
+		nodes.clear();
+		childIndex.clear();
+		stack.clear();
+		Node root = { 0, false, 0, 1, 0, 0 };
+		nodes.push_back(root);
+		Frame frame = { 0, 0, cpu->getCycles(), 0 };
+		stack.push_back(frame);
+		cpu->setCallProfiler(this);
+	}
+
+	/* Detaches from the CPU, charging frames still open up to the current cycle */
+	void CallProfiler::finish() {
+		cpu->setCallProfiler(nullptr);
+		u64 cycle = cpu->getCycles();
+		while (!stack.empty())
+			leave(cycle);
+	}
+
+	/* Opens a frame for <address>, the return address is just above <sp> */
+	void CallProfiler::enter(Word address, Byte sp, Byte pushed, u64 cycle, bool interrupt) {
+		// The stack pointer before the push - frames above it have lost their return address
+		unwind((Byte)(sp + pushed), cycle);
+
+		u32 parent = stack.back().node;
+		u64 key = ((u64)parent << 17) | ((u64)interrupt << 16) | address;
+		std::unordered_map<u64, u32>::iterator found = childIndex.find(key);
+		u32 node;
+		if (found == childIndex.end()) {
+			node = (u32)nodes.size();
+			Node added = { address, interrupt, parent, 0, 0, 0 };
+			nodes.push_back(added);
+			childIndex[key] = node;
+		}
+		else {
+			node = found->second;
+		}
+		nodes[node].calls++;
+		Frame frame = { node, sp, cycle, 0 };
+		stack.push_back(frame);
+	}
+
+	/* Closes every frame whose return address is no longer on the stack */
+	void CallProfiler::unwind(Byte sp, u64 cycle) {
+		while (stack.size() > 1 && stack.back().sp < sp)
+			leave(cycle);
+	}
+
+	/* Closes the newest frame */
+	void CallProfiler::leave(u64 cycle) {
+		Frame& frame = stack.back();
+		u64 inclusive = cycle - frame.entered;
+		Node& node = nodes[frame.node];
+		node.inclusive += inclusive;
+		node.exclusive += inclusive - frame.children;
+		stack.pop_back();
+		if (!stack.empty())
+			stack.back().children += inclusive;
+	}
+
+	/* Totals for each subroutine and interrupt handler called */
+	std::vector<FunctionProfile> CallProfiler::functions() const {
+		std::vector<FunctionProfile> result;
+		std::unordered_map<u32, size_t> index;		// (interrupt, address) to result
+		for (size_t i = 1; i < nodes.size(); i++) {
+			const Node& node = nodes[i];
+			u32 key = ((u32)node.interrupt << 16) | node.address;
+			std::unordered_map<u32, size_t>::iterator found = index.find(key);
+			if (found == index.end()) {
+				FunctionProfile added = { node.address, node.interrupt, 0, 0, 0 };
+				found = index.insert(std::make_pair(key, result.size())).first;
+				result.push_back(added);
+			}
+			FunctionProfile& function = result[found->second];
+			function.calls += node.calls;
+			function.exclusive += node.exclusive;
+
+			// A recursive call's cycles are already in the outer call's
+			bool recursive = false;
+			for (u32 parent = node.parent; parent != 0 && !recursive; parent = nodes[parent].parent)
+				recursive = nodes[parent].address == node.address && nodes[parent].interrupt == node.interrupt;
+			if (!recursive) function.inclusive += node.inclusive;
+		}
+		std::sort(result.begin(), result.end(), [](const FunctionProfile& a, const FunctionProfile& b) {
+			return a.inclusive != b.inclusive ? a.inclusive > b.inclusive : a.address < b.address;
+		});
+		return result;
+	}
+
+	/* Name of a node for folded stacks */
+	void CallProfiler::writeName(FILE* out, const Node& node, const SymbolTable* symbols) {
+		if (node.interrupt) fputs("irq ", out);
+		if (symbols != nullptr) fputs(symbols->symbolize(node.address).c_str(), out);
+		else fprintf(out, "$%04X", node.address);
+	}
+
+	/* Writes the exclusive cycles of every call path in folded stack format */
+	void CallProfiler::writeFolded(FILE* out, const SymbolTable* symbols) const {
+		std::vector<u32> path;
+		for (size_t i = 0; i < nodes.size(); i++) {
+			if (nodes[i].exclusive == 0) continue;
+			path.clear();
+			for (u32 node = (u32)i; node != 0; node = nodes[node].parent)
+				path.push_back(node);
+			fputs("root", out);
+			for (size_t j = path.size(); j-- > 0;) {
+				fputc(';', out);
+				writeName(out, nodes[path[j]], symbols);
+			}
+			fprintf(out, " %llu\n", (unsigned long long)nodes[i].exclusive);
+		}
+	}
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include <stdio.h>
+#include <unordered_map>
+#include <vector>
+#include "types.h"
+
+namespace E6502 {
+
+	class CPUInternal;
+	class SymbolTable;
+
+	/* Cycles spent in one subroutine or interrupt handler, over every path it was reached by */
+	struct FunctionProfile {
+		Word address;			// Entry point
+		bool interrupt;			// Entered by an IRQ rather than JSR
+		u64 calls;
+		u64 inclusive;			// Cycles from entry to return, counted once for recursive calls
+		u64 exclusive;			// Inclusive cycles less those of anything it called (or was interrupted by)
+	};
+
+	/**
+	 * Call graph profiler. Keeps a shadow of the guest's call stack from JSR, RTS, IRQ entry and RTI and charges
+	 * the cycles between them to the subroutines running, building a tree of every call path seen.
+	 *
+	 * Each frame remembers the stack pointer just below its return address. Any return or call made with the
+	 * stack pointer above that has discarded the return address, so the frame is closed - this keeps the shadow
+	 * stack right when guest code returns from several levels at once, pulls its return address to jump through
+	 * it, or resets the stack.
+	 *
+	 * The CPU only checks for a profiler once an instruction, nothing else is done until start() attaches it.
+	 * Cycles are charged to a frame from the end of the instruction that entered it to the end of the one that
+	 * left it, so the call itself is the caller's and the return the callee's.
+	 */
+	class CallProfiler {
+	private:
+		struct Node {
+			Word address;
+			bool interrupt;
+			u32 parent;
+			u64 calls;
+			u64 inclusive;
+			u64 exclusive;
+		};
+
+		struct Frame {
+			u32 node;
+			Byte sp;			// Stack pointer after the return address was pushed
+			u64 entered;		// Cycle the frame started
+			u64 children;		// Cycles of the frames it called
+		};
+
+		CPUInternal* cpu;
+		std::vector<Node> nodes;						// Node 0 is the code running when profiling started
+		std::unordered_map<u64, u32> childIndex;		// (parent, interrupt, address) to node
+		std::vector<Frame> stack;
+
+		/* Opens a frame for <address>, the return address is just above <sp> */
+		void enter(Word address, Byte sp, Byte pushed, u64 cycle, bool interrupt);
+
+		/* Closes every frame whose return address is no longer on the stack with the stack pointer at <sp> */
+		void unwind(Byte sp, u64 cycle);
+
+		/* Closes the newest frame */
+		void leave(u64 cycle);
+
+		/* Name of a node for folded stacks */
+		static void writeName(FILE* out, const Node& node, const SymbolTable* symbols);
+
+	public:
+		constexpr static Byte OPCODE_JSR = 0x20;
+		constexpr static Byte OPCODE_RTS = 0x60;
+		constexpr static Byte OPCODE_RTI = 0x40;
+
+		/* Profiles <cpu> once started */
+		CallProfiler(CPUInternal* cpu);
+
+		/* Detaches from the CPU if still attached */
+		~CallProfiler();
+
+		CallProfiler(const CallProfiler&) = delete;
+		CallProfiler& operator=(const CallProfiler&) = delete;
+
+		/* Clears any previous profile and attaches to the CPU */
+		void start();
+
+		/* Detaches from the CPU, charging frames still open up to the current cycle */
+		void finish();
+
+		/* Called by the CPU after each instruction with the registers it left and the cycle it ended on */
+		void instruction(Byte opcode, const CPUState& regs, u64 cycle) {
+			if (opcode == OPCODE_JSR) enter(regs.PC, regs.SP, 2, cycle, false);
+			else if (opcode == OPCODE_RTS || opcode == OPCODE_RTI) unwind(regs.SP, cycle);
+		}
+
+		/* Called by the CPU after taking an IRQ */
+		void interrupt(const CPUState& regs, u64 cycle) {
+			enter(regs.PC, regs.SP, 3, cycle, true);
+		}
+
+		/* Frames currently open, not counting the code profiling started in */
+		size_t depth() const { return stack.empty() ? 0 : stack.size() - 1; }
+
+		/* Entry point of the innermost subroutine or handler running, -1 in the code profiling started in */
+		s32 current() const { return stack.size() > 1 ? nodes[stack.back().node].address : -1; }
+
+		/* Totals for each subroutine and interrupt handler called, most inclusive cycles first (after finish()) */
+		std::vector<FunctionProfile> functions() const;
+
+		/**
+		 * Writes the exclusive cycles of every call path in folded stack format (one "root;$C000;$C123 1234" line
+		 * a path), ready for flamegraph.pl or speedscope. Interrupt handlers are shown as "irq $xxxx". Entry points
+		 * are named from <symbols> when given.
+		 */
+		void writeFolded(FILE* out, const SymbolTable* symbols = nullptr) const;
+	};
+}
@@ -0,0 +1,101 @@
+#include <bitset>
+#include <ctype.h>
+#include "coverage.h"
+
+namespace E6502 {
+
+	static u32 countBits(const u64* bits, size_t words) {
+		u32 count = 0;
+		for (size_t i = 0; i < words; i++)
+			count += (u32)std::bitset<64>(bits[i]).count();
+		return count;
+	}
+
+	/* Number of addresses an instruction started at */
+	u32 Coverage::addressCount() const {
+		return countBits(addressBits, sizeof(addressBits) / sizeof(addressBits[0]));
+	}
+
+	/* Number of opcodes that ran */
+	u32 Coverage::opcodeCount() const {
+		return countBits(opcodeBits, sizeof(opcodeBits) / sizeof(opcodeBits[0]));
+	}
+
+	/* Forgets everything recorded */
+	void Coverage::clear() {
+		for (u64& bits : addressBits) bits = 0;
+		for (u64& bits : opcodeBits) bits = 0;
+	}
+
+	/* Adds what <other> recorded */
+	void Coverage::merge(const Coverage& other) {
+		for (size_t i = 0; i < sizeof(addressBits) / sizeof(addressBits[0]); i++)
+			addressBits[i] |= other.addressBits[i];
+		for (size_t i = 0; i < sizeof(opcodeBits) / sizeof(opcodeBits[0]); i++)
+			opcodeBits[i] |= other.opcodeBits[i];
+	}
+
+	/* Counts the instruction lines of <listing> and how many ran */
+	ListingCoverage Coverage::measure(const Listing& listing) const {
+		ListingCoverage result;
+		for (size_t i = 0; i < listing.size(); i++) {
+			const ListingLine& line = listing.line(i);
+			if (!line.instruction) continue;
+			result.instructions++;
+			if (executed((Word)line.address)) result.executed++;
+		}
+		return result;
+	}
+
+	/* Writes <listing> with its instruction lines marked, after a summary line */
+	ListingCoverage Coverage::annotate(const Listing& listing, FILE* out) const {
+		ListingCoverage result = measure(listing);
+		double percent = result.instructions == 0 ? 0.0 : 100.0 * result.executed / result.instructions;
+		fprintf(out, "; %u of %u instructions executed (%.1f%%)\n", result.executed, result.instructions, percent);
+		for (size_t i = 0; i < listing.size(); i++) {
+			const ListingLine& line = listing.line(i);
+			const char* mark = !line.instruction ? "  " : executed((Word)line.address) ? "+ " : "- ";
+			fprintf(out, "%s%s\n", mark, listing.lineText(i).c_str());
+		}
+
+		bool header = false;
+		for (u32 address = 0; address < (u32)MAX_MEM; address++) {
+			if (!executed((Word)address) || listing.lineAt((Word)address) >= 0) continue;
+			if (!header) fputs("; Ran outside the listing:\n", out);
+			header = true;
+			fprintf(out, "+ $%04X\n", address);
+		}
+		return result;
+	}
+
+	/* Writes a 16x16 grid of the implemented opcodes, capitals for those that ran */
+	void Coverage::writeOpcodeMatrix(FILE* out, InstructionManager& instructions) const {
+		fputs("   ", out);
+		for (int low = 0; low < 0x10; low++)
+			fprintf(out, "  -%X", low);
+		fputc('\n', out);
+
+		u32 implemented = 0;
+		u32 ran = 0;
+		for (int high = 0; high < 0x10; high++) {
+			fprintf(out, "%X- ", high);
+			for (int low = 0; low < 0x10; low++) {
+				Byte opcode = (Byte)(high << 4 | low);
+				const InstructionHandler* handler = instructions[opcode];
+				if (!handler->isLegal) {
+					fputs(" ...", out);
+					continue;
+				}
+				bool hit = opcodeExecuted(opcode);
+				implemented++;
+				if (hit) ran++;
+				char mnemonic[4] = {};
+				for (int i = 0; i < 3 && handler->name[i] != 0; i++)
+					mnemonic[i] = (char)(hit ? toupper(handler->name[i]) : tolower(handler->name[i]));
+				fprintf(out, " %s", mnemonic);
+			}
+			fputc('\n', out);
+		}
+		fprintf(out, "%u of %u implemented opcodes executed\n", ran, implemented);
+	}
+}
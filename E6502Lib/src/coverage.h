@@ -0,0 +1,69 @@
+#pragma once
+#include <stdio.h>
+#include "types.h"
+#include "memory.h"
+#include "instruction_manager.h"
+#include "listing.h"
+
+namespace E6502 {
+
+	/* Instruction lines of a listing, and how many of them ran */
+	struct ListingCoverage {
+		u32 instructions = 0;
+		u32 executed = 0;
+	};
+
+	/**
+	 * Records which addresses an instruction started at and which opcodes ran (attach with
+	 * CPUInternal::setCoverage). Shows the parts of a test program - Klaus' functional test in particular - that
+	 * never ran, and which opcodes a workload never touches.
+	 *
+	 * Each instruction costs two ORs into bitmaps (8KB of addresses, 32 bytes of opcodes). The opcode bits are
+	 * kept separately rather than read back from memory because self modifying code changes what ran at an address.
+	 */
+	class Coverage {
+	private:
+		u64 addressBits[MAX_MEM / 64] = {};
+		u64 opcodeBits[0x100 / 64] = {};
+
+	public:
+		void record(Word pc, Byte opcode) {
+			addressBits[pc >> 6] |= 1ULL << (pc & 63);
+			opcodeBits[opcode >> 6] |= 1ULL << (opcode & 63);
+		}
+
+		/* True if an instruction started at <address> */
+		bool executed(Word address) const { return (addressBits[address >> 6] >> (address & 63)) & 1; }
+
+		/* True if <opcode> ran */
+		bool opcodeExecuted(Byte opcode) const { return (opcodeBits[opcode >> 6] >> (opcode & 63)) & 1; }
+
+		/* Number of addresses an instruction started at */
+		u32 addressCount() const;
+
+		/* Number of opcodes that ran */
+		u32 opcodeCount() const;
+
+		/* Forgets everything recorded */
+		void clear();
+
+		/* Adds what <other> recorded, to combine several runs */
+		void merge(const Coverage& other);
+
+		/* Counts the instruction lines of <listing> and how many ran */
+		ListingCoverage measure(const Listing& listing) const;
+
+		/**
+		 * Writes <listing> with each instruction line marked "+ " if it ran or "- " if it never did (other lines
+		 * get two spaces), after a summary line. Instructions that ran at addresses the listing doesn't cover are
+		 * listed at the end
+		 */
+		ListingCoverage annotate(const Listing& listing, FILE* out) const;
+
+		/**
+		 * Writes a 16x16 grid (high nibble down, low nibble across) of the opcodes <instructions> implements: the
+		 * mnemonic in capitals if it ran, lower case if it didn't, "..." if it isn't implemented
+		 */
+		void writeOpcodeMatrix(FILE* out, InstructionManager& instructions) const;
+	};
+}
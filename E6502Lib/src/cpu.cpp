@@ -1,6 +1,11 @@
 ﻿#pragma once
 #include <stdio.h>
 #include "cpu.h"
+#include "decimal_table.h"
+#include "write_log.h"
+#include "call_profiler.h"
+#include "access_heatmap.h"
+#include "coverage.h"
 
 namespace E6502 {
 
@@ -20,30 +25,278 @@ namespace E6502 {
 	// inject to handler is used by testframework to test for specific cpu calls during execution and should not be used
 	// under normal operation. Note if used, instructions will not be able to affect the state of this CPU!
 	u8 CPUInternal::testExecute(u8 numInstructions, CPU* injectToHandler) {
+		CPU* handlerCPU = (injectToHandler == nullptr ? this : injectToHandler);
 		u8 cyclesUsed = 0;
+		loadState();
 		while (numInstructions > 0) {
-			//Get the next instruction and increment PC
-			Byte code = (*mainMemory)[currentState->PC];
-			currentState->PC++;
-			cyclesUsed++;	//Fetching the instruction uses a cycle
-
-			//Get the handler for this instruction
-			const InstructionHandler* handler = (*insManager)[code];
-			if (!handler->isLegal) {
-				fprintf(stderr, "Executing illegal opcode 0x%02X\n", code);
-			}
-			if (injectToHandler == nullptr)
-				handler->execute(this, cyclesUsed, code);
-			else
-				handler->execute(injectToHandler, cyclesUsed, code);
+			if (totalCycles >= scheduler.nextDeadline())
+				scheduler.runDue(totalCycles);
+			midInstruction = true;
+			u8 used = step(handlerCPU);
+			midInstruction = false;
+			cyclesUsed += used;
+			totalCycles += used;
+			if (totalCycles >= scheduler.nextDeadline())
+				scheduler.runDue(totalCycles);
 			numInstructions--;
 		}
+		syncState();
 		return cyclesUsed;
 	}
 
+	/* Run until at least <cycleBudget> cycles have been used or a breakpoint is reached */
+	u8 CPUInternal::run(u64 cycleBudget, bool resume) {
+		runUntil = cycleBudget > ~0ULL - totalCycles ? ~0ULL : totalCycles + cycleBudget;	// Huge budgets mean no limit
+		stopReason = STOP_BUDGET;
+		loadState();
+		running = true;
+		midInstruction = true;
+		while (totalCycles < runUntil) {
+			// Devices only get control when one of their events is due, everything else is caught up lazily on access
+			if (totalCycles >= scheduler.nextDeadline()) {
+				midInstruction = false;
+				scheduler.runDue(totalCycles);
+				midInstruction = true;
+				continue;		// An event may have stopped the run
+			}
+
+			// Only a resumed run steps over a breakpoint, and only on its first instruction
+			if (breakpoints[regs.PC] && !resume) {
+				stopReason = STOP_BREAKPOINT;
+				break;
+			}
+			resume = false;
+			Word pc = regs.PC;
+			u8 used = step(this);
+			totalCycles += used;
+
+			// An instruction that jumped to itself without side effects will loop until something external happens
+			if (regs.PC == pc && idleMode != IDLE_IGNORE && isIdleOpcode((*mainMemory)[pc])) {
+				// A breakpoint on the loop (e.g. a test suite's failure trap) is reached again before anything else
+				if (breakpoints[pc]) {
+					stopReason = STOP_BREAKPOINT;
+					break;
+				}
+				if (idleMode == IDLE_HALT) {
+					stopReason = STOP_HALTED;
+					break;
+				}
+				// Nothing can change until the next event, account for the whole iterations up to it (or the end of
+				// the budget) so cycle counts match running the loop
+				u64 until = runUntil < scheduler.nextDeadline() ? runUntil : scheduler.nextDeadline();
+				if (totalCycles < until) {
+					u64 iterations = (until - totalCycles + used - 1) / used;
+					totalCycles += iterations * used;
+#ifdef E6502_PERF_COUNTERS
+					Byte opCode = (*mainMemory)[pc];
+					counters.instructions += iterations;
+					counters.cycles += iterations * used;
+					counters.opcodes[opCode] += iterations;
+					if (opCode != 0x4C) counters.branchesTaken += iterations;
+#endif
+				}
+			}
+		}
+		midInstruction = false;
+		running = false;
+		syncState();
+		// Budget stops are usually one slice of a longer run, waiting on host I/O after each would stall it
+		if (stopReason != STOP_BUDGET)
+			flushDevices();
+		return stopReason;
+	}
+
+	/* Lets buffered devices catch up with the host */
+	void CPUInternal::flushDevices() {
+		for (Device* device : mainMemory->mappedDevices())
+			device->flush();
+	}
+
+	/* Ends the current run() after the executing instruction completes */
+	void CPUInternal::stop(u8 reason) {
+		stopReason = reason;
+		runUntil = 0;
+		if (inputObserver != nullptr && running)
+			inputObserver->stopped(inputCycle(), reason);
+	}
+
+	/* Fetches and executes a single instruction against the working registers */
+	u8 CPUInternal::step(CPU* handlerCPU) {
+		// IRQ is level triggered, a device keeps its line asserted until the guest acknowledges it
+		if (irqLines != 0 && !regs.FLAGS.bit.I)
+			return serviceIRQ();
+
+		//Get the next instruction and increment PC
+		instructionPC = regs.PC;
+		Byte code = (*mainMemory)[regs.PC];
+		if (tracer != nullptr)
+			tracer->trace(regs, totalCycles, code);
+		if (heatmap != nullptr)
+			heatmap->fetch(regs.PC);
+		if (coverage != nullptr)
+			coverage->record(regs.PC, code);
+		regs.PC++;
+		u8 cycles = 1;	//Fetching the instruction uses a cycle
+
+		//Get the handler for this instruction
+		const InstructionHandler* handler = (*insManager)[code];
+		if (!handler->isLegal) {
+			fprintf(stderr, "Executing illegal opcode 0x%02X\n", code);
+		}
+		handler->execute(handlerCPU, cycles, code);
+#ifdef E6502_PERF_COUNTERS
+		counters.instructions++;
+		counters.cycles += cycles;
+		counters.opcodes[code]++;
+		if (crossedPage) {
+			// Indexed read-modify-write instructions (ASL/ROL/LSR/ROR/INC/DEC abs,X) always take the extra cycle
+			bool alwaysExtra = (code & 0x1F) == 0x1E && code != 0xBE && code != 0x9E;
+			if (!alwaysExtra) counters.pageCrosses++;
+			crossedPage = false;
+		}
+#endif
+		if (callProfiler != nullptr)
+			callProfiler->instruction(code, regs, totalCycles + cycles);
+		return cycles;
+	}
+
+	/* Takes an IRQ - same sequence as BRK but with B clear, uses 7 cycles */
+	u8 CPUInternal::serviceIRQ() {
+		u8 cycles = 2;		// The opcode fetch is discarded and the PC isn't incremented
+		pushStackWord(cycles, regs.PC);
+		FlagUnion flags = regs.FLAGS;
+		flags.bit.B = 0;
+		flags.bit.Unused = 1;
+		pushStackByte(cycles, flags.byte);
+		regs.FLAGS.bit.I = 1;
+		regs.PC = readWord(cycles, IRQ_VECTOR);
+		if (callProfiler != nullptr)
+			callProfiler->interrupt(regs, totalCycles + cycles);
+#ifdef E6502_PERF_COUNTERS
+		counters.interrupts++;
+		counters.cycles += cycles;
+#endif
+		return cycles;
+	}
+
+	/* Assert or release an IRQ line */
+	void CPUInternal::setIRQ(u8 line, bool asserted) {
+		u32 previous = irqLines;
+		if (asserted) irqLines |= (1u << line);
+		else irqLines &= ~(1u << line);
+		if (inputObserver != nullptr && irqLines != previous)
+			inputObserver->irqChanged(inputCycle(), line, asserted);
+	}
+
+	/* Report IRQ changes and device stops to <observer> */
+	void CPUInternal::setInputObserver(InputObserver* observer) {
+		inputObserver = observer;
+	}
+
+	/* Log every writeByte / writeReferenceByte to <log> */
+	void CPUInternal::setWriteLog(WriteLog* log) {
+		writeLog = log;
+	}
+
+	/* Show every instruction to <tracer> before it runs */
+	void CPUInternal::setTracer(Tracer* newTracer) {
+		tracer = newTracer;
+	}
+
+	/* Report calls, returns and interrupts to <profiler> */
+	void CPUInternal::setCallProfiler(CallProfiler* profiler) {
+		callProfiler = profiler;
+	}
+
+	/* Count every memory access to <heatmap> */
+	void CPUInternal::setAccessHeatmap(AccessHeatmap* newHeatmap) {
+		heatmap = newHeatmap;
+	}
+
+	/* Record the address and opcode of every instruction in <coverage> */
+	void CPUInternal::setCoverage(Coverage* newCoverage) {
+		coverage = newCoverage;
+	}
+
+	/* The first instruction boundary an input arriving now can affect */
+	u64 CPUInternal::inputCycle() const {
+		return midInstruction ? totalCycles + 1 : totalCycles;
+	}
+
+	/* Enable or disable a breakpoint */
+	void CPUInternal::setBreakpoint(Word address, bool enabled) {
+		breakpoints[address] = enabled;
+	}
+
+	/* True if a breakpoint is enabled at <address> */
+	bool CPUInternal::isBreakpoint(Word address) const {
+		return breakpoints[address];
+	}
+
+	/* Choose how run() handles idle loops */
+	void CPUInternal::setIdleMode(u8 mode) {
+		idleMode = mode;
+	}
+
+	/* Copies the published CPUState into the working registers */
+	void CPUInternal::loadState() {
+		regs = *currentState;
+	}
+
+	/* Publishes the working registers to the CPUState */
+	void CPUInternal::syncState() {
+		*currentState = regs;
+	}
+
+	/* Total cycles used by this CPU */
+	u64 CPUInternal::getCycles() const {
+		return totalCycles;
+	}
+
+	/* Sets the cycle counter */
+	void CPUInternal::setCycles(u64 cycles) {
+		totalCycles = cycles;
+	}
+
+	/* Events scheduled here fire between instructions once getCycles() reaches their deadline */
+	Scheduler& CPUInternal::getScheduler() {
+		return scheduler;
+	}
+
+	/* A copy of the performance counters */
+	PerfCounters CPUInternal::getCounters() const {
+#ifdef E6502_PERF_COUNTERS
+		PerfCounters snapshot = counters;
+		u64 branches = 0;
+		for (int opCode = 0x10; opCode < 0x100; opCode += 0x20)
+			branches += counters.opcodes[opCode];
+		snapshot.branchesNotTaken = branches - counters.branchesTaken;
+		return snapshot;
+#else
+		return PerfCounters();
+#endif
+	}
+
+	/* Instructions retired since the counters were reset */
+	u64 CPUInternal::getInstructionsRetired() const {
+#ifdef E6502_PERF_COUNTERS
+		return counters.instructions;
+#else
+		return 0;
+#endif
+	}
+
+	/* Zeroes the performance counters */
+	void CPUInternal::resetCounters() {
+#ifdef E6502_PERF_COUNTERS
+		counters = PerfCounters();
+#endif
+	}
+
 	/* Resets the CPU state - Until this is called, CPU state is undefined */
 	void CPUInternal::reset() {
-		currentState->reset();	// Resets the state
+		regs.reset();			// Resets the state
+		syncState();
 		mainMemory->reset();	// Reset Memory
 	}
 
@@ -52,41 +305,57 @@ namespace E6502 {
 	
 	/** Allows an instruction to read a Byte from memory, uses 1 cycle */
 	Byte CPUInternal::readByte(u8& cycles, Word address) {
-		Byte result = (*mainMemory)[address]; cycles++;
+		if (heatmap != nullptr)
+			heatmap->read(address);
+		Byte result = busRead(address); cycles++;
 		return result;
 	}
 
 	/** Allows an instruction to write a byte to memory, uses 1 cycle */
 	void CPUInternal::writeByte(u8& cycles, Word address, Byte value) {
-		(*mainMemory)[address] = value; cycles++;
+		if (writeLog != nullptr)
+			writeLog->record(totalCycles, instructionPC, address, (*mainMemory)[address], value);
+		if (heatmap != nullptr)
+			heatmap->write(address);
+		busWrite(address, value); cycles++;
 	}
 
 	/** Allows an instruction to read a word from memory (Little endiean), uses 2 cycles*/
 	Word CPUInternal::readWord(u8& cycles, Word address) {
-		Word result = (*mainMemory)[address++]; cycles++;
-		result |=  ( (*mainMemory)[address] << 8) ; cycles++;
+		if (heatmap != nullptr) {
+			heatmap->read(address);
+			heatmap->read(address + 1);
+		}
+		Word result = busRead(address++); cycles++;
+		result |=  (busRead(address) << 8) ; cycles++;
 		return result;
 	}
 	
 	/** Reads the Byte pointed at by the current PC, increments PC, uses 1 cycle */
 	Byte CPUInternal::readPCByte(u8& cycles) {
-		Byte result = (*mainMemory)[currentState->PC++]; cycles++;
+		if (heatmap != nullptr)
+			heatmap->fetch(regs.PC);
+		Byte result = (*mainMemory)[regs.PC++]; cycles++;
 		return result;
 	}
 
 	/** Reads the Word pointed at by the current PC, increments PC, uses 2 cycles */
 	Word CPUInternal::readPCWord(u8& cycles) {
-		Word result = (*mainMemory)[currentState->PC++]; cycles++;
-		result |= ((*mainMemory)[currentState->PC++] << 8 ); cycles++;
+		if (heatmap != nullptr) {
+			heatmap->fetch(regs.PC);
+			heatmap->fetch(regs.PC + 1);
+		}
+		Word result = (*mainMemory)[regs.PC++]; cycles++;
+		result |= ((*mainMemory)[regs.PC++] << 8 ); cycles++;
 		return result;
 	}
 
 	/** gets the value of the specified register (returns 0xFF if invalid register specified), uses 0 cycles */
 	Byte CPUInternal::regValue(u8& cycles, u8 reg) {
 		switch (reg) {
-		case REGISTER_A: return currentState->A;
-		case REGISTER_X: return currentState->X;
-		case REGISTER_Y: return currentState->Y;
+		case REGISTER_A: return regs.A;
+		case REGISTER_X: return regs.X;
+		case REGISTER_Y: return regs.Y;
 		}
 		fprintf(stderr, "Attempt to get vaue of invalid register %d ", reg);
 		return 0xFF;
@@ -95,9 +364,9 @@ namespace E6502 {
 	/** Saves the given value to the target register address and sets Z and N status flags based on the value, uses 0 cycles */
 	void CPUInternal::saveToReg(u8& cycles, u8 reg, Byte value) {
 		switch (reg) {
-			case REGISTER_A: currentState->A = value; break;
-			case REGISTER_X: currentState->X = value; break;
-			case REGISTER_Y: currentState->Y = value; break;
+			case REGISTER_A: regs.A = value; break;
+			case REGISTER_X: regs.X = value; break;
+			case REGISTER_Y: regs.Y = value; break;
 				default: {
 					fprintf(stderr, "Invalid register selected for CPUInternal::saveToReg %d", reg);
 					return;
@@ -109,40 +378,58 @@ namespace E6502 {
 	/* Sets a specific flag in the status register */
 	void CPUInternal::setFlag(u8& cycles, u8 flag, bool value) {
 		Byte mask = (0x01 << flag);
-		if (value) 	currentState->FLAGS.byte |= mask;
+		if (value) 	regs.FLAGS.byte |= mask;
 		else {
 			mask = ~mask;
-			currentState->FLAGS.byte &= mask;
+			regs.FLAGS.byte &= mask;
 		}
 	}
 
 	/* Gets a specific flag in the status register */
 	bool CPUInternal::getFlag(u8& cycles, u8 flag) {
-		return (currentState->FLAGS.byte >> flag) & 0x01;
+		return (regs.FLAGS.byte >> flag) & 0x01;
 	}
 
 
 	/* Push 1 byte of data onto the stack */
 	void CPUInternal::pushStackByte(u8& cycles, Byte value) {
-		(*mainMemory)[0x0100 | currentState->SP--] = value; cycles++;
+		if (heatmap != nullptr)
+			heatmap->write(0x0100 | regs.SP);
+		(*mainMemory)[0x0100 | regs.SP--] = value; cycles++;
+#ifdef E6502_PERF_COUNTERS
+		if (regs.SP < counters.stackLowWater) counters.stackLowWater = regs.SP;
+#endif
 	}
 
 	/* Push 1 word of data onto the stack (Little end gets pushed first) */
 	void CPUInternal::pushStackWord(u8& cycles, Word value) {
-		(*mainMemory)[0x0100 | currentState->SP--] = value & 0xFF; cycles++;
-		(*mainMemory)[0x0100 | currentState->SP--] = value >> 8; cycles++;
+		if (heatmap != nullptr) {
+			heatmap->write(0x0100 | regs.SP);
+			heatmap->write(0x0100 | (Byte)(regs.SP - 1));
+		}
+		(*mainMemory)[0x0100 | regs.SP--] = value & 0xFF; cycles++;
+		(*mainMemory)[0x0100 | regs.SP--] = value >> 8; cycles++;
+#ifdef E6502_PERF_COUNTERS
+		if (regs.SP < counters.stackLowWater) counters.stackLowWater = regs.SP;
+#endif
 	}
 
 	/* Pull the next byte off the stack */
 	Byte CPUInternal::pullStackByte(u8& cycles) {
-		Byte result = (*mainMemory)[0x0100 | ++currentState->SP]; cycles++;
+		if (heatmap != nullptr)
+			heatmap->read(0x0100 | (Byte)(regs.SP + 1));
+		Byte result = (*mainMemory)[0x0100 | ++regs.SP]; cycles++;
 		return result;
 	}
 
 	/* Pull a word from the stack */
 	Word CPUInternal::pullStackWord(u8& cycles) {
-		Word result = (*mainMemory)[0x0100 | ++currentState->SP] << 8; cycles++;	// read msb
-		result |= (*mainMemory)[0x0100 | ++currentState->SP]; cycles++;				// read lsb
+		if (heatmap != nullptr) {
+			heatmap->read(0x0100 | (Byte)(regs.SP + 1));
+			heatmap->read(0x0100 | (Byte)(regs.SP + 2));
+		}
+		Word result = (*mainMemory)[0x0100 | ++regs.SP] << 8; cycles++;	// read msb
+		result |= (*mainMemory)[0x0100 | ++regs.SP]; cycles++;				// read lsb
 		return result;
 	}
 	
@@ -150,44 +437,51 @@ namespace E6502 {
 	FlagUnion CPUInternal::getFlags(u8& cycles) {
 		cycles++;
 		FlagUnion result = FlagUnion();
-		result.byte = currentState->FLAGS.byte;
+		result.byte = regs.FLAGS.byte;
 		return result;
 	}
 
 	/* Set the processor status flags */
 	void CPUInternal::setFlags(u8& cycles, FlagUnion flags) {
 		cycles++;
-		currentState->FLAGS.byte = flags.byte;
+		regs.FLAGS.byte = flags.byte;
 	}
 
 	/* Push the current value of the program counter to the stack, uses 2 cycles */
 	Word CPUInternal::getPC(u8& cycles) {
 		cycles++;
-		return currentState->PC;
+		return regs.PC;
 	}
 
 	/* Set the program counter to the specified value, uses 0 cycles */
 	void CPUInternal::setPC(u8& cycles, Word address) {
-		currentState->PC = address; cycles++;
+		regs.PC = address; cycles++;
 	}
 
 	/* Add the signed offset to the current PC, uses 1 cycle within a page, 2 if crossing a page boundary */
 	void CPUInternal::branch(u8& cycles, s8 offset) {
-		Word initPC = currentState->PC;
-		currentState->PC += offset; cycles++;
-		if ((initPC & 0xFF00) != (currentState->PC & 0xFF00)) cycles++;	//Page changed
+		Word initPC = regs.PC;
+		regs.PC += offset; cycles++;
+		if ((initPC & 0xFF00) != (regs.PC & 0xFF00)) cycles++;	//Page changed
+#ifdef E6502_PERF_COUNTERS
+		counters.branchesTaken++;
+		if ((initPC & 0xFF00) != (regs.PC & 0xFF00)) counters.pageCrosses++;
+#endif
 	}
 	
 	/* Get the current value of the stack pointer */
 	Byte CPUInternal::getSP(u8& cycles) {
 		cycles++;
-		return currentState->SP;
+		return regs.SP;
 	}
 
 	/* Set the value of the stack pointer */
 	void CPUInternal::setSP(u8& cycles, Byte value) {
 		cycles++;
-		currentState->SP = value;
+		regs.SP = value;
+#ifdef E6502_PERF_COUNTERS
+		if (regs.SP < counters.stackLowWater) counters.stackLowWater = regs.SP;
+#endif
 	}
 
 	/* Read the byte stored at the location provided by the given reference */
@@ -218,32 +512,46 @@ namespace E6502 {
 
 	/* Adds the given value to the accumulator (respecting D flag as needed), sets flags, uses 0 cycles */
 	void CPUInternal::addAccumulator(u8& cycles, Byte operandB) {
-		Byte result = 0;
-		Byte operandA = currentState->A;
-		if (currentState->FLAGS.bit.D) {
-			// Decimal mode	- consider an interrupt to prompt user to seek medical help
-			Word al = (operandA & 0x0F) + (operandB & 0x0F) + (currentState->FLAGS.bit.C ? 1 : 0);	// Add LSD
-			if (al > 0x09) al = ((al + 0x06) & 0x0F) + 0x10;		// if lsd between A and F, add 6 to LSD to get back in range (+6&$F), add carry to next digit (+0x10)
-			al = (operandA & 0xF0) + (operandB & 0xF0) + al;		// Add MSD
-			if (al > 0x99) al = al + 0x60;							// if msd between A and F, add 6 to MSD to get back in range (+$60)
-			currentState->FLAGS.bit.C = al > 0x99;
-			result = (al & 0x00FF);			// Answer is lowets byte of AL
-		}
-		else {
-			// Sensible mode
-			result =  operandA + operandB + (currentState->FLAGS.bit.C ? 1 : 0);
-			currentState->FLAGS.bit.C = (result < operandB);
-		}
-
-		// Set common flags and save result
-		currentState->FLAGS.bit.Z = (result == 0x00);
-		currentState->FLAGS.bit.N = (result >> 7);
-		currentState->FLAGS.bit.V = (result >> 7) != (operandA >> 7);
-		currentState->A = result;
+		Byte operandA = regs.A;
+		bool carry = regs.FLAGS.bit.C;
+		if (regs.FLAGS.bit.D)
+			saveArithmeticResult(DecimalTable::add(operandA, operandB, carry));	// Decimal mode - see DecimalTable
+		else
+			addBinary(operandA, operandB, carry);
 	}
 
 	/* Subtracts the given value from the accumulator (respecting D flag as needed), sets flags, uses 0 cycles */
 	void CPUInternal::subAccumulator(u8& cycles, Byte operandB) {
-		// TODO
+		Byte operandA = regs.A;
+		bool carry = regs.FLAGS.bit.C;
+		if (regs.FLAGS.bit.D)
+			saveArithmeticResult(DecimalTable::sub(operandA, operandB, carry));
+		else
+			addBinary(operandA, ~operandB, carry);		// A - B - (1 - C) == A + ~B + C
+	}
+
+	/* Called when an indexed address crosses a page, uses 1 cycle */
+	void CPUInternal::pageCrossed(u8& cycles) {
+		cycles++;
+#ifdef E6502_PERF_COUNTERS
+		crossedPage = true;
+#endif
+	}
+
+	/* Binary add with carry, sets N, V, Z, C and saves the result to A */
+	void CPUInternal::addBinary(Byte operandA, Byte operandB, bool carry) {
+		Word sum = operandA + operandB + (carry ? 1 : 0);
+		Byte result = sum & 0x00FF;
+		regs.FLAGS.bit.C = (sum >> 8);
+		regs.FLAGS.bit.Z = (result == 0x00);
+		regs.FLAGS.bit.N = (result >> 7);
+		regs.FLAGS.bit.V = ((operandA ^ result) & (operandB ^ result)) >> 7;		// Sign of both operands differs from result
+		regs.A = result;
+	}
+
+	/* Saves a DecimalTable entry to A and the N, V, Z, C flags */
+	void CPUInternal::saveArithmeticResult(Word entry) {
+		regs.FLAGS.byte = (regs.FLAGS.byte & ~DecimalTable::FLAG_MASK) | (entry >> 8);
+		regs.A = entry & 0x00FF;
 	}
 }
@@ -2,12 +2,20 @@
 // or project specific include files.
 
 #pragma once
+#include <bitset>
 #include "types.h"
 #include "memory.h"
+#include "scheduler.h"
+#include "perf_counters.h"
 #include "instruction_manager.h"
 
 namespace E6502 {
 
+	class WriteLog;
+	class CallProfiler;
+	class AccessHeatmap;
+	class Coverage;
+
 	/** 
 	 * Virtual class represents CPU ops that may be accessed by instructions 
 	 * All methods must take a u8&cycles parameter and increment this to reflect
@@ -33,6 +41,8 @@ namespace E6502 {
 		constexpr static u8 FLAG_OVERFLOW = 6;
 		constexpr static u8 FLAG_NEGATIVE = 7;
 
+		virtual ~CPU() {}
+
 		/** Read a Byte from memory */
 		virtual Byte readByte(u8& cycles, Word address) = 0;
 
@@ -114,6 +124,36 @@ namespace E6502 {
 		/* Subtracts the given value from the accumulator (respecting D flag as needed), sets flags (N,V,Z,C) uses 1 cycle */
 		virtual void subAccumulator(u8& cycles, Byte operandB) = 0;
 
+		/* Called when an indexed address crosses a page, uses 1 cycle */
+		virtual void pageCrossed(u8& cycles) { cycles++; }
+
+	};
+
+
+	/**
+	 * Told about everything that reaches the CPU from outside the guest program other than device reads (which
+	 * go through Device). Cycles are the instruction boundary the input first affects, so feeding the same calls
+	 * back through Scheduler events at those cycles reproduces a run exactly (see InputRecorder).
+	 */
+	class InputObserver {
+	public:
+		virtual ~InputObserver() {}
+
+		/* IRQ <line> changed */
+		virtual void irqChanged(u64 cycle, u8 line, bool asserted) = 0;
+
+		/* A device ended the current run with <reason> */
+		virtual void stopped(u64 cycle, u8 reason) = 0;
+	};
+
+
+	/* Sees every instruction as it starts, see CPUInternal::setTracer */
+	class Tracer {
+	public:
+		virtual ~Tracer() {}
+
+		/* <state> is the registers before the instruction at state.PC (<opcode>) runs, at <cycle> */
+		virtual void trace(const CPUState& state, u64 cycle, Byte opcode) = 0;
 	};
 
 	
@@ -123,9 +163,72 @@ namespace E6502 {
 	private:
 		InstructionManager* insManager;
 		Memory* mainMemory;
-		CPUState* currentState;
+		CPUState* currentState;			// Published state - only up to date outside of execute()/run() or after syncState()
+		CPUState regs;					// Working registers, held in the CPU object for the length of an execute()/run() call
+		u64 totalCycles = 0;			// Cycles used since construction (updated after each instruction)
+		u64 runUntil = 0;				// Cycle at which the current run() ends
+		u8 stopReason = STOP_BUDGET;	// Reason the current run() will return
+		std::bitset<MAX_MEM> breakpoints;
+		u8 idleMode = IDLE_SKIP;
+		Scheduler scheduler;			// Device events, fired between instructions
+		u32 irqLines = 0;				// One bit per device holding IRQ low
+		InputObserver* inputObserver = nullptr;
+		bool midInstruction = false;	// True while run()/execute() is inside an instruction (not firing events)
+		bool running = false;			// True inside run(), stop() has no effect otherwise
+		WriteLog* writeLog = nullptr;
+		Tracer* tracer = nullptr;
+		CallProfiler* callProfiler = nullptr;
+		AccessHeatmap* heatmap = nullptr;
+		Coverage* coverage = nullptr;
+		Word instructionPC = 0;			// Address of the executing instruction
+#ifdef E6502_PERF_COUNTERS
+		PerfCounters counters;
+		bool crossedPage = false;		// Set by pageCrossed() during the executing instruction
+#endif
+
+		/* Read a byte from memory or the device mapped at the address */
+		Byte busRead(Word address) {
+			Device* device = mainMemory->deviceAt(address);
+			return device == nullptr ? (*mainMemory)[address] : device->read(address);
+		}
+
+		/* Write a byte to memory or the device mapped at the address - writes to protected pages land in a scratch page */
+		void busWrite(Word address, Byte value) {
+			const Memory::Page& page = mainMemory->pageAt(address);
+			if (page.device == nullptr) page.write[address & 0xFF] = value;
+			else page.device->write(address, value);
+		}
+
+		/* True if opCode can form a side effect free loop when it jumps to itself (JMP absolute or a branch) */
+		static bool isIdleOpcode(Byte opCode) { return opCode == 0x4C || (opCode & 0x1F) == 0x10; }
+
+		/* Fetches and executes a single instruction (or takes a pending IRQ) against the working registers, returns the cycles used */
+		u8 step(CPU* handlerCPU);
+
+		/* Pushes PC and flags, disables interrupts and jumps through the IRQ vector, returns the cycles used */
+		u8 serviceIRQ();
+
+		/* Binary add with carry, sets N, V, Z, C and saves the result to A */
+		void addBinary(Byte operandA, Byte operandB, bool carry);
+
+		/* Saves a DecimalTable entry to A and the N, V, Z, C flags */
+		void saveArithmeticResult(Word entry);
 
 	public:
+		/* Reasons run() returned */
+		constexpr static u8 STOP_BUDGET = 0;		// The cycle budget was used up
+		constexpr static u8 STOP_BREAKPOINT = 1;	// The PC reached an enabled breakpoint
+		constexpr static u8 STOP_HALTED = 2;		// The program is stuck in an idle loop (IDLE_HALT only)
+		constexpr static u8 STOP_EXIT = 3;			// A device asked the run to end (e.g. the guest wrote to SemihostDevice)
+
+		/* What run() does when it finds an instruction that jumps to itself (e.g. end: JMP end) */
+		constexpr static u8 IDLE_IGNORE = 0;		// Keep executing the loop
+		constexpr static u8 IDLE_SKIP = 1;			// Fast forward to the next scheduled event or the end of the cycle budget (default)
+		constexpr static u8 IDLE_HALT = 2;			// Stop with STOP_HALTED
+
+		/* Address of the IRQ handler address */
+		constexpr static Word IRQ_VECTOR = 0xFFFE;
+
 		/** Constructor - Note on initialisation the CPU State is undefined, be sure to call reset() before execution */
 		CPUInternal(CPUState* initSate, Memory* initMemory, InstructionLoader* loader);
 
@@ -135,6 +238,78 @@ namespace E6502 {
 		/* Same as execute from CPU but allows injecting mock CPU to handler for testing */
 		u8 testExecute(u8 numInstructions, CPU* injectToHandler);
 
+		/**
+		 * Run until at least <cycleBudget> cycles have been used or a breakpoint is reached. Returns a STOP_ reason.
+		 * <resume> steps over a breakpoint on the first instruction, to continue from the one the last run stopped at
+		 */
+		u8 run(u64 cycleBudget, bool resume = false);
+
+		/* Lets buffered devices catch up with the host. run() only does this when it stops for a reason other than the budget */
+		void flushDevices();
+
+		/* Enable or disable a breakpoint, run() stops before executing the instruction at <address> */
+		void setBreakpoint(Word address, bool enabled);
+
+		/* True if a breakpoint is enabled at <address> */
+		bool isBreakpoint(Word address) const;
+
+		/* Choose how run() handles idle loops, one of the IDLE_ constants */
+		void setIdleMode(u8 mode);
+
+		/* Ends the current run() after the executing instruction completes, run() returns <reason> */
+		void stop(u8 reason);
+
+		/* Copies the published CPUState into the working registers */
+		void loadState();
+
+		/* Publishes the working registers to the CPUState - observers call this to sample registers mid-run */
+		void syncState();
+
+		/* Total cycles used by this CPU */
+		u64 getCycles() const;
+
+		/* Sets the cycle counter, e.g. when restoring a saved machine. Scheduled events keep their deadlines */
+		void setCycles(u64 cycles);
+
+		/* Assert or release IRQ <line> (0-31), the IRQ is taken before the next instruction while any line is asserted and I is clear */
+		void setIRQ(u8 line, bool asserted);
+
+		/* Events scheduled here fire between instructions once getCycles() reaches their deadline */
+		Scheduler& getScheduler();
+
+		/* Report IRQ changes and device stops to <observer> (nullptr to stop reporting) */
+		void setInputObserver(InputObserver* observer);
+
+		/**
+		 * The first instruction boundary an input arriving now can affect - the current cycle between instructions,
+		 * one past it while an instruction is executing (the next boundary is at least two cycles away).
+		 */
+		u64 inputCycle() const;
+
+		/* Log every writeByte / writeReferenceByte to <log> (nullptr to stop logging) */
+		void setWriteLog(WriteLog* log);
+
+		/* Show every instruction (not IRQ entry) to <tracer> before it runs (nullptr to stop tracing) */
+		void setTracer(Tracer* tracer);
+
+		/* Report calls, returns and interrupts to <profiler> (nullptr to stop), see CallProfiler::start */
+		void setCallProfiler(CallProfiler* profiler);
+
+		/* Count every memory access to <heatmap> (nullptr to stop counting) */
+		void setAccessHeatmap(AccessHeatmap* heatmap);
+
+		/* Record the address and opcode of every instruction in <coverage> (nullptr to stop recording) */
+		void setCoverage(Coverage* coverage);
+
+		/* A copy of the performance counters, all zero unless built with E6502_PERF_COUNTERS */
+		PerfCounters getCounters() const;
+
+		/* Zeroes the performance counters */
+		void resetCounters();
+
+		/* Instructions retired since the counters were reset, 0 unless built with E6502_PERF_COUNTERS */
+		u64 getInstructionsRetired() const;
+
 		/* Resets the CPU to the standard Initial state, clears registers & memory and sets PC to reset vector */
 		void reset();
 
@@ -173,5 +348,6 @@ namespace E6502 {
 
 		virtual void addAccumulator(u8& cycles, Byte operandB);
 		virtual void subAccumulator(u8& cycles, Byte operandB);
+		virtual void pageCrossed(u8& cycles);
 	};
 }
@@ -0,0 +1,58 @@
+#include "decimal_table.h"
+
+namespace E6502 {
+
+	Word DecimalTable::adcTable[DecimalTable::TABLE_SIZE];
+	Word DecimalTable::sbcTable[DecimalTable::TABLE_SIZE];
+
+	// Builds the tables before main() runs
+	static struct DecimalTableInit {
+		DecimalTableInit() { DecimalTable::build(); }
+	} decimalTableInit;
+
+	/* Packs the result and flags into a table entry */
+	static Word makeEntry(Byte result, bool negative, bool overflow, bool zero, bool carry) {
+		FlagUnion flags{ 0x00 };
+		flags.bit.C = carry;
+		flags.bit.Z = zero;
+		flags.bit.V = overflow;
+		flags.bit.N = negative;
+		return (flags.byte << 8) | result;
+	}
+
+	/* Calculates a single ADC entry, used to build the tables */
+	Word DecimalTable::computeAdd(Byte operandA, Byte operandB, bool carry) {
+		Word al = (operandA & 0x0F) + (operandB & 0x0F) + (carry ? 1 : 0);	// Add LSD
+		if (al > 0x09) al = ((al + 0x06) & 0x0F) + 0x10;		// if lsd between A and F, add 6 to LSD to get back in range (+6&$F), add carry to next digit (+0x10)
+		int high = (s8)(operandA & 0xF0) + (s8)(operandB & 0xF0) + al;	// Signed sum before the MSD is adjusted, gives N and V
+		al = (operandA & 0xF0) + (operandB & 0xF0) + al;		// Add MSD
+		if (al > 0x99) al = al + 0x60;							// if msd between A and F, add 6 to MSD to get back in range (+$60)
+		bool zero = ((operandA + operandB + (carry ? 1 : 0)) & 0xFF) == 0;	// Z comes from the binary sum
+		return makeEntry(al & 0x00FF, (high & 0x80) != 0, high < -128 || high > 127, zero, al > 0x99);
+	}
+
+	/* Calculates a single SBC entry, used to build the tables */
+	Word DecimalTable::computeSub(Byte operandA, Byte operandB, bool carry) {
+		int al = (operandA & 0x0F) - (operandB & 0x0F) + (carry ? 0 : -1);	// Subtract LSD
+		if (al < 0) al = ((al - 0x06) & 0x0F) - 0x10;			// if lsd borrowed, subtract 6 to get back in range, borrow from next digit (-0x10)
+		al = (operandA & 0xF0) - (operandB & 0xF0) + al;		// Subtract MSD
+		if (al < 0) al = al - 0x60;								// if msd borrowed, subtract 6 from MSD to get back in range (-$60)
+
+		// Every flag is the same as for a binary subtraction
+		int binary = operandA - operandB - (carry ? 0 : 1);
+		bool overflow = ((operandA ^ operandB) & (operandA ^ binary) & 0x80) != 0;
+		return makeEntry(al & 0x00FF, (binary & 0x80) != 0, overflow, (binary & 0xFF) == 0, binary >= 0);
+	}
+
+	/* Fills both tables */
+	void DecimalTable::build() {
+		for (int c = 0; c < 2; c++) {
+			for (int a = 0; a < 0x100; a++) {
+				for (int b = 0; b < 0x100; b++) {
+					adcTable[index(a, b, c)] = computeAdd(a, b, c);
+					sbcTable[index(a, b, c)] = computeSub(a, b, c);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include "types.h"
+
+namespace E6502 {
+
+	/**
+	 * Precomputed results for decimal mode ADC and SBC.
+	 *
+	 * Each entry holds the result in the low byte and the N, V, Z and C flags (in their status register
+	 * positions) in the high byte. Tables are indexed by (carry << 16) | (A << 8) | operand so a decimal
+	 * operation costs a single load instead of a chain of data dependent branches.
+	 *
+	 * Results and carry are correct for valid BCD operands. The flags follow the NMOS 6502 (not the 65C02, which
+	 * takes N and Z from the decimal result):
+	 *   ADC  N and V come from the sum after the low digit is adjusted but before the high digit is, Z from the
+	 *        binary sum A + operand + C
+	 *   SBC  N, V and Z are those of the binary subtraction
+	 * Carry is the decimal carry for ADC and the binary borrow for SBC (the two agree for SBC).
+	 */
+	class DecimalTable {
+	private:
+		DecimalTable();		// Only used statically
+
+		static constexpr int TABLE_SIZE = 0x20000;	// 256 * 256 * 2 (A, operand, carry)
+
+		static Word adcTable[TABLE_SIZE];
+		static Word sbcTable[TABLE_SIZE];
+
+		static int index(Byte operandA, Byte operandB, bool carry) { return (carry << 16) | (operandA << 8) | operandB; }
+
+	public:
+		/* Status flags written by a table entry (N, V, Z, C) */
+		constexpr static Byte FLAG_MASK = 0xC3;
+
+		/* Look up the result and flags of a decimal mode ADC */
+		static Word add(Byte operandA, Byte operandB, bool carry) { return adcTable[index(operandA, operandB, carry)]; }
+
+		/* Look up the result and flags of a decimal mode SBC */
+		static Word sub(Byte operandA, Byte operandB, bool carry) { return sbcTable[index(operandA, operandB, carry)]; }
+
+		/* Calculates a single ADC entry, used to build the tables */
+		static Word computeAdd(Byte operandA, Byte operandB, bool carry);
+
+		/* Calculates a single SBC entry, used to build the tables */
+		static Word computeSub(Byte operandA, Byte operandB, bool carry);
+
+		/* Fills both tables - called once during static initialisation */
+		static void build();
+	};
+}
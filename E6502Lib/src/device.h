@@ -0,0 +1,27 @@
+#pragma once
+#include "types.h"
+
+namespace E6502 {
+
+	/**
+	 * A memory mapped peripheral. Devices are attached to whole pages of Memory with Memory::mapDevice
+	 * and receive every readByte/writeByte the CPU makes to those pages. Reads and writes use no cycles,
+	 * the CPU accounts for the bus access.
+	 */
+	class Device {
+	public:
+		virtual ~Device() {}
+
+		/* Read the register at the given address */
+		virtual Byte read(Word address) = 0;
+
+		/* Write the register at the given address */
+		virtual void write(Word address, Byte value) = 0;
+
+		/**
+		 * Lets buffered devices catch up with the host. Called when CPUInternal::run() stops short of its budget and
+		 * from CPUInternal::flushDevices()
+		 */
+		virtual void flush() {}
+	};
+}
@@ -0,0 +1,115 @@
+#include "acia_device.h"
+
+namespace E6502 {
+
+	// Standard 6551 rates for control bits 0-3, 0 (external 16x clock) is treated as 115200
+	static const u32 BAUD_RATES[16] = {
+		115200, 50, 75, 110, 135, 150, 300, 600, 1200, 1800, 2400, 3600, 4800, 7200, 9600, 19200
+	};
+
+	AciaDevice::AciaDevice(CPUInternal* cpu, u8 line, size_t bufferSize) : rx(bufferSize), tx(bufferSize) {
+		this->cpu = cpu;
+		irqLine = line;
+	}
+
+	AciaDevice::~AciaDevice() {
+		cpu->getScheduler().cancel(&pollEvent);
+		cpu->setIRQ(irqLine, false);
+	}
+
+	/* Read a register */
+	Byte AciaDevice::read(Word address) {
+		switch (address & 0x03) {
+			case REG_DATA:
+				rx.pop(lastReceived);
+				update();
+				return lastReceived;
+			case REG_STATUS: {
+				Byte status = 0x00;
+				if (!rx.empty()) status |= STATUS_RX_FULL;
+				if (!tx.full()) status |= STATUS_TX_EMPTY;
+				if (interruptPending()) status |= STATUS_IRQ;
+				return status;
+			}
+			case REG_COMMAND:	return command;
+			case REG_CONTROL:	return control;
+		}
+		return 0x00;
+	}
+
+	/* Write a register */
+	void AciaDevice::write(Word address, Byte value) {
+		switch (address & 0x03) {
+			case REG_DATA:
+				tx.push(value);		// Dropped if the host isn't keeping up, as a real port would overrun
+				break;
+			case REG_STATUS:
+				command &= 0xE0;	// Programmed reset - disables the port and its interrupts
+				break;
+			case REG_COMMAND:
+				command = value;
+				break;
+			case REG_CONTROL:
+				control = value;
+				break;
+		}
+		update();
+	}
+
+	/* True if an enabled interrupt condition holds */
+	bool AciaDevice::interruptPending() {
+		return (receiveIRQEnabled() && !rx.empty()) || (transmitIRQEnabled() && !tx.full());
+	}
+
+	/* Cycles to send one character (start + 8 data + stop bits) */
+	u64 AciaDevice::characterCycles() const {
+		return (CLOCK_HZ * 10) / BAUD_RATES[control & 0x0F];
+	}
+
+	/* Updates the IRQ line and the poll event */
+	void AciaDevice::update() {
+		bool pending = interruptPending();
+		cpu->setIRQ(irqLine, pending);
+
+		// Only poll while an interrupt is enabled and not already asserted, the host may fill rx or drain tx at any time
+		Scheduler& scheduler = cpu->getScheduler();
+		if ((receiveIRQEnabled() || transmitIRQEnabled()) && !pending) {
+			if (!pollEvent.isScheduled())
+				scheduler.schedule(&pollEvent, cpu->getCycles() + characterCycles());
+		} else {
+			scheduler.cancel(&pollEvent);
+		}
+	}
+
+	/* Checks the rings once per character time */
+	void AciaDevice::poll(u64 now) {
+		bool pending = interruptPending();
+		cpu->setIRQ(irqLine, pending);
+		if ((receiveIRQEnabled() || transmitIRQEnabled()) && !pending)		// Otherwise the next register access restarts polling
+			cpu->getScheduler().schedule(&pollEvent, now + characterCycles());
+	}
+
+	/* Queue bytes from a file */
+	size_t AciaDevice::feed(FILE* in) {
+		size_t count = 0;
+		while (!rx.full()) {
+			int c = fgetc(in);
+			if (c == EOF) break;
+			rx.push((Byte)c);
+			count++;
+		}
+		return count;
+	}
+
+	/* Write transmitted bytes to a file */
+	size_t AciaDevice::drain(FILE* out) {
+		size_t count = 0;
+		Byte value;
+		while (tx.pop(value)) {
+			fputc(value, out);
+			count++;
+		}
+		if (count > 0) fflush(out);
+		return count;
+	}
+}
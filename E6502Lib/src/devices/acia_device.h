@@ -0,0 +1,101 @@
+#pragma once
+#include <stdio.h>
+#include "../types.h"
+#include "../device.h"
+#include "../scheduler.h"
+#include "../spsc_ring.h"
+#include "../cpu.h"
+
+namespace E6502 {
+
+	/**
+	 * 6551 style serial port. Transmitted bytes go into one lock-free ring and received bytes come out of
+	 * another, so a host thread (or feed()/drain() from a file) can talk to the guest while the CPU keeps running.
+	 * The emulation thread is the consumer of the receive ring and the producer of the transmit ring.
+	 *
+	 * Status bits are worked out from the ring indices on every read, there is no locking. Interrupts caused by the
+	 * host (a byte received, or room made to transmit) are found by a scheduler event polling the rings once per
+	 * character time at the programmed baud rate (only while an interrupt is enabled), since host threads can't
+	 * touch the CPU directly.
+	 *
+	 * Registers (offset from the start of the mapped page, mirrored every 4 bytes):
+	 *   $00  DATA     R  Next received byte (the last byte again if none is waiting)   W  Transmit a byte
+	 *   $01  STATUS   R  bit 3 receive full, bit 4 transmit empty, bit 7 IRQ           W  Programmed reset
+	 *   $02  COMMAND  RW bit 0 DTR (enables the port), bit 1 disables the receive IRQ, bits 2-3 = 01 enable the transmit IRQ
+	 *   $03  CONTROL  RW bits 0-3 select the baud rate (only used for the receive poll interval)
+	 */
+	class AciaDevice : public Device {
+	private:
+		/* Polls the rings for the receive and transmit interrupts */
+		class PollEvent : public Event {
+		public:
+			AciaDevice* acia;
+			PollEvent(AciaDevice* acia) : acia(acia) {}
+			virtual void fire(u64 now) { acia->poll(now); }
+		};
+
+		CPUInternal* cpu;
+		u8 irqLine;
+		SpscRing<Byte> rx;
+		SpscRing<Byte> tx;
+		PollEvent pollEvent{ this };
+		Byte command = 0x00;
+		Byte control = 0x00;
+		Byte lastReceived = 0x00;
+
+		bool receiveIRQEnabled() const { return (command & (COMMAND_DTR | COMMAND_RX_IRQ_DISABLE)) == COMMAND_DTR; }
+		bool transmitIRQEnabled() const { return (command & (COMMAND_DTR | COMMAND_TX_MASK)) == (COMMAND_DTR | COMMAND_TX_IRQ); }
+
+		/* True if an enabled interrupt condition holds */
+		bool interruptPending();
+
+		/* Cycles to send one 10 bit character at the programmed baud rate */
+		u64 characterCycles() const;
+
+		/* Updates the IRQ line and starts / stops the poll event to match the command register */
+		void update();
+
+		/* Poll event handler */
+		void poll(u64 now);
+
+	public:
+		constexpr static Byte REG_DATA = 0x00;
+		constexpr static Byte REG_STATUS = 0x01;
+		constexpr static Byte REG_COMMAND = 0x02;
+		constexpr static Byte REG_CONTROL = 0x03;
+
+		constexpr static Byte STATUS_RX_FULL = 0x08;
+		constexpr static Byte STATUS_TX_EMPTY = 0x10;
+		constexpr static Byte STATUS_IRQ = 0x80;
+
+		constexpr static Byte COMMAND_DTR = 0x01;
+		constexpr static Byte COMMAND_RX_IRQ_DISABLE = 0x02;
+		constexpr static Byte COMMAND_TX_MASK = 0x0C;
+		constexpr static Byte COMMAND_TX_IRQ = 0x04;
+
+		/* CPU clock used to turn the baud rate into a poll interval */
+		constexpr static u64 CLOCK_HZ = 1000000;
+
+		/* Interrupts go to IRQ <line> on <cpu>, each direction buffers at least <bufferSize> bytes */
+		AciaDevice(CPUInternal* cpu, u8 line = 1, size_t bufferSize = 1024);
+
+		/* Cancels the poll event and releases the IRQ line */
+		~AciaDevice();
+
+		/* Device overrides */
+		virtual Byte read(Word address);
+		virtual void write(Word address, Byte value);
+
+		/* Host side - queue a byte for the guest to receive, false if the receive buffer is full */
+		bool hostSend(Byte value) { return rx.push(value); }
+
+		/* Host side - take the next byte the guest transmitted, false if there is none */
+		bool hostReceive(Byte& value) { return tx.pop(value); }
+
+		/* Host side - queue bytes from <in> until the receive buffer is full or <in> runs out. Returns the bytes queued */
+		size_t feed(FILE* in);
+
+		/* Host side - write everything the guest has transmitted to <out>. Returns the bytes written */
+		size_t drain(FILE* out);
+	};
+}
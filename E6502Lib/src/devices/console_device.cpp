@@ -0,0 +1,87 @@
+#include "console_device.h"
+
+namespace E6502 {
+
+	ConsoleDevice::ConsoleDevice(FILE* output, size_t bufferSize, bool useThread) {
+		out = output;
+		capacity = (bufferSize == 0 ? 1 : bufferSize);
+		background = useThread;
+		active.reserve(capacity);
+		pending.reserve(capacity);
+		if (background)
+			writer = std::thread(&ConsoleDevice::writerLoop, this);
+	}
+
+	ConsoleDevice::~ConsoleDevice() {
+		flush();
+		if (background) {
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				stopping = true;
+			}
+			pendingChanged.notify_all();
+			writer.join();
+		}
+	}
+
+	/* Read a register, only STATUS is readable */
+	Byte ConsoleDevice::read(Word address) {
+		return (address & 0xFF) == REG_STATUS ? STATUS_READY : 0x00;
+	}
+
+	/* Write a register, writes to unknown registers are ignored */
+	void ConsoleDevice::write(Word address, Byte value) {
+		switch (address & 0xFF) {
+			case REG_DATA:
+				active.push_back(value);
+				if (active.size() >= capacity) handOff();
+				break;
+			case REG_FLUSH:
+				flush();
+				break;
+		}
+	}
+
+	/* Writes everything buffered so far and waits for it to reach the host */
+	void ConsoleDevice::flush() {
+		if (!active.empty()) handOff();
+		if (background) {
+			std::unique_lock<std::mutex> guard(lock);
+			pendingChanged.wait(guard, [this] { return pending.empty(); });
+		}
+		fflush(out);
+	}
+
+	/* Hands the active buffer to the writer */
+	void ConsoleDevice::handOff() {
+		if (!background) {
+			fwrite(active.data(), 1, active.size(), out);
+			active.clear();
+			return;
+		}
+
+		// Wait for the previous batch to be written, then swap buffers
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			pendingChanged.wait(guard, [this] { return pending.empty(); });
+			std::swap(active, pending);
+		}
+		pendingChanged.notify_all();
+	}
+
+	/* Background thread loop */
+	void ConsoleDevice::writerLoop() {
+		std::unique_lock<std::mutex> guard(lock);
+		while (true) {
+			pendingChanged.wait(guard, [this] { return stopping || !pending.empty(); });
+			if (pending.empty() && stopping) return;
+
+			// Write without holding the lock so the emulation thread can keep filling the active buffer
+			guard.unlock();
+			fwrite(pending.data(), 1, pending.size(), out);
+			guard.lock();
+			pending.clear();
+			pendingChanged.notify_all();
+		}
+	}
+}
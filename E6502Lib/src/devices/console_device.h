@@ -0,0 +1,62 @@
+#pragma once
+#include <stdio.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "../types.h"
+#include "../device.h"
+
+namespace E6502 {
+
+	/**
+	 * Memory mapped console output. Characters the guest writes are collected in a host side buffer and
+	 * written out in batches - either by a background thread when the buffer fills, or when run() returns -
+	 * so printing costs the guest a memory write rather than a system call per character.
+	 *
+	 * Registers (offset from the start of the mapped page):
+	 *   $00  DATA    W  Appends a character to the output
+	 *   $01  STATUS  R  Bit 7 set when the console can accept output (always, writes never block the guest)
+	 *   $02  FLUSH   W  Pushes buffered output to the host now
+	 */
+	class ConsoleDevice : public Device {
+	private:
+		FILE* out;
+		size_t capacity;
+
+		std::vector<char> active;		// Filled by the emulation thread
+		std::vector<char> pending;		// Being written by the flush thread
+
+		bool background;
+		bool stopping = false;
+		std::thread writer;
+		std::mutex lock;
+		std::condition_variable pendingChanged;
+
+		/* Hands the active buffer to the writer (or writes it directly without a background thread) */
+		void handOff();
+
+		/* Background thread loop - writes pending buffers as they arrive */
+		void writerLoop();
+
+	public:
+		constexpr static Byte REG_DATA = 0x00;
+		constexpr static Byte REG_STATUS = 0x01;
+		constexpr static Byte REG_FLUSH = 0x02;
+
+		constexpr static Byte STATUS_READY = 0x80;
+
+		/* Output goes to <output> in batches of up to <bufferSize> characters, written by a background thread if <useThread> */
+		ConsoleDevice(FILE* output = stdout, size_t bufferSize = 4096, bool useThread = true);
+
+		/* Flushes any remaining output and stops the background thread */
+		~ConsoleDevice();
+
+		/* Device overrides */
+		virtual Byte read(Word address);
+		virtual void write(Word address, Byte value);
+
+		/* Writes everything buffered so far and waits for it to reach the host */
+		virtual void flush();
+	};
+}
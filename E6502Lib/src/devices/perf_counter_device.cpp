@@ -0,0 +1,54 @@
+#include "perf_counter_device.h"
+
+namespace E6502 {
+
+	PerfCounterDevice::PerfCounterDevice(CPUInternal* cpu) {
+		this->cpu = cpu;
+	}
+
+	/* Cycles the stopwatch has run so far */
+	u64 PerfCounterDevice::stopwatchCycles() const {
+		return running ? stopwatchElapsed + (cpu->getCycles() - stopwatchStart) : stopwatchElapsed;
+	}
+
+	/* Read a register, the first byte of each counter latches it. Unknown registers read as 0 */
+	Byte PerfCounterDevice::read(Word address) {
+		Byte reg = address & 0xFF;
+		if (reg < REG_INSTRUCTIONS) {
+			if (reg == REG_CYCLES) latchedCycles = cpu->getCycles();
+			return byteOf(latchedCycles, reg - REG_CYCLES);
+		}
+		if (reg < REG_STOPWATCH) {
+			if (reg == REG_INSTRUCTIONS) latchedInstructions = cpu->getInstructionsRetired();
+			return byteOf(latchedInstructions, reg - REG_INSTRUCTIONS);
+		}
+		if (reg < REG_CONTROL) {
+			if (reg == REG_STOPWATCH) latchedStopwatch = stopwatchCycles();
+			return byteOf(latchedStopwatch, reg - REG_STOPWATCH);
+		}
+		if (reg == REG_CONTROL) return running ? 1 : 0;
+		return 0x00;
+	}
+
+	/* Write a register, only CONTROL is writable */
+	void PerfCounterDevice::write(Word address, Byte value) {
+		if ((address & 0xFF) != REG_CONTROL) return;
+		switch (value) {
+			case STOPWATCH_START:
+				stopwatchElapsed = 0;
+				stopwatchStart = cpu->getCycles();
+				running = true;
+				break;
+			case STOPWATCH_STOP:
+				stopwatchElapsed = stopwatchCycles();
+				running = false;
+				break;
+			case STOPWATCH_RESUME:
+				if (!running) {
+					stopwatchStart = cpu->getCycles();
+					running = true;
+				}
+				break;
+		}
+	}
+}
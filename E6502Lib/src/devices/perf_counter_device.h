@@ -0,0 +1,54 @@
+#pragma once
+#include "../types.h"
+#include "../device.h"
+#include "../cpu.h"
+
+namespace E6502 {
+
+	/**
+	 * Counter page for guest benchmarks - lets a program time itself with a few memory accesses and no host help.
+	 *
+	 * Registers (offset from the start of the mapped page):
+	 *   $00-$07  CYCLES        R  64-bit cycle counter (little endian) - reading $00 latches the whole counter
+	 *   $08-$0F  INSTRUCTIONS  R  Instructions retired - reading $08 latches it (needs E6502_PERF_COUNTERS, else 0)
+	 *   $10-$17  STOPWATCH     R  Cycles the stopwatch has run - reading $10 latches it
+	 *   $18      CONTROL       RW Write STOPWATCH_START to zero and start the stopwatch, STOPWATCH_STOP to stop it,
+	 *                             STOPWATCH_RESUME to carry on from where it stopped. Reads 1 while running
+	 *
+	 * Counters are read as of the start of the accessing instruction, so a start and stop with nothing between
+	 * reads as the cycles of the instruction that started it (4 for STA absolute).
+	 */
+	class PerfCounterDevice : public Device {
+	private:
+		CPUInternal* cpu;
+
+		u64 latchedCycles = 0;
+		u64 latchedInstructions = 0;
+		u64 latchedStopwatch = 0;
+		u64 stopwatchStart = 0;			// Cycle the stopwatch was started or resumed
+		u64 stopwatchElapsed = 0;		// Cycles run before the last stop
+		bool running = false;
+
+		/* Byte <index> of <value> */
+		static Byte byteOf(u64 value, int index) { return (value >> (index * 8)) & 0xFF; }
+
+	public:
+		constexpr static Byte REG_CYCLES = 0x00;
+		constexpr static Byte REG_INSTRUCTIONS = 0x08;
+		constexpr static Byte REG_STOPWATCH = 0x10;
+		constexpr static Byte REG_CONTROL = 0x18;
+
+		constexpr static Byte STOPWATCH_STOP = 0x00;
+		constexpr static Byte STOPWATCH_START = 0x01;
+		constexpr static Byte STOPWATCH_RESUME = 0x02;
+
+		PerfCounterDevice(CPUInternal* cpu);
+
+		/* Device overrides */
+		virtual Byte read(Word address);
+		virtual void write(Word address, Byte value);
+
+		/* Cycles the stopwatch has run so far */
+		u64 stopwatchCycles() const;
+	};
+}
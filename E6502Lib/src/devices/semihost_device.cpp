@@ -0,0 +1,55 @@
+#include "semihost_device.h"
+
+namespace E6502 {
+
+	SemihostDevice::SemihostDevice(CPUInternal* cpu, Memory* mem, FILE* output) {
+		this->cpu = cpu;
+		this->memory = mem;
+		this->out = output;
+	}
+
+	/* Read a register, unknown registers read as 0 */
+	Byte SemihostDevice::read(Word address) {
+		Byte reg = address & 0xFF;
+		switch (reg) {
+			case REG_PTR_LO: return pointer & 0xFF;
+			case REG_PTR_HI: return pointer >> 8;
+			case REG_CYCLES: latchedCycles = cpu->getCycles(); return latchedCycles & 0xFF;
+		}
+		if (reg > REG_CYCLES && reg < REG_CYCLES + 8)
+			return (latchedCycles >> ((reg - REG_CYCLES) * 8)) & 0xFF;
+		return 0x00;
+	}
+
+	/* Write a register, writes to unknown registers are ignored */
+	void SemihostDevice::write(Word address, Byte value) {
+		switch (address & 0xFF) {
+			case REG_EXIT:
+				exitCode = value;
+				exited = true;
+				fflush(out);
+				cpu->stop(CPUInternal::STOP_EXIT);
+				break;
+			case REG_PUTC:
+				fputc(value, out);
+				break;
+			case REG_PTR_LO:
+				pointer = (pointer & 0xFF00) | value;
+				break;
+			case REG_PTR_HI:
+				pointer = (pointer & 0x00FF) | (value << 8);
+				break;
+			case REG_WRITE: {
+				// Buffers are read straight from memory and wrap at $FFFF like the CPU would
+				u16 length = (value == 0 ? 0x100 : value);
+				Word next = pointer;
+				for (u16 i = 0; i < length; i++) {
+					Byte c = (*memory)[next++];
+					if (value == 0 && c == 0x00) break;
+					fputc(c, out);
+				}
+				break;
+			}
+		}
+	}
+}
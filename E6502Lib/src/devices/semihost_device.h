@@ -0,0 +1,54 @@
+#pragma once
+#include <stdio.h>
+#include "../types.h"
+#include "../device.h"
+#include "../memory.h"
+#include "../cpu.h"
+
+namespace E6502 {
+
+	/**
+	 * Control page for headless runs - lets a guest program end the run with an exit code, print to the
+	 * host and read the cycle counter, so the host doesn't need to guess when a program is done.
+	 *
+	 * Registers (offset from the start of the mapped page):
+	 *   $00      EXIT    W  Ends the current run() with STOP_EXIT, the value written is the exit code
+	 *   $01      PUTC    W  Writes a character to the host
+	 *   $02      PTR_LO  RW Buffer address (low byte)
+	 *   $03      PTR_HI  RW Buffer address (high byte)
+	 *   $04      WRITE   W  Writes <value> bytes from the buffer to the host, 0 writes up to a zero byte (max 256)
+	 *   $08-$0F  CYCLES  R  64-bit cycle counter (little endian) - reading $08 latches the whole counter
+	 */
+	class SemihostDevice : public Device {
+	private:
+		CPUInternal* cpu;
+		Memory* memory;
+		FILE* out;
+
+		Word pointer = 0x0000;
+		u64 latchedCycles = 0;
+		Byte exitCode = 0;
+		bool exited = false;
+
+	public:
+		constexpr static Byte REG_EXIT = 0x00;
+		constexpr static Byte REG_PUTC = 0x01;
+		constexpr static Byte REG_PTR_LO = 0x02;
+		constexpr static Byte REG_PTR_HI = 0x03;
+		constexpr static Byte REG_WRITE = 0x04;
+		constexpr static Byte REG_CYCLES = 0x08;
+
+		/* Output goes to <output>, buffers are read directly from <mem> */
+		SemihostDevice(CPUInternal* cpu, Memory* mem, FILE* output = stdout);
+
+		/* Device overrides */
+		virtual Byte read(Word address);
+		virtual void write(Word address, Byte value);
+
+		/* True once the guest has written to EXIT */
+		bool hasExited() const { return exited; }
+
+		/* The value the guest wrote to EXIT */
+		Byte getExitCode() const { return exitCode; }
+	};
+}
@@ -0,0 +1,128 @@
+#include "via_device.h"
+
+namespace E6502 {
+
+	ViaDevice::ViaDevice(CPUInternal* cpu, u8 line) {
+		this->cpu = cpu;
+		irqLine = line;
+	}
+
+	ViaDevice::~ViaDevice() {
+		cpu->getScheduler().cancel(&t1Event);
+		cpu->getScheduler().cancel(&t2Event);
+		cpu->setIRQ(irqLine, false);
+	}
+
+	/* Read a register */
+	Byte ViaDevice::read(Word address) {
+		catchUp();
+		switch (address & 0x0F) {
+			case REG_T1C_L:
+				setFlags(IFR_T1, false);
+				return counter(t1) & 0xFF;
+			case REG_T1C_H:		return counter(t1) >> 8;
+			case REG_T1L_L:		return t1.latch & 0xFF;
+			case REG_T1L_H:		return t1.latch >> 8;
+			case REG_T2C_L:
+				setFlags(IFR_T2, false);
+				return counter(t2) & 0xFF;
+			case REG_T2C_H:		return counter(t2) >> 8;
+			case REG_ACR:		return acr;
+			case REG_IFR:		return ifr | ((ifr & ier & 0x7F) != 0 ? IFR_IRQ : 0x00);
+			case REG_IER:		return ier | 0x80;
+		}
+		return 0x00;
+	}
+
+	/* Write a register, writes to the (unemulated) port registers are ignored */
+	void ViaDevice::write(Word address, Byte value) {
+		catchUp();
+		switch (address & 0x0F) {
+			case REG_T1C_L:
+			case REG_T1L_L:
+				t1.latch = (t1.latch & 0xFF00) | value;
+				break;
+			case REG_T1C_H:
+				t1.latch = (t1.latch & 0x00FF) | (value << 8);
+				setFlags(IFR_T1, false);
+				load(t1, t1Event, t1.latch);
+				break;
+			case REG_T1L_H:
+				t1.latch = (t1.latch & 0x00FF) | (value << 8);
+				setFlags(IFR_T1, false);
+				break;
+			case REG_T2C_L:
+				t2.latch = (t2.latch & 0xFF00) | value;
+				break;
+			case REG_T2C_H:
+				t2.latch = (t2.latch & 0x00FF) | (value << 8);
+				setFlags(IFR_T2, false);
+				load(t2, t2Event, t2.latch);
+				break;
+			case REG_ACR:
+				acr = value;
+				break;
+			case REG_IFR:
+				setFlags(value & 0x7F, false);
+				break;
+			case REG_IER:
+				if (value & 0x80) ier |= (value & 0x7F);
+				else ier &= ~value;
+				updateIRQ();
+				break;
+		}
+	}
+
+	/* Counts down from <loaded> at <start>, wrapping through $FFFF */
+	Word ViaDevice::counter(const Timer& timer) {
+		u64 now = cpu->getCycles();
+		if (now < timer.start) return 0xFFFF;		// Between an underflow and the free-run reload
+		return (Word)(timer.loaded - (now - timer.start));
+	}
+
+	/* Reloads a timer at the current cycle, it underflows once the counter has passed zero */
+	void ViaDevice::load(Timer& timer, TimerEvent& event, Word value) {
+		timer.loaded = value;
+		timer.start = cpu->getCycles();
+		cpu->getScheduler().schedule(&event, timer.start + value + 1);
+	}
+
+	/* A timer reached zero - flag it and, for T1 in free-run mode, reload from the latch */
+	void ViaDevice::underflow(Byte flag, u64 cycle) {
+		setFlags(flag, true);
+		if (flag == IFR_T1 && (acr & ACR_T1_FREE_RUN)) {
+			// The counter shows $FFFF for a cycle then the latch, so each period is latch + 2 cycles.
+			// Scheduling from the deadline rather than the current cycle keeps late firing from drifting.
+			t1.loaded = t1.latch;
+			t1.start = cycle + 1;
+			cpu->getScheduler().schedule(&t1Event, t1.start + t1.latch + 1);
+		}
+		// One shot timers keep counting down but don't interrupt again until reloaded
+	}
+
+	/* Fires our own overdue events */
+	void ViaDevice::catchUp() {
+		u64 now = cpu->getCycles();
+		while (true) {
+			TimerEvent* due = nullptr;
+			if (t1Event.isScheduled() && t1Event.getDeadline() <= now) due = &t1Event;
+			if (t2Event.isScheduled() && t2Event.getDeadline() <= now &&
+				(due == nullptr || t2Event.getDeadline() < due->getDeadline())) due = &t2Event;
+			if (due == nullptr) return;
+			cpu->getScheduler().cancel(due);
+			due->fire(now);
+		}
+	}
+
+	/* Sets or clears interrupt flags */
+	void ViaDevice::setFlags(Byte flags, bool value) {
+		if (value) ifr |= flags;
+		else ifr &= ~flags;
+		updateIRQ();
+	}
+
+	/* IRQ is asserted while any enabled flag is set */
+	void ViaDevice::updateIRQ() {
+		cpu->setIRQ(irqLine, (ifr & ier & 0x7F) != 0);
+	}
+}
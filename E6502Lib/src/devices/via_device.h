@@ -0,0 +1,99 @@
+#pragma once
+#include "../types.h"
+#include "../device.h"
+#include "../scheduler.h"
+#include "../cpu.h"
+
+namespace E6502 {
+
+	/**
+	 * The timer and interrupt half of a 6522 VIA. The ports are not emulated (they read as zero).
+	 *
+	 * Counters are never ticked, a timer remembers the cycle it was loaded and its value is worked out from
+	 * the CPU cycle counter when the guest reads it. Underflows are scheduler events that set the interrupt
+	 * flag and drive an IRQ line on the CPU, so a guest waiting for a timer interrupt costs nothing until it fires.
+	 *
+	 * Registers (offset from the start of the mapped page, mirrored every 16 bytes):
+	 *   $04  T1C_L  R  Timer 1 counter low (clears the T1 flag)          W  Timer 1 latch low
+	 *   $05  T1C_H  R  Timer 1 counter high                               W  Latch high, loads and starts T1, clears the T1 flag
+	 *   $06  T1L_L  RW Timer 1 latch low
+	 *   $07  T1L_H  RW Timer 1 latch high (a write clears the T1 flag)
+	 *   $08  T2C_L  R  Timer 2 counter low (clears the T2 flag)          W  Timer 2 latch low
+	 *   $09  T2C_H  R  Timer 2 counter high                               W  Loads and starts T2 (one shot), clears the T2 flag
+	 *   $0B  ACR    RW Auxiliary control, bit 6 puts T1 in free-run mode (reloads from the latch on underflow)
+	 *   $0D  IFR    RW Interrupt flags, bit 6 T1, bit 5 T2, bit 7 set if any enabled flag is set. Writing 1s clears flags
+	 *   $0E  IER    RW Interrupt enable, writes set (bit 7 = 1) or clear (bit 7 = 0) the given bits. Reads with bit 7 set
+	 */
+	class ViaDevice : public Device {
+	private:
+		/* Underflow event for one of the timers */
+		class TimerEvent : public Event {
+		public:
+			ViaDevice* via;
+			Byte flag;
+			TimerEvent(ViaDevice* via, Byte flag) : via(via), flag(flag) {}
+			virtual void fire(u64) { via->underflow(flag, getDeadline()); }
+		};
+
+		/* State needed to work out a counter value at any cycle */
+		struct Timer {
+			Word latch = 0xFFFF;
+			Word loaded = 0xFFFF;		// Counter value at cycle <start>
+			u64 start = 0;
+		};
+
+		CPUInternal* cpu;
+		u8 irqLine;
+
+		Timer t1, t2;
+		TimerEvent t1Event{ this, IFR_T1 };
+		TimerEvent t2Event{ this, IFR_T2 };
+		Byte acr = 0x00;
+		Byte ifr = 0x00;
+		Byte ier = 0x00;
+
+		/* Current counter value of <timer> */
+		Word counter(const Timer& timer);
+
+		/* Reloads <timer> with <value> at the current cycle and schedules its underflow */
+		void load(Timer& timer, TimerEvent& event, Word value);
+
+		/* Handles a timer reaching zero at cycle <cycle> */
+		void underflow(Byte flag, u64 cycle);
+
+		/* Fires any of our own events that are already due, so registers are right even mid-instruction */
+		void catchUp();
+
+		/* Sets or clears interrupt flags and updates the IRQ line */
+		void setFlags(Byte flags, bool value);
+
+		/* Drives the CPU IRQ line from the enabled flags */
+		void updateIRQ();
+
+	public:
+		constexpr static Byte REG_T1C_L = 0x04;
+		constexpr static Byte REG_T1C_H = 0x05;
+		constexpr static Byte REG_T1L_L = 0x06;
+		constexpr static Byte REG_T1L_H = 0x07;
+		constexpr static Byte REG_T2C_L = 0x08;
+		constexpr static Byte REG_T2C_H = 0x09;
+		constexpr static Byte REG_ACR = 0x0B;
+		constexpr static Byte REG_IFR = 0x0D;
+		constexpr static Byte REG_IER = 0x0E;
+
+		constexpr static Byte IFR_IRQ = 0x80;
+		constexpr static Byte IFR_T1 = 0x40;
+		constexpr static Byte IFR_T2 = 0x20;
+		constexpr static Byte ACR_T1_FREE_RUN = 0x40;
+
+		/* Timer events are scheduled on <cpu>, which also receives the interrupt on IRQ line <line> */
+		ViaDevice(CPUInternal* cpu, u8 line = 0);
+
+		/* Cancels any pending timer events */
+		~ViaDevice();
+
+		/* Device overrides */
+		virtual Byte read(Word address);
+		virtual void write(Word address, Byte value);
+	};
+}
@@ -0,0 +1,141 @@
+#include "emulation_thread.h"
+
+namespace E6502 {
+
+	EmulationThread::EmulationThread(CPUInternal* cpu, CPUState* cpuState, Memory* mem, size_t queueSize) : commands(queueSize), sliceCycles(10000) {
+		this->cpu = cpu;
+		state = cpuState;
+		memory = mem;
+		publish();
+	}
+
+	EmulationThread::~EmulationThread() {
+		stop();
+	}
+
+	/* Starts the emulation thread */
+	void EmulationThread::start() {
+		if (worker.joinable()) return;
+		quit = false;
+		worker = std::thread(&EmulationThread::loop, this);
+	}
+
+	/* Asks the thread to quit and waits for it */
+	void EmulationThread::stop() {
+		if (!worker.joinable()) return;
+		EmulationCommand command;
+		command.type = CMD_QUIT;
+		while (!post(command)) std::this_thread::yield();
+		worker.join();
+	}
+
+	/* Queues a command and wakes the thread if it is paused */
+	bool EmulationThread::post(const EmulationCommand& command) {
+		if (!commands.push(command)) return false;
+		std::lock_guard<std::mutex> guard(wakeLock);	// Taken so the wake up can't fall between the thread's check and its wait
+		wake.notify_one();
+		return true;
+	}
+
+	bool EmulationThread::run(u64 cycleBudget) {
+		EmulationCommand command;
+		command.type = CMD_RUN;
+		command.count = cycleBudget;
+		return post(command);
+	}
+
+	bool EmulationThread::pause() {
+		EmulationCommand command;
+		command.type = CMD_PAUSE;
+		return post(command);
+	}
+
+	bool EmulationThread::step(u64 instructions) {
+		EmulationCommand command;
+		command.type = CMD_STEP;
+		command.count = instructions;
+		return post(command);
+	}
+
+	bool EmulationThread::poke(Word address, Byte value) {
+		EmulationCommand command;
+		command.type = CMD_POKE;
+		command.address = address;
+		command.value = value;
+		return post(command);
+	}
+
+	/* Thread body - runs slices while running, sleeps while paused */
+	void EmulationThread::loop() {
+		while (!quit) {
+			EmulationCommand command;
+			bool changed = false;
+			while (commands.pop(command)) {
+				apply(command);
+				changed = true;
+			}
+			if (quit) break;
+
+			if (running) {
+				u64 slice = sliceCycles;
+				if (runUntil != 0) {
+					u64 now = cpu->getCycles();
+					slice = (runUntil > now && runUntil - now < slice) ? runUntil - now : slice;
+				}
+				lastStopReason = cpu->run(slice, resuming);
+				resuming = false;
+				if (lastStopReason != CPUInternal::STOP_BUDGET || (runUntil != 0 && cpu->getCycles() >= runUntil))
+					running = false;
+				if (!running && lastStopReason == CPUInternal::STOP_BUDGET) cpu->flushDevices();
+				publish();
+			} else {
+				if (changed) publish();
+				std::unique_lock<std::mutex> guard(wakeLock);
+				wake.wait(guard, [this] { return !commands.empty(); });
+			}
+		}
+		running = false;
+		publish();
+	}
+
+	/* Applies a single command */
+	void EmulationThread::apply(const EmulationCommand& command) {
+		switch (command.type) {
+			case CMD_RUN:
+				running = true;
+				resuming = true;
+				runUntil = command.count == 0 ? 0 : cpu->getCycles() + command.count;
+				break;
+			case CMD_PAUSE:
+				running = false;
+				cpu->flushDevices();
+				break;
+			case CMD_STEP:
+				running = false;
+				for (u64 remaining = command.count; remaining > 0; ) {
+					u8 batch = remaining > 0xFF ? 0xFF : (u8)remaining;
+					cpu->execute(batch);
+					remaining -= batch;
+				}
+				break;
+			case CMD_POKE:
+				(*memory)[command.address] = command.value;
+				break;
+			case CMD_QUIT:
+				quit = true;
+				break;
+		}
+		commandsDone++;
+	}
+
+	/* Publishes the current registers */
+	void EmulationThread::publish() {
+		EmulationSnapshot snapshot;
+		snapshot.state = *state;
+		snapshot.cycles = cpu->getCycles();
+		snapshot.stopReason = lastStopReason;
+		snapshot.running = running;
+		snapshot.commandsDone = commandsDone;
+		published.store(snapshot);
+	}
+}
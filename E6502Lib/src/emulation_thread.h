@@ -0,0 +1,101 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "types.h"
+#include "memory.h"
+#include "cpu.h"
+#include "spsc_ring.h"
+#include "seqlock.h"
+
+namespace E6502 {
+
+	/* A request from a frontend to the emulation thread */
+	struct EmulationCommand {
+		u8 type = 0;
+		Word address = 0;		// POKE
+		Byte value = 0;			// POKE
+		u64 count = 0;			// RUN: cycle budget (0 = until paused or stopped), STEP: instructions
+	};
+
+	/* What the emulation thread publishes after each slice */
+	struct EmulationSnapshot {
+		CPUState state;
+		u64 cycles = 0;
+		u8 stopReason = CPUInternal::STOP_BUDGET;	// Why the last run() returned
+		bool running = false;
+		u32 commandsDone = 0;						// Commands processed so far, lets a frontend wait for its own
+	};
+
+	/**
+	 * Runs a CPU on its own thread. Frontends send commands (run, pause, step, poke) through a lock-free queue and
+	 * read registers through a seqlock, so they never stop the CPU to look at it and the CPU never waits for them.
+	 *
+	 * Only one frontend thread may send commands (the queue has a single producer), any number may read snapshots.
+	 * While the thread owns the CPU nothing else may call it or touch its CPUState, poke memory through commands.
+	 */
+	class EmulationThread {
+	private:
+		CPUInternal* cpu;
+		Memory* memory;
+		SpscRing<EmulationCommand> commands;
+		Seqlock<EmulationSnapshot> published;
+		std::thread worker;
+		std::mutex wakeLock;					// Only used to sleep while paused
+		std::condition_variable wake;
+
+		// Emulation thread only
+		CPUState* state;
+		bool running = false;
+		bool resuming = false;					// Next slice starts a run, so steps over a breakpoint it starts on
+		bool quit = false;
+		u64 runUntil = 0;						// 0 = no budget
+		u8 lastStopReason = CPUInternal::STOP_BUDGET;
+		u32 commandsDone = 0;
+		std::atomic<u64> sliceCycles;
+
+		/* Thread body */
+		void loop();
+
+		/* Applies a single command */
+		void apply(const EmulationCommand& command);
+
+		/* Publishes the current registers */
+		void publish();
+
+	public:
+		constexpr static u8 CMD_RUN = 1;
+		constexpr static u8 CMD_PAUSE = 2;
+		constexpr static u8 CMD_STEP = 3;
+		constexpr static u8 CMD_POKE = 4;
+		constexpr static u8 CMD_QUIT = 5;
+
+		/* Controls <cpu> (whose registers are held in <cpuState>) and <mem>. The thread isn't started until start() */
+		EmulationThread(CPUInternal* cpu, CPUState* cpuState, Memory* mem, size_t queueSize = 256);
+
+		/* Stops and joins the thread */
+		~EmulationThread();
+
+		/* Starts the emulation thread, paused */
+		void start();
+
+		/* Asks the thread to quit and waits for it */
+		void stop();
+
+		/* Queues a command, returns false if the queue is full */
+		bool post(const EmulationCommand& command);
+
+		/* Helpers for post() */
+		bool run(u64 cycleBudget = 0);
+		bool pause();
+		bool step(u64 instructions = 1);
+		bool poke(Word address, Byte value);
+
+		/* The latest published state, safe from any thread at any rate */
+		EmulationSnapshot snapshot() const { return published.load(); }
+
+		/* Cycles run between checks for commands (and state publishes) */
+		void setSliceCycles(u64 cycles) { sliceCycles = cycles; }
+	};
+}
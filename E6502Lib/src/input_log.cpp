@@ -0,0 +1,235 @@
+#include <string.h>
+#include "input_log.h"
+
+namespace E6502 {
+
+	static const Byte MAGIC[4] = { 'E', '6', '5', 'I' };
+
+	static void put16(Byte* out, u16 value) { out[0] = value & 0xFF; out[1] = value >> 8; }
+	static void put64(Byte* out, u64 value) { for (int i = 0; i < 8; i++) out[i] = (value >> (i * 8)) & 0xFF; }
+	static u16 get16(const Byte* in) { return in[0] | (in[1] << 8); }
+	static u64 get64(const Byte* in) { u64 value = 0; for (int i = 7; i >= 0; i--) value = (value << 8) | in[i]; return value; }
+
+	InputRecorder::InputRecorder(CPUInternal* cpu, Memory* memory, FILE* out) : cpu(cpu), memory(memory), out(out) {}
+
+	InputRecorder::~InputRecorder() {
+		finish();
+	}
+
+	/* Writes the header, wraps the mapped devices and registers with the CPU */
+	bool InputRecorder::start() {
+		if (recording) return true;
+		buffer.clear();
+		buffer.reserve(BLOCK_SIZE + 16);
+		lastCycle = cpu->getCycles();
+		count = 0;
+		failed = false;
+
+		// Header, noting the device pages so replay knows which reads to answer
+		Byte header[InputLog::HEADER_SIZE] = {};
+		memcpy(header, MAGIC, sizeof(MAGIC));
+		put16(header + 4, InputLog::VERSION);
+		put16(header + 6, InputLog::HEADER_SIZE);
+		put64(header + 8, lastCycle);
+		for (int page = 0; page < 0x100; page++)
+			if (memory->mappedDevice(page) != nullptr)
+				header[16 + (page >> 3)] |= (1 << (page & 7));
+		if (fwrite(header, 1, sizeof(header), out) != sizeof(header)) return false;
+
+		// One proxy per device (reserved up front so the pointers handed to memory stay valid)
+		const std::vector<Device*> devices = memory->mappedDevices();
+		proxies.clear();
+		proxies.reserve(devices.size());
+		for (Device* device : devices) {
+			RecordingDevice proxy;
+			proxy.owner = this;
+			proxy.device = device;
+			proxies.push_back(proxy);
+		}
+		for (int page = 0; page < 0x100; page++) {
+			Device* device = memory->mappedDevice(page);
+			if (device == nullptr) continue;
+			for (RecordingDevice& proxy : proxies)
+				if (proxy.device == device) memory->mapDevice(page, &proxy);
+		}
+
+		cpu->setInputObserver(this);
+		recording = true;
+		return true;
+	}
+
+	/* Puts the real devices back and writes out the buffer */
+	bool InputRecorder::finish() {
+		if (!recording) return !failed;
+		cpu->setInputObserver(nullptr);
+		for (int page = 0; page < 0x100; page++) {
+			Device* device = memory->mappedDevice(page);
+			for (RecordingDevice& proxy : proxies)
+				if (device == &proxy) memory->mapDevice(page, proxy.device);
+		}
+		proxies.clear();
+		writeBuffer();
+		if (fflush(out) != 0) failed = true;
+		recording = false;
+		return !failed;
+	}
+
+	/* Appends the tag and cycle delta of a new record */
+	void InputRecorder::begin(Byte tag, u64 cycle) {
+		if (buffer.size() >= BLOCK_SIZE)
+			writeBuffer();
+		u64 delta = cycle > lastCycle ? cycle - lastCycle : 0;		// Inputs never go back in time unless setCycles() is used
+		lastCycle += delta;
+		buffer.push_back(tag);
+		do {
+			Byte next = delta & 0x7F;
+			delta >>= 7;
+			buffer.push_back(delta != 0 ? (next | 0x80) : next);
+		} while (delta != 0);
+		count++;
+	}
+
+	void InputRecorder::writeBuffer() {
+		if (!buffer.empty() && fwrite(buffer.data(), 1, buffer.size(), out) != buffer.size())
+			failed = true;
+		buffer.clear();
+	}
+
+	Byte InputRecorder::RecordingDevice::read(Word address) {
+		Byte value = device->read(address);
+		owner->logRead(address, value);
+		return value;
+	}
+
+	void InputRecorder::logRead(Word address, Byte value) {
+		begin(InputLog::TAG_READ, cpu->inputCycle());
+		buffer.push_back(address & 0xFF);
+		buffer.push_back(address >> 8);
+		buffer.push_back(value);
+	}
+
+	void InputRecorder::irqChanged(u64 cycle, u8 line, bool asserted) {
+		begin(InputLog::TAG_IRQ, cycle);
+		buffer.push_back(line | (asserted ? 0x80 : 0x00));
+	}
+
+	void InputRecorder::stopped(u64 cycle, u8 reason) {
+		begin(InputLog::TAG_STOP, cycle);
+		buffer.push_back(reason);
+	}
+
+
+	InputReplayer::InputReplayer(CPUInternal* cpu, Memory* memory) : cpu(cpu), memory(memory) {
+		device.owner = this;
+		event.owner = this;
+	}
+
+	InputReplayer::~InputReplayer() {
+		finish();
+	}
+
+	/* Decodes the whole log, reads and events are kept apart as they are consumed independently */
+	bool InputReplayer::load(FILE* in) {
+		Byte header[InputLog::HEADER_SIZE];
+		if (fread(header, 1, sizeof(header), in) != sizeof(header)) return false;
+		if (memcmp(header, MAGIC, sizeof(MAGIC)) != 0 || get16(header + 4) != InputLog::VERSION) return false;
+		u16 headerSize = get16(header + 6);
+		if (headerSize < InputLog::HEADER_SIZE) return false;
+		if (headerSize > InputLog::HEADER_SIZE && fseek(in, headerSize - InputLog::HEADER_SIZE, SEEK_CUR) != 0) return false;
+		startCycle = get64(header + 8);
+		memcpy(devicePages, header + 16, sizeof(devicePages));
+
+		std::vector<Byte> body;
+		std::vector<Byte> block(0x10000);
+		size_t got;
+		while ((got = fread(block.data(), 1, block.size(), in)) > 0)
+			body.insert(body.end(), block.begin(), block.begin() + got);
+
+		reads.clear();
+		events.clear();
+		u64 cycle = startCycle;
+		size_t pos = 0;
+		while (pos < body.size()) {
+			InputLog::Record record = {};
+			record.tag = body[pos++];
+			if (record.tag < InputLog::TAG_READ || record.tag > InputLog::TAG_STOP) return false;
+
+			u64 delta = 0;
+			int shift = 0;
+			bool more = true;
+			while (more && pos < body.size() && shift < 64) {
+				delta |= (u64)(body[pos] & 0x7F) << shift;
+				more = (body[pos++] & 0x80) != 0;
+				shift += 7;
+			}
+			size_t payload = record.tag == InputLog::TAG_READ ? 3 : 1;
+			if (more || pos + payload > body.size()) break;		// Cut short while recording
+
+			cycle += delta;
+			record.cycle = cycle;
+			if (record.tag == InputLog::TAG_READ) {
+				record.address = get16(&body[pos]);
+				record.value = body[pos + 2];
+				reads.push_back(record);
+			}
+			else {
+				record.value = body[pos];
+				events.push_back(record);
+			}
+			pos += payload;
+		}
+		nextReadIndex = 0;
+		nextEventIndex = 0;
+		diverged = false;
+		return true;
+	}
+
+	/* Takes over the recorded device pages */
+	void InputReplayer::start() {
+		if (playing) return;
+		for (int page = 0; page < 0x100; page++) {
+			if (devicePages[page >> 3] & (1 << (page & 7))) {
+				saved[page] = memory->mappedDevice(page);
+				memory->mapDevice(page, &device);
+			}
+		}
+		playing = true;
+		scheduleNext();
+	}
+
+	void InputReplayer::finish() {
+		if (!playing) return;
+		cpu->getScheduler().cancel(&event);
+		for (int page = 0; page < 0x100; page++)
+			if (memory->mappedDevice(page) == &device)
+				memory->mapDevice(page, saved[page]);
+		playing = false;
+	}
+
+	/* The next logged read, checking the guest made the same access at the same time */
+	Byte InputReplayer::nextRead(Word address) {
+		if (nextReadIndex == reads.size()) {
+			diverged = true;
+			return 0x00;
+		}
+		const InputLog::Record& record = reads[nextReadIndex++];
+		if (record.address != address || record.cycle != cpu->inputCycle())
+			diverged = true;
+		return record.value;
+	}
+
+	/* Applies every event due by <now> in recorded order */
+	void InputReplayer::fireDue(u64 now) {
+		while (nextEventIndex < events.size() && events[nextEventIndex].cycle <= now) {
+			const InputLog::Record& record = events[nextEventIndex++];
+			if (record.tag == InputLog::TAG_IRQ) cpu->setIRQ(record.value & 0x7F, (record.value & 0x80) != 0);
+			else cpu->stop(record.value);
+		}
+		scheduleNext();
+	}
+
+	void InputReplayer::scheduleNext() {
+		if (nextEventIndex < events.size())
+			cpu->getScheduler().schedule(&event, events[nextEventIndex].cycle);
+	}
+}
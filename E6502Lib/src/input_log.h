@@ -0,0 +1,175 @@
+#pragma once
+#include <stdio.h>
+#include <vector>
+#include "types.h"
+#include "memory.h"
+#include "scheduler.h"
+#include "cpu.h"
+
+namespace E6502 {
+
+	/**
+	 * Append-only log of everything a run took from outside the guest program: bytes read from devices, IRQ
+	 * changes and device stops, each stamped with the instruction boundary it affected (CPUInternal::inputCycle).
+	 * Given the same starting machine, feeding the log back reproduces the run cycle for cycle without the devices.
+	 *
+	 * Layout (little endian):
+	 *   Header   48 bytes  "E65I", version, header size, start cycle, 32 byte bitmap of device pages
+	 *   Records  tag byte, cycles since the previous record (LEB128 varint), then
+	 *              TAG_READ  address (2 bytes), value
+	 *              TAG_IRQ   line | 0x80 if asserted
+	 *              TAG_STOP  reason
+	 *
+	 * A device read is typically 5 bytes. Records are only ever appended, so a log cut short by a crash is still
+	 * valid up to its last complete record.
+	 */
+	class InputLog {
+	private:
+		InputLog();		// Only used statically
+
+	public:
+		constexpr static u16 VERSION = 1;
+		constexpr static u16 HEADER_SIZE = 48;
+
+		constexpr static Byte TAG_READ = 1;
+		constexpr static Byte TAG_IRQ = 2;
+		constexpr static Byte TAG_STOP = 3;
+
+		/* A decoded record */
+		struct Record {
+			u64 cycle;
+			Byte tag;
+			Word address;		// TAG_READ only
+			Byte value;			// Byte read, IRQ line | 0x80 if asserted or stop reason
+		};
+	};
+
+	/**
+	 * Writes an InputLog while the machine runs. start() puts a forwarding device in front of every device mapped
+	 * into memory (so only reads that really reach a device are logged) and registers with the CPU for IRQ changes
+	 * and stops. Records are buffered and written in large blocks, finish() writes the rest and puts the real
+	 * devices back.
+	 */
+	class InputRecorder : public InputObserver {
+	private:
+		/* Passes accesses through to the real device, logging what reads return */
+		struct RecordingDevice : public Device {
+			InputRecorder* owner;
+			Device* device;
+			virtual Byte read(Word address);
+			virtual void write(Word address, Byte value) { device->write(address, value); }
+			virtual void flush() { device->flush(); }
+		};
+
+		constexpr static size_t BLOCK_SIZE = 0x10000;		// Bytes buffered before each fwrite
+
+		CPUInternal* cpu;
+		Memory* memory;
+		FILE* out;
+		std::vector<RecordingDevice> proxies;
+		std::vector<Byte> buffer;
+		u64 lastCycle = 0;
+		u64 count = 0;
+		bool recording = false;
+		bool failed = false;
+
+		/* Appends a record header, writing the buffer out when it's full */
+		void begin(Byte tag, u64 cycle);
+		void writeBuffer();
+
+	public:
+		/* Records <cpu> and the devices mapped into <memory> to <out> (which stays open, owned by the caller) */
+		InputRecorder(CPUInternal* cpu, Memory* memory, FILE* out);
+		~InputRecorder();
+
+		InputRecorder(const InputRecorder&) = delete;
+		InputRecorder& operator=(const InputRecorder&) = delete;
+
+		/* Writes the header and starts recording. Devices must not be remapped until finish() */
+		bool start();
+
+		/* Stops recording and writes out everything buffered, returns false if any write failed */
+		bool finish();
+
+		/* Records written so far */
+		u64 records() const { return count; }
+
+		/* Logs a byte read from a device */
+		void logRead(Word address, Byte value);
+
+		/** InputObserver */
+		virtual void irqChanged(u64 cycle, u8 line, bool asserted);
+		virtual void stopped(u64 cycle, u8 reason);
+	};
+
+	/**
+	 * Plays an InputLog back into a machine restored to the state recording started from (same memory, registers
+	 * and cycle count). A stand-in device answers reads on the recorded device pages from the log and drops writes,
+	 * IRQ changes and stops are applied by a Scheduler event at their recorded cycles. Nothing waits on real
+	 * devices or the host, so replay runs as fast as the CPU.
+	 *
+	 * If the guest does something different from the recording (reads another address or at another cycle) the
+	 * replay is marked diverged, reads past the end of the log return 0x00.
+	 */
+	class InputReplayer {
+	private:
+		/* Answers device reads from the log */
+		struct ReplayDevice : public Device {
+			InputReplayer* owner;
+			virtual Byte read(Word address) { return owner->nextRead(address); }
+			virtual void write(Word, Byte) {}
+		};
+
+		/* Applies IRQ changes and stops once their cycle comes round */
+		struct ReplayEvent : public Event {
+			InputReplayer* owner;
+			virtual void fire(u64 now) { owner->fireDue(now); }
+		};
+
+		CPUInternal* cpu;
+		Memory* memory;
+		ReplayDevice device;
+		ReplayEvent event;
+		std::vector<InputLog::Record> reads;
+		std::vector<InputLog::Record> events;
+		size_t nextReadIndex = 0;
+		size_t nextEventIndex = 0;
+		Byte devicePages[32] = {};
+		Device* saved[0x100] = {};
+		u64 startCycle = 0;
+		bool playing = false;
+		bool diverged = false;
+
+		Byte nextRead(Word address);
+		void fireDue(u64 now);
+		void scheduleNext();
+
+	public:
+		InputReplayer(CPUInternal* cpu, Memory* memory);
+		~InputReplayer();
+
+		InputReplayer(const InputReplayer&) = delete;
+		InputReplayer& operator=(const InputReplayer&) = delete;
+
+		/* Reads a whole log from <in>. Returns false if it isn't an InputLog, a truncated final record is ignored */
+		bool load(FILE* in);
+
+		/* Maps the stand-in device over the recorded device pages and schedules the first event */
+		void start();
+
+		/* Cancels the pending event and restores the previous page mappings */
+		void finish();
+
+		/* Cycle the recording started at, the CPU should be set to this before start() */
+		u64 getStartCycle() const { return startCycle; }
+
+		/* True once every record has been replayed */
+		bool isComplete() const { return nextReadIndex == reads.size() && nextEventIndex == events.size(); }
+
+		/* True if the run stopped matching the log */
+		bool hasDiverged() const { return diverged; }
+
+		/* Records in the loaded log */
+		size_t records() const { return reads.size() + events.size(); }
+	};
+}
@@ -5,22 +5,26 @@ namespace E6502 {
 
 	/** Handles execution of ADC instructions */
 	void ArithmeticInstruction::adcHandler(CPU* cpu, u8& cycles, Byte opCode) {
-		// Memory mode
-		Byte md = (opCode >> 2) & 0x7;					// Memory Mode (bits 4,3,2)
-		Byte operandB = 0x00;
-
-		if (md == ADDRESS_MODE_IMMEDIATE) {				// Base class can't handle immediate instructions
-			operandB = cpu->readPCByte(cycles);
-		} else {
-			Reference ref = BaseInstruction::getReferenceForMode(cpu, cycles, md);
-			operandB = cpu->readReferenceByte(cycles, ref);
-		}
+		Byte operandB = readOperand(cpu, cycles, opCode);
 		cpu->addAccumulator(cycles, operandB);
 	}
 
 	/** Handles execution of SBC instructions */
 	void ArithmeticInstruction::sbcHandler(CPU* cpu, u8& cycles, Byte opCode) {
-		// TODO
+		Byte operandB = readOperand(cpu, cycles, opCode);
+		cpu->subAccumulator(cycles, operandB);
+	}
+
+	/** Reads the operand for an arithmetic instruction based on its addressing mode */
+	Byte ArithmeticInstruction::readOperand(CPU* cpu, u8& cycles, Byte opCode) {
+		// Memory mode
+		Byte md = (opCode >> 2) & 0x7;					// Memory Mode (bits 4,3,2)
+
+		if (md == ADDRESS_MODE_IMMEDIATE)				// Base class can't handle immediate instructions
+			return cpu->readPCByte(cycles);
+
+		Reference ref = BaseInstruction::getReferenceForMode(cpu, cycles, md);
+		return cpu->readReferenceByte(cycles, ref);
 	}
 
 	/** Called to add arithmetic instruction handlers to the emulator */
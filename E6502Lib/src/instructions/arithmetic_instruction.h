@@ -4,6 +4,10 @@
 namespace E6502 {
 
 	class ArithmeticInstruction : public BaseInstruction {
+	private:
+		/** Reads the operand for an arithmetic instruction based on its addressing mode */
+		static Byte readOperand(CPU* cpu, u8& cycles, Byte opCode);
+
 	public:
 
 		/** Handles execution of all ADC instructions */
@@ -27,7 +31,14 @@ namespace E6502 {
 	constexpr static InstructionHandler INS_ADC_INY = { 0x71, true, "ADC - Add Memory to Accumulator with Carry [Zero Page Y-Indexed Indirect]", ArithmeticInstruction::adcHandler };
 
 	// SBC instruction defs
-	constexpr static InstructionHandler INS_SBC_IMM = { 0xE9, true, "ADC - Subtract Memory from Accumulator with Borrow [Immedate]", ArithmeticInstruction::sbcHandler };
+	constexpr static InstructionHandler INS_SBC_IMM = { 0xE9, true, "SBC - Subtract Memory from Accumulator with Borrow [Immedate]", ArithmeticInstruction::sbcHandler };
+	constexpr static InstructionHandler INS_SBC_ABS = { 0xED, true, "SBC - Subtract Memory from Accumulator with Borrow [Absolute]", ArithmeticInstruction::sbcHandler };
+	constexpr static InstructionHandler INS_SBC_ABX = { 0xFD, true, "SBC - Subtract Memory from Accumulator with Borrow [X-Indexed Absolute]", ArithmeticInstruction::sbcHandler };
+	constexpr static InstructionHandler INS_SBC_ABY = { 0xF9, true, "SBC - Subtract Memory from Accumulator with Borrow [Y-Indexed Absolute]", ArithmeticInstruction::sbcHandler };
+	constexpr static InstructionHandler INS_SBC_ZP0 = { 0xE5, true, "SBC - Subtract Memory from Accumulator with Borrow [Zero Page]", ArithmeticInstruction::sbcHandler };
+	constexpr static InstructionHandler INS_SBC_ZPX = { 0xF5, true, "SBC - Subtract Memory from Accumulator with Borrow [X-Indexed Zero Page]", ArithmeticInstruction::sbcHandler };
+	constexpr static InstructionHandler INS_SBC_INX = { 0xE1, true, "SBC - Subtract Memory from Accumulator with Borrow [X-Indexed Zero Page Indirect]", ArithmeticInstruction::sbcHandler };
+	constexpr static InstructionHandler INS_SBC_INY = { 0xF1, true, "SBC - Subtract Memory from Accumulator with Borrow [Zero Page Y-Indexed Indirect]", ArithmeticInstruction::sbcHandler };
 
 	// Array of all Arithmetic instructions
 	static constexpr InstructionHandler ARITHMETIC_INSTRUCTIONS[] = {
@@ -36,6 +47,7 @@ namespace E6502 {
 		INS_ADC_ZP0, INS_ADC_ZPX, INS_ADC_INX, INS_ADC_INY,
 
 		// SBC Instructions
-		INS_SBC_IMM,
+		INS_SBC_IMM, INS_SBC_ABS, INS_SBC_ABX, INS_SBC_ABY,
+		INS_SBC_ZP0, INS_SBC_ZPX, INS_SBC_INX, INS_SBC_INY,
 	};
 }
@@ -31,7 +31,7 @@ namespace E6502 {
 				preAddr = cpu->readWord(cycles, preAddr);
 				addr = preAddr + cpu->regValue(cycles, CPU::REGISTER_Y);
 				// Add cycle if page crossed
-				if ((addr & 0xFF) < (preAddr & 0xFF)) cycles++;
+				if ((addr & 0xFF) < (preAddr & 0xFF)) cpu->pageCrossed(cycles);
 				return Reference{ CPU::REFERENCE_MEM, addr };
 			case ADDRESS_MODE_ZERO_PAGE_X:
 				addr = cpu->readPCByte(cycles); cycles++;
@@ -41,13 +41,13 @@ namespace E6502 {
 				preAddr = cpu->readPCWord(cycles);
 				addr = preAddr + cpu->regValue(cycles, CPU::REGISTER_Y);
 				// Increment cycles if page crossed
-				if ((preAddr & 0xFF) > (addr & 0xFF)) cycles++;
+				if ((preAddr & 0xFF) > (addr & 0xFF)) cpu->pageCrossed(cycles);
 				return Reference{ CPU::REFERENCE_MEM, addr };
 			case ADDRESS_MODE_ABSOLUTE_X:
 				preAddr = cpu->readPCWord(cycles);
 				addr = preAddr + cpu->regValue(cycles, CPU::REGISTER_X);
 				// Increment cycles if page crossed
-				if ((preAddr & 0xFF) > (addr & 0xFF)) cycles++;
+				if ((preAddr & 0xFF) > (addr & 0xFF)) cpu->pageCrossed(cycles);
 				return Reference{ CPU::REFERENCE_MEM, addr };
 			default: {
 				fprintf(stderr, "Unknown memory mode %d in BaseInstruction::getByteForMode\n", mode);
@@ -73,6 +73,20 @@ namespace E6502 {
 		cycles++;
 	}
 
+	/* Handles RTI instructions - restores the flags and PC pushed when the interrupt was taken */
+	void JumpInstruction::rtiHandler(CPU* cpu, u8& cycles, Byte opCode) {
+		FlagUnion flags = cpu->getFlags(cycles);
+		Byte value = cpu->pullStackByte(cycles);
+		flags.byte = (flags.byte & 0x30) | (value & 0xCF);		// As PLP, bits 4 and 5 are not restored
+		cpu->setFlags(cycles, flags);
+
+		Word targetAddress = cpu->pullStackWord(cycles);
+		cpu->setPC(cycles, targetAddress);
+
+		// Cycle correction - the flags are copied while the PC is pulled
+		cycles--;
+	}
+
 	/** Implementation of addhandlers needs to be after the struct defs */
 	void JumpInstruction::addHandlers(InstructionHandler* handlers[]) {
 		for (InstructionHandler handler : JUMP_INSTRUCTIONS) {
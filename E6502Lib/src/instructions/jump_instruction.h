@@ -15,18 +15,22 @@ namespace E6502 {
 		/** Actually handles execution of RST instruction */
 		static void rstHandler(CPU* cpu, u8& cycles, Byte opCode);
 
+		/** Actually handles execution of RTI instruction */
+		static void rtiHandler(CPU* cpu, u8& cycles, Byte opCode);
+
 		/** Called to add LDA Instruction handlers to the emulator */
 		static void addHandlers(InstructionHandler* handlers[]);
 	};
 
-	/** JSR, JMP, RTS Instruction Definitions */
+	/** JSR, JMP, RTS, RTI Instruction Definitions */
 	constexpr static InstructionHandler INS_JSR			= { 0x20, true, "JSR - Jump to Subroutine [Absolute]",		JumpInstruction::jsrHandler };
 	constexpr static InstructionHandler INS_JMP_ABS		= { 0x4C, true, "JMP - Jump [Absolute]",					JumpInstruction::jmpHandler };
 	constexpr static InstructionHandler INS_JMP_ABIN	= { 0x6C, true, "JMP - Jump [Absolute Indirect]",			JumpInstruction::jmpHandler };
 	constexpr static InstructionHandler INS_RTS			= { 0x60, true, "RTS - Return from subroutine [Implied]",	JumpInstruction::rstHandler };
+	constexpr static InstructionHandler INS_RTI			= { 0x40, true, "RTI - Return from Interrupt [Implied]",	JumpInstruction::rtiHandler };
 
 	// Handy array of all load instructions
 	static constexpr InstructionHandler JUMP_INSTRUCTIONS[] = {
-		INS_JSR, INS_JMP_ABS, INS_JMP_ABIN, INS_RTS
+		INS_JSR, INS_JMP_ABS, INS_JMP_ABIN, INS_RTS, INS_RTI
 	};
 }
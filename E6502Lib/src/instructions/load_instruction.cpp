@@ -72,7 +72,7 @@ namespace E6502 {
 
 		//Check for page bouundry
 		if (lsb < index) {
-			msb++; cycles++;
+			msb++; cpu->pageCrossed(cycles);
 		}
 
 		// Calculate address and read memory into A
@@ -102,7 +102,7 @@ namespace E6502 {
 		// Add Register if IndirectY
 		if (opCode == INS_LDA_INDY.opcode) {
 			targetAddress += cpu->regValue(cycles, CPU::REGISTER_Y);
-			if ((targetAddress & 0x00FF) < cpu->regValue(cycles, CPU::REGISTER_Y)) cycles++; // Add a cycle iff we crossed a page boundry
+			if ((targetAddress & 0x00FF) < cpu->regValue(cycles, CPU::REGISTER_Y)) cpu->pageCrossed(cycles); // Add a cycle iff we crossed a page boundry
 		}
 
 		// Save value
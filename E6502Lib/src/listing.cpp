@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <ctype.h>
+#include <string.h>
+#include "listing.h"
+#include "mapped_file.h"
+
+namespace E6502 {
+
+	/* Every 6502 mnemonic, sorted for binary search */
+	static const char* const MNEMONICS[] = {
+		"ADC", "AND", "ASL", "BCC", "BCS", "BEQ", "BIT", "BMI", "BNE", "BPL", "BRK", "BVC", "BVS", "CLC",
+		"CLD", "CLI", "CLV", "CMP", "CPX", "CPY", "DEC", "DEX", "DEY", "EOR", "INC", "INX", "INY", "JMP",
+		"JSR", "LDA", "LDX", "LDY", "LSR", "NOP", "ORA", "PHA", "PHP", "PLA", "PLP", "ROL", "ROR", "RTI",
+		"RTS", "SBC", "SEC", "SED", "SEI", "STA", "STX", "STY", "TAX", "TAY", "TSX", "TXA", "TXS", "TYA",
+	};
+
+	static int hexValue(char c) {
+		if (c >= '0' && c <= '9') return c - '0';
+		if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+		if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+		return -1;
+	}
+
+	/* The 4 digit hex number at <in>, -1 if there isn't one */
+	static s32 hexWord(const char* in) {
+		s32 value = 0;
+		for (int i = 0; i < 4; i++) {
+			int digit = hexValue(in[i]);
+			if (digit < 0) return -1;
+			value = (value << 4) | digit;
+		}
+		return value;
+	}
+
+	/* True if <word> (any case) is a 6502 mnemonic */
+	bool Listing::isMnemonic(const char* word, size_t length) {
+		if (length != 3) return false;
+		char upper[4] = { (char)toupper(word[0]), (char)toupper(word[1]), (char)toupper(word[2]), 0 };
+		const char* const* end = MNEMONICS + sizeof(MNEMONICS) / sizeof(MNEMONICS[0]);
+		const char* const* found = std::lower_bound(MNEMONICS, end, upper, [](const char* a, const char* b) { return strcmp(a, b) < 0; });
+		return found != end && strcmp(*found, upper) == 0;
+	}
+
+	/* Reads the listing at <path> */
+	bool Listing::load(const char* path) {
+		MappedFile file;
+		if (!file.open(path)) return false;
+		load((const char*)file.data(), file.size());
+		return true;
+	}
+
+	/* Parses a listing held in memory */
+	void Listing::load(const char* data, size_t size) {
+		text.assign(data == nullptr ? "" : data, data == nullptr ? 0 : size);
+		parse();
+	}
+
+	/* Splits the text into lines and parses each */
+	void Listing::parse() {
+		lines.clear();
+		size_t start = 0;
+		while (start < text.size()) {
+			size_t end = text.find('\n', start);
+			if (end == std::string::npos) end = text.size();
+			ListingLine line;
+			line.offset = (u32)start;
+			line.length = (u32)(end - start);
+			if (line.length > 0 && text[end - 1] == '\r') line.length--;
+			lines.push_back(line);
+			start = end + 1;
+		}
+
+		// The format is whichever the address lines are in, it decides where the source starts on the other lines
+		bool as65 = false;
+		for (ListingLine& line : lines) {
+			if (parseAS65(line)) as65 = true;
+			else parseNumbered(line);
+		}
+		u32 column = as65 ? (u32)AS65_SOURCE_COLUMN : (u32)NUMBERED_SOURCE_COLUMN;
+		byAddress.clear();
+		for (u32 i = 0; i < lines.size(); i++) {
+			ListingLine& line = lines[i];
+			if (line.address < 0) line.source = line.length < column ? line.length : column;
+			classify(line);
+			findLabel(line, as65);
+			if (line.size > 0 && !line.equate) byAddress.push_back(i);
+		}
+		std::stable_sort(byAddress.begin(), byAddress.end(), [this](u32 a, u32 b) { return lines[a].address < lines[b].address; });
+	}
+
+	/* Parses an AS65 line ("addr : bytes   source" or "addr = value") */
+	bool Listing::parseAS65(ListingLine& line) const {
+		const char* in = text.data() + line.offset;
+		if (line.length < 6 || in[4] != ' ' || (in[5] != ':' && in[5] != '=')) return false;
+		if (line.length > 6 && in[6] != ' ') return false;
+		s32 address = hexWord(in);
+		if (address < 0) return false;
+
+		line.address = address;
+		line.equate = in[5] == '=';
+		u32 bytes = 7;
+		while (bytes < line.length && hexValue(in[bytes]) >= 0) bytes++;
+		line.size = line.equate ? 0 : (u16)((bytes - 7) / 2);
+		line.source = line.length < AS65_SOURCE_COLUMN ? line.length : (u32)AS65_SOURCE_COLUMN;
+		return true;
+	}
+
+	/* Parses a numbered line ("  12 addr xx xx xx  source") or its continuation ("     addr xx xx") */
+	bool Listing::parseNumbered(ListingLine& line) const {
+		const char* in = text.data() + line.offset;
+		if (line.length < 9 || in[4] != ' ') return false;
+		for (int i = 0; i < 4; i++)
+			if (in[i] != ' ' && !isdigit((unsigned char)in[i])) return false;
+		if (line.length > 9 && in[9] != ' ') return false;
+		s32 address = hexWord(in + 5);
+		if (address < 0) return false;
+
+		line.address = address;
+		u32 column = 10;
+		while (column + 1 < line.length && column + 1 < NUMBERED_SOURCE_COLUMN && hexValue(in[column]) >= 0 && hexValue(in[column + 1]) >= 0) {
+			line.size++;
+			column += 3;
+		}
+		line.source = line.length < NUMBERED_SOURCE_COLUMN ? line.length : (u32)NUMBERED_SOURCE_COLUMN;
+		return true;
+	}
+
+	/* An instruction is a mnemonic, after the label if the source starts with one */
+	void Listing::classify(ListingLine& line) const {
+		if (line.address < 0 || line.size == 0 || line.equate) return;
+		const char* in = text.data() + line.offset;
+		u32 at = line.source;
+		if (at < line.length && !isspace((unsigned char)in[at]) && in[at] != ';' && in[at] != '>') {
+			while (at < line.length && !isspace((unsigned char)in[at])) at++;
+		}
+		while (at < line.length && (isspace((unsigned char)in[at]) || in[at] == '>')) at++;
+		u32 word = at;
+		while (at < line.length && isalpha((unsigned char)in[at])) at++;
+		line.instruction = isMnemonic(in + word, at - word);
+	}
+
+	static bool isLabelStart(char c) {
+		return isalpha((unsigned char)c) || c == '_';
+	}
+
+	static bool isLabelChar(char c) {
+		return isalnum((unsigned char)c) || c == '_' || c == '.';
+	}
+
+	/* A label is a name at the start of the source that isn't a mnemonic */
+	void Listing::findLabel(ListingLine& line, bool as65) const {
+		const char* in = text.data() + line.offset;
+		u32 at = line.source;
+		if (at >= line.length || !isLabelStart(in[at])) return;
+		if (as65 && (line.address < 0 || (at > 0 && in[at - 1] == '>'))) return;
+		u32 end = at;
+		while (end < line.length && isLabelChar(in[end])) end++;
+		if (isMnemonic(in + at, end - at)) return;
+
+		// Without an address the label belongs to the next line with one, unless it is being given a value here
+		if (line.address < 0) {
+			u32 next = end;
+			while (next < line.length && isspace((unsigned char)in[next])) next++;
+			if (next < line.length && in[next] == '=') return;
+			if (next + 3 <= line.length && tolower(in[next]) == 'e' && tolower(in[next + 1]) == 'q' && tolower(in[next + 2]) == 'u'
+				&& (next + 3 == line.length || !isLabelChar(in[next + 3]))) return;
+		}
+		line.label = (u16)(end - at);
+	}
+
+	/* The whole text of line <index> */
+	std::string Listing::lineText(size_t index) const {
+		return text.substr(lines[index].offset, lines[index].length);
+	}
+
+	/* The source text of line <index> */
+	std::string Listing::sourceText(size_t index) const {
+		const ListingLine& line = lines[index];
+		return text.substr(line.offset + line.source, line.length - line.source);
+	}
+
+	/* The label on line <index> */
+	std::string Listing::labelText(size_t index) const {
+		const ListingLine& line = lines[index];
+		return text.substr(line.offset + line.source, line.label);
+	}
+
+	/* Binary search of the lines in address order */
+	s32 Listing::lineAt(Word address) const {
+		auto after = std::upper_bound(byAddress.begin(), byAddress.end(), address,
+			[this](Word value, u32 index) { return value < lines[index].address; });
+		if (after == byAddress.begin()) return -1;
+		const ListingLine& line = lines[*(after - 1)];
+		return address < line.address + line.size ? (s32)*(after - 1) : -1;
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "types.h"
+
+namespace E6502 {
+
+	/* One line of an assembler listing */
+	struct ListingLine {
+		u32 offset = 0;				// Start of the line in the listing text
+		u32 length = 0;				// Length without the line ending
+		u32 source = 0;				// Offset of the source text within the line (== length if there is none)
+		s32 address = -1;			// Address of the first byte assembled on the line, -1 if none
+		u16 size = 0;				// Bytes assembled on the line
+		u16 label = 0;				// Length of the label the source starts with, 0 if none
+		bool equate = false;		// The address is a symbol's value (AS65 "=" lines: equates and org)
+		bool instruction = false;	// The source is a 6502 instruction rather than data or a directive
+	};
+
+	/**
+	 * An assembler listing, as written by AS65 for Assembly/func_test.lst or the line numbered listings like
+	 * Assembly/helloworld.lst. Both formats put the address and bytes assembled in fixed columns ahead of the
+	 * source:
+	 *
+	 *   AS65       "05a4 : 10fe            >        bpl *"       address : bytes, source from column 24
+	 *              "04e6 =                  range_adr   = *+1"  address = equate value
+	 *   Numbered   "   7 1002 20 0c 10     \tjsr pushchar"       line, address, bytes, source from column 23
+	 *              "     1104 6f 20 77 6f"                       continuation of the line above
+	 *
+	 * The text is kept whole and lines refer into it, so a listing loads in one pass with no per-line allocation.
+	 *
+	 * A label is a name starting the source. AS65 lists every label with its address (on a line of its own if
+	 * nothing is assembled there), numbered listings put it on a line without one - it belongs to the next address.
+	 * AS65 labels from macro expansions are left out as macros may redefine them each time they're used.
+	 */
+	class Listing {
+	private:
+		std::string text;
+		std::vector<ListingLine> lines;
+		std::vector<u32> byAddress;		// Lines that assembled bytes, in address order
+
+		/* Splits the text into lines and parses each */
+		void parse();
+
+		/* Parses an AS65 line, false if it isn't one with an address */
+		bool parseAS65(ListingLine& line) const;
+
+		/* Parses a numbered line (or its continuation), false if it isn't one with an address */
+		bool parseNumbered(ListingLine& line) const;
+
+		/* Sets ListingLine::instruction from the source text */
+		void classify(ListingLine& line) const;
+
+		/* Sets ListingLine::label from the source text */
+		void findLabel(ListingLine& line, bool as65) const;
+
+	public:
+		constexpr static u32 AS65_SOURCE_COLUMN = 24;
+		constexpr static u32 NUMBERED_SOURCE_COLUMN = 23;
+
+		/* Reads the listing at <path>, false if it can't be read */
+		bool load(const char* path);
+
+		/* Parses a listing held in memory */
+		void load(const char* data, size_t size);
+
+		/* Number of lines */
+		size_t size() const { return lines.size(); }
+
+		/* Line <index> (0 based, so line number index + 1) */
+		const ListingLine& line(size_t index) const { return lines[index]; }
+
+		/* The whole text of line <index> */
+		std::string lineText(size_t index) const;
+
+		/* The source text of line <index> (empty if none) */
+		std::string sourceText(size_t index) const;
+
+		/* The label on line <index> (empty if none) */
+		std::string labelText(size_t index) const;
+
+		/* Index of the line that assembled the byte at <address>, -1 if none did */
+		s32 lineAt(Word address) const;
+
+		/* True if <word> (any case) is a 6502 mnemonic */
+		static bool isMnemonic(const char* word, size_t length);
+	};
+}
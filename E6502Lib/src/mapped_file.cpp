@@ -0,0 +1,75 @@
+#include <stdio.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "mapped_file.h"
+
+namespace E6502 {
+
+	MappedFile::~MappedFile() {
+		close();
+	}
+
+#ifndef _WIN32
+	bool MappedFile::open(const char* path) {
+		close();
+		int fd = ::open(path, O_RDONLY);
+		if (fd < 0) return false;
+		struct stat info;
+		if (fstat(fd, &info) != 0) {
+			::close(fd);
+			return false;
+		}
+		length = (size_t)info.st_size;
+		if (length > 0) {
+			void* result = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (result == MAP_FAILED) {
+				::close(fd);
+				length = 0;
+				return false;
+			}
+			bytes = (const Byte*)result;
+			mapped = true;
+		}
+		::close(fd);		// The mapping keeps its own reference
+		return true;
+	}
+
+	void MappedFile::close() {
+		if (mapped) munmap((void*)bytes, length);
+		mapped = false;
+		bytes = nullptr;
+		length = 0;
+		copy.clear();
+	}
+#else
+	/* No mmap - read the file in instead */
+	bool MappedFile::open(const char* path) {
+		close();
+		FILE* fp = NULL;
+		if (fopen_s(&fp, path, "rb")) return false;
+		Byte block[0x10000];
+		size_t got;
+		while ((got = fread(block, 1, sizeof(block), fp)) > 0)
+			copy.insert(copy.end(), block, block + got);
+		bool ok = ferror(fp) == 0;
+		fclose(fp);
+		if (!ok) {
+			copy.clear();
+			return false;
+		}
+		bytes = copy.empty() ? nullptr : copy.data();
+		length = copy.size();
+		return true;
+	}
+
+	void MappedFile::close() {
+		bytes = nullptr;
+		length = 0;
+		copy.clear();
+	}
+#endif
+}
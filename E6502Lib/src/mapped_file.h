@@ -0,0 +1,37 @@
+#pragma once
+#include <vector>
+#include "types.h"
+
+namespace E6502 {
+
+	/**
+	 * A whole file mapped read only, so large traces and listings can be read without copying them in.
+	 * Without mmap support the file is read into memory instead.
+	 */
+	class MappedFile {
+	private:
+		const Byte* bytes = nullptr;
+		size_t length = 0;
+		bool mapped = false;
+		std::vector<Byte> copy;		// Contents when the file couldn't be mapped
+
+	public:
+		MappedFile() {}
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		/* Maps the file at <path>, replacing any file already open. Returns false if it can't be read */
+		bool open(const char* path);
+
+		/* Releases the file */
+		void close();
+
+		/* Start of the file contents (nullptr if empty or not open) */
+		const Byte* data() const { return bytes; }
+
+		/* Size of the file */
+		size_t size() const { return length; }
+	};
+}
@@ -0,0 +1,120 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "memory.h"
+
+namespace E6502 {
+
+	/* Every page starts as plain RAM */
+	void Memory::initPages() {
+		protectedPage.memory = this;
+		for (int page = 0; page < 0x100; page++)
+			updatePage(page);
+	}
+
+#ifndef _WIN32
+	/* Maps 64KB of zero filled memory, pages are only allocated when first written */
+	static Byte* mapAnonymous(Byte* at) {
+		int flags = MAP_PRIVATE | MAP_ANONYMOUS | (at != nullptr ? MAP_FIXED : 0);
+		void* result = mmap(at, MAX_MEM, PROT_READ | PROT_WRITE, flags, -1, 0);
+		return result == MAP_FAILED ? nullptr : (Byte*)result;
+	}
+
+	Memory::Memory() {
+		data = mapAnonymous(nullptr);
+		if (data == nullptr) {
+			fprintf(stderr, "Unable to allocate memory, abort!");
+			abort();
+		}
+		initPages();
+	}
+
+	Memory::~Memory() {
+		munmap(data, MAX_MEM);
+	}
+
+	/* Reset memory to all 0's */
+	void Memory::reset() {
+		if (imageMapped) {
+			// Replacing the mapping drops the file and any copied pages at once. Zeroing instead would write through to a
+			// shared image, so there is nothing to fall back to
+			if (mapAnonymous(data) == nullptr) {
+				fprintf(stderr, "Unable to reset memory, abort!");
+				abort();
+			}
+			imageMapped = false;
+		} else {
+			memset(data, 0x00, MAX_MEM);
+		}
+	}
+
+	/* Maps a file over part of memory */
+	bool Memory::mapImage(const char* path, u8 mode, Word address, u32 length, u64 fileOffset) {
+		u32 granularity = mapGranularity();
+		if (length == 0 || address + length > MAX_MEM) return false;
+		if (address % granularity != 0 || length % granularity != 0 || fileOffset % granularity != 0) return false;
+
+		int fd = open(path, mode == MAP_WRITE_THROUGH ? O_RDWR : O_RDONLY);
+		if (fd < 0) return false;
+
+		// Touching a mapped page past the end of the file would fault
+		struct stat info;
+		if (fstat(fd, &info) != 0 || (u64)info.st_size < fileOffset + length) {
+			close(fd);
+			return false;
+		}
+
+		int flags = (mode == MAP_WRITE_THROUGH ? MAP_SHARED : MAP_PRIVATE) | MAP_FIXED;
+		void* result = mmap(data + address, length, PROT_READ | PROT_WRITE, flags, fd, (off_t)fileOffset);
+		close(fd);		// The mapping keeps its own reference
+		if (result == MAP_FAILED) return false;
+		imageMapped = true;
+		return true;
+	}
+
+	/* Host page size */
+	u32 Memory::mapGranularity() {
+		return (u32)sysconf(_SC_PAGESIZE);
+	}
+#else
+	Memory::Memory() {
+		data = new Byte[MAX_MEM]();
+		initPages();
+	}
+
+	Memory::~Memory() {
+		delete[] data;
+	}
+
+	/* Reset memory to all 0's */
+	void Memory::reset() {
+		memset(data, 0x00, MAX_MEM);
+		imageMapped = false;
+	}
+
+	/* No mmap - read the image in instead */
+	bool Memory::mapImage(const char* path, u8 mode, Word address, u32 length, u64 fileOffset) {
+		if (mode == MAP_WRITE_THROUGH || length == 0 || address + length > MAX_MEM) return false;
+		FILE* fp = NULL;
+		if (fopen_s(&fp, path, "rb")) return false;
+		std::vector<Byte> image(length);
+		bool ok = _fseeki64(fp, (long long)fileOffset, SEEK_SET) == 0 && fread(image.data(), 1, length, fp) == length;
+		fclose(fp);
+		if (!ok) return false;
+		memcpy(data + address, image.data(), length);
+		imageMapped = true;
+		return true;
+	}
+
+	/* Any alignment works when images are copied */
+	u32 Memory::mapGranularity() {
+		return 0x100;
+	}
+#endif
+}
@@ -1,22 +1,80 @@
 #pragma once
+#include <algorithm>
 #include "types.h"
+#include "device.h"
 
 namespace E6502 {
 	static constexpr int MAX_MEM = 0x10000;	// Maximum addressable meory
 
 	// System Memory
 	struct Memory {
+	public:
+		/* Where CPU accesses to a page go, one lookup gives both the device check and the write target */
+		struct Page {
+			Device* device;		// Handles reads & writes if not nullptr
+			Byte* write;		// Start of the page for writes - the page's data for RAM, a scratch page if protected
+		};
+
 	private:
-		Byte data[MAX_MEM] = {};	//Actual data
+		/* Stands in as the device for protected pages while a write trap is set */
+		struct ProtectedPage : public Device {
+			Memory* memory = nullptr;
+			virtual Byte read(Word address) { return (*memory)[address]; }
+			virtual void write(Word address, Byte value) { memory->writeTrap->write(address, value); }
+		};
 
-	public:
+		Byte* data;						// Actual data - an anonymous mapping (zero filled on demand) that image files are mapped over
+		bool imageMapped = false;		// True once mapImage() has replaced part of the anonymous mapping
+		Device* devices[0x100] = {};	// Device mapped to each page (nullptr for plain memory)
+		std::vector<Device*> mapped;	// Each distinct mapped device once
+		Byte types[0x100] = {};			// PAGE_ type of each page
+		Page pages[0x100];				// Effective CPU view of each page, rebuilt whenever a page changes
+		Byte discard[0x100];			// Writes to protected pages land here
+		Device* writeTrap = nullptr;
+		ProtectedPage protectedPage;
+
+		/* Sets up the page table for the current data pointer */
+		void initPages();
 
-		/* Reset memory to all 0's */
-		virtual void reset() {
-			for (int i = 0; i < MAX_MEM; i++)
-				data[i] = 0x00;
+		/* Recalculates pages[page] */
+		void updatePage(Byte page) {
+			bool writable = types[page] == PAGE_RAM;
+			pages[page].write = writable ? data + (page << 8) : discard;
+			pages[page].device = devices[page];
+			if (devices[page] == nullptr && !writable && writeTrap != nullptr)
+				pages[page].device = &protectedPage;
 		}
 
+	public:
+		/* Page types */
+		constexpr static u8 PAGE_RAM = 0;			// Read / write (default)
+		constexpr static u8 PAGE_ROM = 1;			// CPU writes are dropped (or sent to the write trap)
+		constexpr static u8 PAGE_UNMAPPED = 2;		// Nothing there - treated as ROM, reads see the (normally zero) backing memory
+
+		/* mapImage() modes */
+		constexpr static u8 MAP_COPY_ON_WRITE = 0;	// Writes stay private to this instance, pages are shared until written (RAM or ROM images)
+		constexpr static u8 MAP_WRITE_THROUGH = 1;	// Writes go to the file, so other processes mapping it see memory live
+
+		Memory();
+		virtual ~Memory();
+
+		Memory(const Memory&) = delete;
+		Memory& operator=(const Memory&) = delete;
+
+		/* Reset memory to all 0's, releasing any mapped image. Page types and devices are kept */
+		virtual void reset();
+
+		/**
+		 * Use <length> bytes of the file at <path> (from <fileOffset>) as the memory at <address>, without copying it.
+		 * <address>, <length> and <fileOffset> must be multiples of mapGranularity() and the file must be long enough.
+		 * Returns false if the file can't be mapped (memory is unchanged). Without mmap support the image is read in
+		 * and MAP_WRITE_THROUGH is not available.
+		 */
+		bool mapImage(const char* path, u8 mode = MAP_COPY_ON_WRITE, Word address = 0x0000, u32 length = MAX_MEM, u64 fileOffset = 0);
+
+		/* Alignment needed by mapImage() (the host page size) */
+		static u32 mapGranularity();
+
 		/**
 		* Load a program into memory at the given address.
 		* Notes: memory will wrap around after 0xFFFF and no size check will be done on prgram array
@@ -28,6 +86,62 @@ namespace E6502 {
 			}
 		}
 
+		/* Map a device to a page of memory, CPU reads & writes to the page go to the device. nullptr removes the mapping */
+		void mapDevice(Byte page, Device* device) {
+			devices[page] = device;
+			updatePage(page);
+			mapped.clear();
+			for (Device* next : devices)
+				if (next != nullptr && std::find(mapped.begin(), mapped.end(), next) == mapped.end())
+					mapped.push_back(next);
+		}
+
+		/* All devices mapped to at least one page */
+		const std::vector<Device*>& mappedDevices() const {
+			return mapped;
+		}
+
+		/* The device mapped to <page> with mapDevice(), or nullptr */
+		Device* mappedDevice(Byte page) const {
+			return devices[page];
+		}
+
+		/* The device mapped at the given address, or nullptr */
+		Device* deviceAt(Word address) const {
+			return pages[address >> 8].device;
+		}
+
+		/* CPU view of the page holding <address> */
+		const Page& pageAt(Word address) const {
+			return pages[address >> 8];
+		}
+
+		/* Sets the type of a page (one of the PAGE_ constants). The host can still write anything via operator[] */
+		void setPageType(Byte page, u8 type) {
+			types[page] = type;
+			updatePage(page);
+		}
+
+		/* Sets the type of every page overlapping <length> bytes from <address> */
+		void setRegionType(Word address, u32 length, u8 type) {
+			if (length == 0) return;
+			u32 last = (address + length - 1) >> 8;
+			for (u32 page = address >> 8; page <= last && page < 0x100; page++)
+				setPageType((Byte)page, type);
+		}
+
+		/* Type of the page holding <address> */
+		u8 pageType(Word address) const {
+			return types[address >> 8];
+		}
+
+		/* Send CPU writes to ROM / unmapped pages to <trap> instead of dropping them, nullptr goes back to dropping */
+		void setWriteTrap(Device* trap) {
+			writeTrap = trap;
+			for (int page = 0; page < 0x100; page++)
+				updatePage(page);
+		}
+
 		Byte& operator[](Word address) {
 			return data[address];
 		}
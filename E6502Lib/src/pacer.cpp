@@ -0,0 +1,97 @@
+#include <math.h>
+#ifdef _WIN32
+#include <chrono>
+#include <thread>
+#else
+#include <time.h>
+#include <errno.h>
+#endif
+#include "pacer.h"
+
+namespace E6502 {
+
+	/* Standard deviation of the oversleep */
+	double PacingStats::jitter() const {
+		if (sleeps == 0) return 0;
+		double mean = meanWakeError();
+		double variance = sumSquaresWakeError / sleeps - mean * mean;
+		return variance > 0 ? sqrt(variance) : 0;
+	}
+
+	Pacer::Pacer(CPUInternal* cpu, u64 hz, u64 slice, u64 lateNs) {
+		this->cpu = cpu;
+		clockHz = hz;
+		sliceCycles = slice == 0 ? 1 : slice;
+		maxLateness = lateNs;
+	}
+
+	/* Splits the multiply so long runs don't overflow */
+	u64 Pacer::cyclesToNs(u64 cycles) const {
+		return (cycles / clockHz) * 1000000000ULL + ((cycles % clockHz) * 1000000000ULL) / clockHz;
+	}
+
+	/* Runs in real time */
+	u8 Pacer::run(u64 cycleBudget, bool resume) {
+		u64 startCycles = cpu->getCycles();
+		u64 endCycles = startCycles + cycleBudget;
+		u64 startTime = now();			// Time cycle <startCycles> was due, moved forward by resyncs
+		u64 realStart = startTime;
+		u8 reason = CPUInternal::STOP_BUDGET;
+
+		while (cpu->getCycles() < endCycles) {
+			u64 remaining = endCycles - cpu->getCycles();
+			reason = cpu->run(remaining < sliceCycles ? remaining : sliceCycles, resume);
+			resume = false;
+			stats.slices++;
+
+			// Deadline for the cycles actually run, so overruns and oversleeps are paid back in later slices
+			u64 deadline = startTime + cyclesToNs(cpu->getCycles() - startCycles);
+			u64 time = now();
+			if (time < deadline) {
+				sleepUntil(deadline);
+				u64 wakeError = now() - deadline;
+				stats.sleeps++;
+				stats.totalWakeError += wakeError;
+				stats.sumSquaresWakeError += (double)wakeError * wakeError;
+				if (wakeError > stats.maxWakeError) stats.maxWakeError = wakeError;
+			} else {
+				u64 lateness = time - deadline;
+				stats.lateSlices++;
+				if (lateness > stats.maxLateness) stats.maxLateness = lateness;
+				if (lateness > maxLateness) {
+					startTime += lateness;		// Give up on the lost time rather than racing to catch up
+					stats.resyncs++;
+				}
+			}
+			if (reason != CPUInternal::STOP_BUDGET) break;
+		}
+
+		if (reason == CPUInternal::STOP_BUDGET) cpu->flushDevices();		// run() leaves it to the end of the whole budget
+		stats.emulated += cyclesToNs(cpu->getCycles() - startCycles);
+		stats.elapsed += now() - realStart;
+		return reason;
+	}
+
+#ifdef _WIN32
+	u64 Pacer::now() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	void Pacer::sleepUntil(u64 deadline) {
+		std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(deadline)));
+	}
+#else
+	u64 Pacer::now() {
+		timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	}
+
+	void Pacer::sleepUntil(u64 deadline) {
+		timespec ts;
+		ts.tv_sec = deadline / 1000000000ULL;
+		ts.tv_nsec = deadline % 1000000000ULL;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {}
+	}
+#endif
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "types.h"
+#include "cpu.h"
+
+namespace E6502 {
+
+	/* How closely a Pacer has kept to real time, all times in nanoseconds */
+	struct PacingStats {
+		u64 slices = 0;				// Slices run
+		u64 sleeps = 0;				// Slices that finished early and slept until their deadline
+		u64 lateSlices = 0;			// Slices that finished after their deadline
+		u64 resyncs = 0;			// Times the schedule was moved because it fell too far behind
+
+		u64 maxWakeError = 0;		// Worst oversleep past a deadline
+		u64 totalWakeError = 0;		// Sum of oversleeps, for the mean
+		double sumSquaresWakeError = 0;
+		u64 maxLateness = 0;		// Worst lateness of a slice that didn't need to sleep
+
+		u64 emulated = 0;			// Emulated time (cycles / clock rate)
+		u64 elapsed = 0;			// Host time taken
+
+		/* Mean oversleep past a deadline */
+		double meanWakeError() const { return sleeps == 0 ? 0 : (double)totalWakeError / sleeps; }
+
+		/* Standard deviation of the oversleep */
+		double jitter() const;
+
+		/* Host time minus emulated time - positive when running slow */
+		s64 drift() const { return (s64)elapsed - (s64)emulated; }
+	};
+
+	/**
+	 * Runs a CPU at a real clock rate, for checks against real hardware timing.
+	 *
+	 * The CPU runs flat out for a slice of cycles then sleeps until the absolute time that slice should have
+	 * ended (clock_nanosleep with TIMER_ABSTIME on POSIX). Every deadline is worked out from the start time and
+	 * the cycles actually executed, so oversleeping one slice or overrunning a budget is made up in the following
+	 * slices instead of accumulating. If the host falls more than <maxLateness> behind, the schedule is moved
+	 * rather than running flat out to catch up.
+	 */
+	class Pacer {
+	private:
+		CPUInternal* cpu;
+		u64 clockHz;
+		u64 sliceCycles;
+		u64 maxLateness;
+		PacingStats stats;
+
+		/* Host time of <cycles> cycles at the clock rate */
+		u64 cyclesToNs(u64 cycles) const;
+
+	public:
+		constexpr static u64 CLOCK_1MHZ = 1000000;
+		constexpr static u64 CLOCK_NTSC = 1022727;		// C64 NTSC
+		constexpr static u64 CLOCK_PAL = 985248;		// C64 PAL
+
+		/* Paces <cpu> at <hz>, checking the time every <slice> cycles. Falls back in step once more than <lateNs> behind */
+		Pacer(CPUInternal* cpu, u64 hz = CLOCK_1MHZ, u64 slice = 1000, u64 lateNs = 100000000);
+
+		/* Runs about <cycleBudget> cycles in real time, returns the STOP_ reason from the CPU. <resume> as CPUInternal::run */
+		u8 run(u64 cycleBudget, bool resume = false);
+
+		/* Statistics since construction or resetStats() */
+		const PacingStats& getStats() const { return stats; }
+		void resetStats() { stats = PacingStats(); }
+
+		/* Host monotonic clock in nanoseconds */
+		static u64 now();
+
+		/* Sleeps until the monotonic clock reaches <deadline> */
+		static void sleepUntil(u64 deadline);
+	};
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include "types.h"
+
+namespace E6502 {
+
+	/**
+	 * Hardware style event counters kept by the CPU when built with E6502_PERF_COUNTERS (the CMake option of the
+	 * same name), read with CPUInternal::getCounters(). Without it the CPU keeps no counters and snapshots are
+	 * all zero.
+	 *
+	 * The counters updated on every instruction come first so they share a cache line, the opcode table after.
+	 */
+	struct PerfCounters {
+		u64 instructions = 0;			// Instructions retired (taking an IRQ isn't an instruction)
+		u64 cycles = 0;					// Cycles used by instructions and IRQ entry
+		u64 pageCrosses = 0;			// Extra cycles paid for an indexed address or taken branch crossing a page
+		u64 branchesTaken = 0;
+		u64 branchesNotTaken = 0;		// Worked out when the snapshot is taken
+		u64 interrupts = 0;				// IRQs serviced
+		Byte stackLowWater = 0xFF;		// Lowest stack pointer seen after a push or TXS
+		u64 opcodes[0x100] = {};		// Instructions retired by opcode
+
+		/* Most bytes the stack has held */
+		u8 stackHighWater() const { return 0xFF - stackLowWater; }
+	};
+}
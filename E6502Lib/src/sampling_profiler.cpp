@@ -0,0 +1,106 @@
+#include <algorithm>
+#include "sampling_profiler.h"
+#include "call_profiler.h"
+#include "symbol_table.h"
+
+namespace E6502 {
+
+	SamplingProfiler::SamplingProfiler(CPUInternal* cpu, CPUState* state, Memory* memory, u64 interval, u32 seed)
+		: cpu(cpu), state(state), memory(memory), interval(interval < 2 ? 2 : interval), random(seed == 0 ? 1 : seed) {
+		event.profiler = this;
+	}
+
+	SamplingProfiler::~SamplingProfiler() {
+		stop();
+	}
+
+	/* Starts sampling, keeping any samples already taken */
+	void SamplingProfiler::start() {
+		cpu->getScheduler().schedule(&event, cpu->getCycles() + nextInterval());
+	}
+
+	/* Stops sampling */
+	void SamplingProfiler::stop() {
+		cpu->getScheduler().cancel(&event);
+	}
+
+	/* Uniform from interval/2 to 3*interval/2 */
+	u64 SamplingProfiler::nextInterval() {
+		random ^= random << 13;
+		random ^= random >> 17;
+		random ^= random << 5;
+		return interval / 2 + random % (interval + 1);
+	}
+
+	/* Records where the CPU is at <now> */
+	void SamplingProfiler::sample(u64 now) {
+		cpu->syncState();
+		Sample taken;
+		taken.cycle = now;
+		taken.pc = state->PC;
+		taken.function = calls == nullptr ? -1 : calls->current();
+		taken.opcode = (*memory)[state->PC];
+		samples.push_back(taken);
+		cpu->getScheduler().schedule(&event, now + nextInterval());
+	}
+
+	/* Writes a CSV row for each sample */
+	void SamplingProfiler::writeCSV(FILE* out) const {
+		fputs("cycle,pc,function,opcode\n", out);
+		for (const Sample& taken : samples) {
+			fprintf(out, "%llu,$%04X,", (unsigned long long)taken.cycle, taken.pc);
+			if (taken.function < 0) fputs("root", out);
+			else fprintf(out, "$%04X", taken.function);
+			fprintf(out, ",$%02X\n", taken.opcode);
+		}
+	}
+
+	/* Writes the samples for each subroutine, most first */
+	void SamplingProfiler::writeFunctions(FILE* out, const SymbolTable* symbols) const {
+		std::vector<std::pair<s32, u64>> totals;
+		for (const Sample& taken : samples) {
+			auto found = std::find_if(totals.begin(), totals.end(),
+				[&taken](const std::pair<s32, u64>& total) { return total.first == taken.function; });
+			if (found == totals.end()) totals.push_back(std::make_pair(taken.function, 1ULL));
+			else found->second++;
+		}
+		std::sort(totals.begin(), totals.end(), [](const std::pair<s32, u64>& a, const std::pair<s32, u64>& b) {
+			return a.second != b.second ? a.second > b.second : a.first < b.first;
+		});
+
+		for (const std::pair<s32, u64>& total : totals) {
+			if (total.first < 0) fputs("root", out);
+			else if (symbols != nullptr) fputs(symbols->symbolize((Word)total.first).c_str(), out);
+			else fprintf(out, "$%04X", total.first);
+			fprintf(out, " %llu %.1f%%\n", (unsigned long long)total.second, 100.0 * total.second / samples.size());
+		}
+	}
+
+	/* Writes <listing> with the samples at each line ahead of it, then the samples it doesn't cover */
+	void SamplingProfiler::writeListing(const Listing& listing, FILE* out) const {
+		std::vector<u32> lineCounts(listing.size());
+		std::vector<u32> unlisted(MAX_MEM);
+		for (const Sample& taken : samples) {
+			s32 index = listing.lineAt(taken.pc);
+			if (index < 0) unlisted[taken.pc]++;
+			else lineCounts[index]++;
+		}
+
+		fprintf(out, "; %llu samples, one every %llu cycles on average\n", (unsigned long long)samples.size(),
+			(unsigned long long)interval);
+		for (size_t i = 0; i < listing.size(); i++) {
+			u32 count = lineCounts[i];
+			if (count == 0) fputs("              ", out);
+			else fprintf(out, "%6u %5.1f%% ", count, 100.0 * count / samples.size());
+			fprintf(out, "%s\n", listing.lineText(i).c_str());
+		}
+
+		bool header = false;
+		for (u32 address = 0; address < (u32)MAX_MEM; address++) {
+			if (unlisted[address] == 0) continue;
+			if (!header) fputs("; Not in the listing:\n", out);
+			header = true;
+			fprintf(out, "%6u %5.1f%% $%04X\n", unlisted[address], 100.0 * unlisted[address] / samples.size(), address);
+		}
+	}
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <stdio.h>
+#include <vector>
+#include "types.h"
+#include "memory.h"
+#include "cpu.h"
+#include "listing.h"
+
+namespace E6502 {
+
+	class CallProfiler;
+	class SymbolTable;
+
+	/* Where the CPU was when a sample was taken */
+	struct Sample {
+		u64 cycle;
+		Word pc;				// Next instruction to run
+		s32 function;			// Innermost subroutine from the call profiler, -1 if none
+		Byte opcode;			// Opcode at pc
+	};
+
+	/**
+	 * Statistical profiler for runs too long for CallProfiler or a Tracer. Samples the PC and opcode about to run
+	 * every <interval> cycles on average, plus the innermost subroutine when a CallProfiler is running too.
+	 *
+	 * Samples are taken by a Scheduler event, so the CPU does no extra work between them and an idle loop being
+	 * skipped is still sampled at the right rate. Each interval is drawn uniformly from interval/2 to 3*interval/2
+	 * so sampling can't lock step with a guest loop of the same period. At the default interval a sample costs
+	 * well under 1% of the emulation time.
+	 */
+	class SamplingProfiler {
+	private:
+		/* Takes a sample and schedules the next */
+		class SampleEvent : public Event {
+		public:
+			SamplingProfiler* profiler = nullptr;
+			virtual void fire(u64 now) { profiler->sample(now); }
+		};
+
+		CPUInternal* cpu;
+		CPUState* state;
+		Memory* memory;
+		u64 interval;
+		u32 random;						// xorshift32 state
+		const CallProfiler* calls = nullptr;
+		SampleEvent event;
+		std::vector<Sample> samples;
+
+		/* Records where the CPU is at <now> */
+		void sample(u64 now);
+
+		/* Cycles until the next sample */
+		u64 nextInterval();
+
+	public:
+		constexpr static u64 DEFAULT_INTERVAL = 10000;
+
+		/* Samples <cpu> (publishing to <state>) running from <memory>, <seed> picks the sampling intervals */
+		SamplingProfiler(CPUInternal* cpu, CPUState* state, Memory* memory, u64 interval = DEFAULT_INTERVAL, u32 seed = 1);
+
+		/* Stops sampling if still running */
+		~SamplingProfiler();
+
+		SamplingProfiler(const SamplingProfiler&) = delete;
+		SamplingProfiler& operator=(const SamplingProfiler&) = delete;
+
+		/* Attribute samples to the innermost subroutine of <profiler> (nullptr to stop) */
+		void setCallProfiler(const CallProfiler* profiler) { calls = profiler; }
+
+		/* Starts sampling, keeping any samples already taken */
+		void start();
+
+		/* Stops sampling */
+		void stop();
+
+		/* Discards the samples taken */
+		void clear() { samples.clear(); }
+
+		/* Samples taken, oldest first */
+		const std::vector<Sample>& getSamples() const { return samples; }
+
+		/* Writes "cycle,pc,function,opcode" rows, one a sample */
+		void writeCSV(FILE* out) const;
+
+		/**
+		 * Writes "$xxxx samples percent" for each subroutine sampled, most samples first ("root" for -1). Entry
+		 * points are named from <symbols> when given
+		 */
+		void writeFunctions(FILE* out, const SymbolTable* symbols = nullptr) const;
+
+		/**
+		 * Writes <listing> with the samples taken in each line's bytes ahead of it, after a summary line.
+		 * Samples at addresses the listing doesn't cover are listed at the end
+		 */
+		void writeListing(const Listing& listing, FILE* out) const;
+	};
+}
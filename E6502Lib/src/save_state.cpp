@@ -0,0 +1,153 @@
+#include <string.h>
+#include <stdio.h>
+#include "save_state.h"
+
+namespace E6502 {
+
+	static const Byte MAGIC[4] = { 'E', '6', '5', 'S' };
+
+	static void put16(Byte* out, u16 value) { out[0] = value & 0xFF; out[1] = value >> 8; }
+	static void put32(Byte* out, u32 value) { put16(out, value & 0xFFFF); put16(out + 2, value >> 16); }
+	static void put64(Byte* out, u64 value) { put32(out, value & 0xFFFFFFFF); put32(out + 4, value >> 32); }
+	static u16 get16(const Byte* in) { return in[0] | (in[1] << 8); }
+	static u32 get32(const Byte* in) { return get16(in) | ((u32)get16(in + 2) << 16); }
+	static u64 get64(const Byte* in) { return get32(in) | ((u64)get32(in + 4) << 32); }
+
+	/* True if any byte of the page is non-zero */
+	static bool pageInUse(const Byte* page) {
+		for (int i = 0; i < 0x100; i++)
+			if (page[i] != 0x00) return true;
+		return false;
+	}
+
+	/* Serialises the machine */
+	std::vector<Byte> SaveState::save(const CPUState& state, const Memory& memory, u64 cycles) {
+		const Byte* data = &memory[0x0000];
+
+		// Work out which pages to store first so the buffer is allocated once
+		Byte bitmap[BITMAP_SIZE] = {};
+		size_t pages = 0;
+		for (int page = 0; page < 0x100; page++) {
+			if (pageInUse(data + (page << 8))) {
+				bitmap[page >> 3] |= (1 << (page & 7));
+				pages++;
+			}
+		}
+
+		std::vector<Byte> buffer(HEADER_SIZE + REGISTER_SIZE + BITMAP_SIZE + pages * 0x100);
+		Byte* out = buffer.data();
+
+		// Registers
+		Byte* regs = out + HEADER_SIZE;
+		put16(regs, state.PC);
+		regs[2] = state.SP;
+		regs[3] = state.A;
+		regs[4] = state.X;
+		regs[5] = state.Y;
+		regs[6] = state.FLAGS.byte;
+		put64(regs + 8, cycles);
+
+		// Memory
+		Byte* mem = regs + REGISTER_SIZE;
+		memcpy(mem, bitmap, BITMAP_SIZE);
+		mem += BITMAP_SIZE;
+		for (int page = 0; page < 0x100; page++) {
+			if (bitmap[page >> 3] & (1 << (page & 7))) {
+				memcpy(mem, data + (page << 8), 0x100);
+				mem += 0x100;
+			}
+		}
+
+		// Header
+		size_t bodySize = buffer.size() - HEADER_SIZE;
+		memcpy(out, MAGIC, sizeof(MAGIC));
+		put16(out + 4, VERSION);
+		put16(out + 6, HEADER_SIZE);
+		put32(out + 8, (u32)bodySize);
+		put32(out + 12, checksum(out + HEADER_SIZE, bodySize));
+		return buffer;
+	}
+
+	/* Restores a machine, validating everything before touching it */
+	bool SaveState::load(const Byte* buffer, size_t size, CPUState& state, Memory& memory, u64& cycles) {
+		if (size < HEADER_SIZE || memcmp(buffer, MAGIC, sizeof(MAGIC)) != 0) return false;
+		if (get16(buffer + 4) != VERSION) return false;
+		u16 headerSize = get16(buffer + 6);
+		u32 bodySize = get32(buffer + 8);
+		if (headerSize < HEADER_SIZE || size < (size_t)headerSize + bodySize) return false;
+		if (bodySize < REGISTER_SIZE + BITMAP_SIZE) return false;
+
+		const Byte* body = buffer + headerSize;
+		if (checksum(body, bodySize) != get32(buffer + 12)) return false;
+
+		const Byte* bitmap = body + REGISTER_SIZE;
+		size_t pages = 0;
+		for (int i = 0; i < BITMAP_SIZE; i++)
+			for (Byte bits = bitmap[i]; bits != 0; bits &= bits - 1) pages++;
+		if (bodySize != REGISTER_SIZE + BITMAP_SIZE + pages * 0x100) return false;
+
+		// Registers
+		state.PC = get16(body);
+		state.SP = body[2];
+		state.A = body[3];
+		state.X = body[4];
+		state.Y = body[5];
+		state.FLAGS.byte = body[6];
+		cycles = get64(body + 8);
+
+		// Memory - stored pages are copied, the rest are cleared
+		Byte* data = &memory[0x0000];
+		const Byte* in = bitmap + BITMAP_SIZE;
+		for (int page = 0; page < 0x100; page++) {
+			if (bitmap[page >> 3] & (1 << (page & 7))) {
+				memcpy(data + (page << 8), in, 0x100);
+				in += 0x100;
+			} else {
+				memset(data + (page << 8), 0x00, 0x100);
+			}
+		}
+		return true;
+	}
+
+	/* Saves to a file with a single write */
+	bool SaveState::saveFile(const char* path, const CPUState& state, const Memory& memory, u64 cycles) {
+		std::vector<Byte> buffer = save(state, memory, cycles);
+		FILE* fp = NULL;
+		if (fopen_s(&fp, path, "wb")) return false;
+		bool ok = fwrite(buffer.data(), 1, buffer.size(), fp) == buffer.size();
+		return (fclose(fp) == 0) && ok;
+	}
+
+	/* Loads from a file with a single read */
+	bool SaveState::loadFile(const char* path, CPUState& state, Memory& memory, u64& cycles) {
+		FILE* fp = NULL;
+		if (fopen_s(&fp, path, "rb")) return false;
+		fseek(fp, 0, SEEK_END);
+		long size = ftell(fp);
+		fseek(fp, 0, SEEK_SET);
+		if (size <= 0) {
+			fclose(fp);
+			return false;
+		}
+		std::vector<Byte> buffer(size);
+		bool ok = fread(buffer.data(), 1, size, fp) == (size_t)size;
+		fclose(fp);
+		return ok && load(buffer.data(), buffer.size(), state, memory, cycles);
+	}
+
+	/* Adler-32 */
+	u32 SaveState::checksum(const Byte* data, size_t size) {
+		u32 a = 1, b = 0;
+		while (size > 0) {
+			size_t block = size < 5552 ? size : 5552;		// Largest run before the sums can overflow
+			size -= block;
+			while (block-- > 0) {
+				a += *data++;
+				b += a;
+			}
+			a %= 65521;
+			b %= 65521;
+		}
+		return (b << 16) | a;
+	}
+}
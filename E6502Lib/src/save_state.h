@@ -0,0 +1,46 @@
+#pragma once
+#include <vector>
+#include "types.h"
+#include "memory.h"
+
+namespace E6502 {
+
+	/**
+	 * Versioned binary snapshot of a CPUState, the cycle counter and Memory.
+	 *
+	 * Layout (little endian):
+	 *   Header    16 bytes  "E65S", version, header size, size of everything after the header, checksum of it
+	 *   Registers 16 bytes  PC, SP, A, X, Y, FLAGS, (pad), cycles
+	 *   Memory    32 byte bitmap of pages holding any non-zero byte, followed by those pages (256 bytes each)
+	 *
+	 * After Memory::reset most pages are zero so a typical image is a few KB. Zero pages cost one bit and
+	 * stored pages are straight copies, so saving or restoring is a handful of memcpys.
+	 *
+	 * Devices, the scheduler, breakpoints and IRQ lines are not part of the state.
+	 */
+	class SaveState {
+	private:
+		SaveState();		// Only used statically
+
+	public:
+		constexpr static u16 VERSION = 1;
+		constexpr static u16 HEADER_SIZE = 16;
+		constexpr static u16 REGISTER_SIZE = 16;
+		constexpr static u16 BITMAP_SIZE = 32;
+
+		/* Serialises the machine into a new buffer */
+		static std::vector<Byte> save(const CPUState& state, const Memory& memory, u64 cycles);
+
+		/* Restores a machine from <buffer>. Returns false (and changes nothing) if the buffer isn't a valid save state */
+		static bool load(const Byte* buffer, size_t size, CPUState& state, Memory& memory, u64& cycles);
+
+		/* save() to a file with a single write, returns false on an IO error */
+		static bool saveFile(const char* path, const CPUState& state, const Memory& memory, u64 cycles);
+
+		/* load() from a file with a single read, returns false on an IO error or an invalid file */
+		static bool loadFile(const char* path, CPUState& state, Memory& memory, u64& cycles);
+
+		/* Checksum used for the body (Adler-32) */
+		static u32 checksum(const Byte* data, size_t size);
+	};
+}
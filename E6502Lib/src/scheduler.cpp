@@ -0,0 +1,78 @@
+#include "scheduler.h"
+
+namespace E6502 {
+
+	/* Schedule an event, moving it if already scheduled */
+	void Scheduler::schedule(Event* event, u64 cycle) {
+		if (event->isScheduled()) {
+			size_t index = event->heapIndex;
+			bool earlier = cycle < event->deadline;
+			event->deadline = cycle;
+			if (earlier) siftUp(index);
+			else siftDown(index);
+		} else {
+			event->deadline = cycle;
+			heap.push_back(event);
+			place(event, heap.size() - 1);
+			siftUp(heap.size() - 1);
+		}
+		updateNext();
+	}
+
+	/* Remove an event from the schedule */
+	void Scheduler::cancel(Event* event) {
+		if (!event->isScheduled()) return;
+		removeAt(event->heapIndex);
+		updateNext();
+	}
+
+	/* Fire every event due at or before now */
+	void Scheduler::runDue(u64 now) {
+		while (!heap.empty() && heap[0]->deadline <= now) {
+			Event* event = heap[0];
+			removeAt(0);
+			updateNext();
+			event->fire(now);		// May reschedule itself or others
+		}
+	}
+
+	/* Takes the event at <index> out of the heap */
+	void Scheduler::removeAt(size_t index) {
+		Event* removed = heap[index];
+		Event* last = heap.back();
+		heap.pop_back();
+		removed->heapIndex = -1;
+		if (index < heap.size()) {
+			place(last, index);
+			siftUp(index);
+			siftDown(last->heapIndex);
+		}
+	}
+
+	/* Moves the event at <index> towards the root until its parent is due no later */
+	void Scheduler::siftUp(size_t index) {
+		Event* event = heap[index];
+		while (index > 0) {
+			size_t parent = (index - 1) / 2;
+			if (heap[parent]->deadline <= event->deadline) break;
+			place(heap[parent], index);
+			index = parent;
+		}
+		place(event, index);
+	}
+
+	/* Moves the event at <index> towards the leaves until both children are due no earlier */
+	void Scheduler::siftDown(size_t index) {
+		Event* event = heap[index];
+		size_t count = heap.size();
+		while (true) {
+			size_t child = index * 2 + 1;
+			if (child >= count) break;
+			if (child + 1 < count && heap[child + 1]->deadline < heap[child]->deadline) child++;
+			if (event->deadline <= heap[child]->deadline) break;
+			place(heap[child], index);
+			index = child;
+		}
+		place(event, index);
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "types.h"
+
+namespace E6502 {
+
+	/**
+	 * Something that happens at a given CPU cycle (a timer underflow, a character arriving, ...).
+	 * Devices own their events and hand them to the Scheduler, fire() is called once the CPU reaches the deadline.
+	 */
+	class Event {
+	private:
+		friend class Scheduler;
+		u64 deadline = 0;
+		int heapIndex = -1;		// Position in the scheduler heap, -1 when not scheduled
+
+	public:
+		virtual ~Event() {}
+
+		/* Called at the first instruction boundary at or after the deadline, <now> is the current cycle */
+		virtual void fire(u64 now) = 0;
+
+		/* True while the event is waiting in a scheduler */
+		bool isScheduled() const { return heapIndex >= 0; }
+
+		/* The cycle the event was (last) scheduled for */
+		u64 getDeadline() const { return deadline; }
+	};
+
+	/**
+	 * Keeps pending events in a binary min-heap ordered by deadline. Each event remembers its heap position so
+	 * scheduling, rescheduling and cancelling are all O(log n), and the next deadline is cached so the CPU can
+	 * check it with a single compare per instruction.
+	 *
+	 * The scheduler does not own events, an event must be cancelled before it is destroyed.
+	 */
+	class Scheduler {
+	private:
+		std::vector<Event*> heap;
+		u64 next = NEVER;
+
+		void place(Event* event, size_t index) { heap[index] = event; event->heapIndex = (int)index; }
+		void siftUp(size_t index);
+		void siftDown(size_t index);
+		void removeAt(size_t index);
+		void updateNext() { if (heap.empty()) next = NEVER; else next = heap[0]->deadline; }
+
+	public:
+		/* nextDeadline() when nothing is scheduled */
+		constexpr static u64 NEVER = ~0ULL;
+
+		/* Schedule <event> to fire at <cycle>, an event that is already scheduled is moved to the new cycle */
+		void schedule(Event* event, u64 cycle);
+
+		/* Remove <event> from the schedule, does nothing if it isn't scheduled */
+		void cancel(Event* event);
+
+		/* Fire, in deadline order, every event due at or before <now>. Events may schedule more events while firing */
+		void runDue(u64 now);
+
+		/* Deadline of the earliest pending event or NEVER */
+		u64 nextDeadline() const { return next; }
+
+		/* Number of pending events */
+		size_t size() const { return heap.size(); }
+	};
+}
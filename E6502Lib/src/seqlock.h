@@ -0,0 +1,61 @@
+#pragma once
+#include <atomic>
+#include <string.h>
+#include <type_traits>
+#include "types.h"
+
+namespace E6502 {
+
+	/**
+	 * Publishes a small trivially copyable value from one writer thread to any number of readers.
+	 *
+	 * The writer never waits: it makes the sequence odd, copies the value in and makes the sequence even again.
+	 * Readers copy the value out and retry if the sequence was odd or changed while they were copying, so they
+	 * can sample as often as they like without slowing the writer down. The value is held in atomic words so
+	 * a torn read is detected rather than being undefined behaviour.
+	 */
+	template <typename T>
+	class Seqlock {
+		static_assert(std::is_trivially_copyable<T>::value, "Seqlock values must be trivially copyable");
+
+	private:
+		constexpr static size_t WORDS = (sizeof(T) + sizeof(u64) - 1) / sizeof(u64);
+
+		std::atomic<u32> sequence{ 0 };
+		std::atomic<u64> words[WORDS];
+
+	public:
+		Seqlock() {
+			for (size_t i = 0; i < WORDS; i++) words[i].store(0, std::memory_order_relaxed);
+		}
+
+		/* Writer only - publishes <value> */
+		void store(const T& value) {
+			u64 buffer[WORDS] = {};
+			memcpy(buffer, &value, sizeof(T));
+			u32 seq = sequence.load(std::memory_order_relaxed);
+			sequence.store(seq + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			for (size_t i = 0; i < WORDS; i++) words[i].store(buffer[i], std::memory_order_relaxed);
+			sequence.store(seq + 2, std::memory_order_release);
+		}
+
+		/* Any thread - the most recently published value */
+		T load() const {
+			u64 buffer[WORDS];
+			u32 before, after;
+			do {
+				before = sequence.load(std::memory_order_acquire);
+				for (size_t i = 0; i < WORDS; i++) buffer[i] = words[i].load(std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_acquire);
+				after = sequence.load(std::memory_order_relaxed);
+			} while ((before & 1) != 0 || before != after);
+			T value;
+			memcpy(&value, buffer, sizeof(T));
+			return value;
+		}
+
+		/* Number of values published so far */
+		u32 version() const { return sequence.load(std::memory_order_acquire) / 2; }
+	};
+}
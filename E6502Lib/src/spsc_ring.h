@@ -0,0 +1,89 @@
+#pragma once
+#include <atomic>
+#include <vector>
+#include "types.h"
+
+namespace E6502 {
+
+	/**
+	 * Bounded single-producer / single-consumer queue that needs no locks.
+	 *
+	 * One thread may push and one (other) thread may pop at the same time. The producer only writes <head> and
+	 * the consumer only writes <tail>, each side keeps a cached copy of the other's index so it only touches the
+	 * shared cache line when the queue looks full (or empty). Capacity is rounded up to a power of two.
+	 */
+	template <typename T>
+	class SpscRing {
+	private:
+		constexpr static size_t CACHE_LINE = 64;
+
+		std::vector<T> slots;
+		size_t mask;
+
+		// Each side's fields get their own cache line (padding rather than alignas so heap allocation is safe pre C++17)
+		char padStart[CACHE_LINE];
+		std::atomic<size_t> head{ 0 };	// Next slot to write (producer)
+		size_t cachedTail = 0;			// Producer's view of tail
+		char padProducer[CACHE_LINE];
+		std::atomic<size_t> tail{ 0 };	// Next slot to read (consumer)
+		size_t cachedHead = 0;			// Consumer's view of head
+		char padConsumer[CACHE_LINE];
+
+		static size_t roundUp(size_t value) {
+			size_t result = 1;
+			while (result < value) result <<= 1;
+			return result;
+		}
+
+	public:
+		/* Holds at least <minCapacity> items */
+		explicit SpscRing(size_t minCapacity) : slots(roundUp(minCapacity < 1 ? 1 : minCapacity)) {
+			mask = slots.size() - 1;
+		}
+
+		SpscRing(const SpscRing&) = delete;
+		SpscRing& operator=(const SpscRing&) = delete;
+
+		/* Producer - adds <item>, returns false if the queue is full */
+		bool push(const T& item) {
+			size_t h = head.load(std::memory_order_relaxed);
+			if (h - cachedTail == slots.size()) {
+				cachedTail = tail.load(std::memory_order_acquire);
+				if (h - cachedTail == slots.size()) return false;
+			}
+			slots[h & mask] = item;
+			head.store(h + 1, std::memory_order_release);
+			return true;
+		}
+
+		/* Consumer - removes the oldest item into <item>, returns false if the queue is empty */
+		bool pop(T& item) {
+			size_t t = tail.load(std::memory_order_relaxed);
+			if (t == cachedHead) {
+				cachedHead = head.load(std::memory_order_acquire);
+				if (t == cachedHead) return false;
+			}
+			item = slots[t & mask];
+			tail.store(t + 1, std::memory_order_release);
+			return true;
+		}
+
+		/* Consumer - the oldest item without removing it, or nullptr if empty */
+		const T* peek() {
+			size_t t = tail.load(std::memory_order_relaxed);
+			if (t == cachedHead) {
+				cachedHead = head.load(std::memory_order_acquire);
+				if (t == cachedHead) return nullptr;
+			}
+			return &slots[t & mask];
+		}
+
+		/* Number of queued items - exact from either end's own thread, a snapshot from anywhere else */
+		size_t size() const { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire); }
+
+		bool empty() const { return size() == 0; }
+		bool full() const { return size() >= slots.size(); }
+
+		size_t capacity() const { return slots.size(); }
+	};
+}
@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <stdio.h>
+#include "symbol_table.h"
+
+namespace E6502 {
+
+	static bool byAddress(const Symbol& a, const Symbol& b) {
+		return a.address < b.address;
+	}
+
+	/* Adds the labels and equates in the listing at <path> */
+	bool SymbolTable::load(const char* path) {
+		Listing listing;
+		if (!listing.load(path)) return false;
+		add(listing);
+		return true;
+	}
+
+	/* Labels without an address take the next line's, then everything is sorted once */
+	void SymbolTable::add(const Listing& listing) {
+		size_t added = labels.size();
+		std::vector<size_t> pending;
+		for (size_t i = 0; i < listing.size(); i++) {
+			const ListingLine& line = listing.line(i);
+			if (line.label != 0) {
+				if (line.address < 0) {
+					pending.push_back(i);
+				}
+				else {
+					std::string name = listing.labelText(i);
+					if (values.emplace(name, (Word)line.address).second && !line.equate)
+						labels.push_back(Symbol{ name, (Word)line.address });
+				}
+			}
+			if (line.address < 0 || line.equate || pending.empty()) continue;
+			for (size_t label : pending) {
+				std::string name = listing.labelText(label);
+				if (values.emplace(name, (Word)line.address).second)
+					labels.push_back(Symbol{ name, (Word)line.address });
+			}
+			pending.clear();
+		}
+
+		// Earlier labels keep their place ahead of new ones at the same address
+		std::stable_sort(labels.begin() + added, labels.end(), byAddress);
+		std::inplace_merge(labels.begin(), labels.begin() + added, labels.end(), byAddress);
+	}
+
+	/* Adds a label (or an equate, which only gets a name) */
+	void SymbolTable::add(const std::string& name, Word address, bool equate) {
+		if (!values.emplace(name, address).second || equate) return;
+		Symbol symbol{ name, address };
+		labels.insert(std::upper_bound(labels.begin(), labels.end(), symbol, byAddress), symbol);
+	}
+
+	/* Forgets every symbol */
+	void SymbolTable::clear() {
+		labels.clear();
+		values.clear();
+	}
+
+	s32 SymbolTable::labelIndex(Word address) const {
+		auto after = std::upper_bound(labels.begin(), labels.end(), address,
+			[](Word value, const Symbol& symbol) { return value < symbol.address; });
+		if (after == labels.begin()) return -1;
+		auto first = std::lower_bound(labels.begin(), after, (after - 1)->address,
+			[](const Symbol& symbol, Word value) { return symbol.address < value; });
+		return (s32)(first - labels.begin());
+	}
+
+	/* The first label at the highest address <= <address> */
+	const Symbol* SymbolTable::lookup(Word address) const {
+		s32 index = labelIndex(address);
+		return index < 0 ? nullptr : &labels[index];
+	}
+
+	/* Value of the label or equate <name> */
+	s32 SymbolTable::value(const std::string& name) const {
+		auto found = values.find(name);
+		return found == values.end() ? -1 : found->second;
+	}
+
+	/* <address> as "label", "label+offset" or "$xxxx" */
+	std::string SymbolTable::symbolize(Word address, u32 maxOffset) const {
+		char text[16];
+		const Symbol* symbol = lookup(address);
+		if (symbol == nullptr || (u32)(address - symbol->address) > maxOffset) {
+			snprintf(text, sizeof(text), "$%04X", address);
+			return text;
+		}
+		if (address == symbol->address) return symbol->name;
+		snprintf(text, sizeof(text), "+$%X", address - symbol->address);
+		return symbol->name + text;
+	}
+}
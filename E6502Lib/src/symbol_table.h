@@ -0,0 +1,66 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "types.h"
+#include "listing.h"
+
+namespace E6502 {
+
+	/* A label and the address it marks */
+	struct Symbol {
+		std::string name;
+		Word address;
+	};
+
+	/**
+	 * Labels and equates read from assembler listings, for showing addresses by name. Labels are kept sorted by
+	 * address so the label at or below an address is a binary search. Equates (AS65 "=" and "equ") are only
+	 * looked up by name, as most of them are constants rather than addresses.
+	 *
+	 * Where several labels mark the same address the first one defined is used. A name defined twice keeps its
+	 * first value.
+	 */
+	class SymbolTable {
+	private:
+		std::vector<Symbol> labels;
+		std::unordered_map<std::string, Word> values;		// Labels and equates by name
+
+		/* Index of the first label at the highest address <= <address>, -1 if none */
+		s32 labelIndex(Word address) const;
+
+	public:
+		/* Furthest past a label symbolize() will name an address */
+		constexpr static u32 DEFAULT_MAX_OFFSET = 0x100;
+
+		/* Adds the labels and equates in the listing at <path>, false if it can't be read */
+		bool load(const char* path);
+
+		/* Adds the labels and equates in <listing> */
+		void add(const Listing& listing);
+
+		/* Adds a label (or an equate, which only gets a name) */
+		void add(const std::string& name, Word address, bool equate = false);
+
+		/* Forgets every symbol */
+		void clear();
+
+		/* Number of labels */
+		size_t size() const { return labels.size(); }
+
+		/* Labels in address order */
+		const std::vector<Symbol>& getLabels() const { return labels; }
+
+		/* The first label at the highest address <= <address>, nullptr if there is none */
+		const Symbol* lookup(Word address) const;
+
+		/* Value of the label or equate <name>, -1 if there is none */
+		s32 value(const std::string& name) const;
+
+		/**
+		 * <address> as "label" or "label+offset" (offset in hex) using the nearest label at or below it, or "$xxxx"
+		 * if there isn't one within <maxOffset>
+		 */
+		std::string symbolize(Word address, u32 maxOffset = DEFAULT_MAX_OFFSET) const;
+	};
+}
@@ -5,7 +5,7 @@
 
 // Represents a computer system (e.g. C64), currently minimal needed to test instructions
 namespace E6502 {
-	System::System(char* executableFile) {
+	System::System(char* executableFile, bool protectVectors) {
 		memory = new Memory;
 		state = new CPUState;
 		loader = &InstructionUtils::loader;
@@ -63,6 +63,10 @@ namespace E6502 {
 		(*memory)[CPUState::DEFAULT_RESET_VECTOR + 1] = program->loadAddress & 0xFF;
 		(*memory)[CPUState::DEFAULT_RESET_VECTOR + 2] = program->loadAddress >> 8;
 		(*memory)[CPUState::DEFAULT_RESET_VECTOR + 3] = INS_NOP_IMP.opcode;
+
+		// Stop stray guest writes corrupting the vectors, protection is by page so this drops writes to all of $FF00-$FFFF
+		if (protectVectors)
+			memory->setPageType(CPUState::DEFAULT_RESET_VECTOR >> 8, Memory::PAGE_ROM);
 	}
 
 	System:: ~System() {
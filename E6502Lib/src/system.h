@@ -12,7 +12,8 @@ namespace E6502 {
 		Program* program;
 
 		//Read & Load a program into Memory, Update reset Vector, reset CPU
-		System(char* executableFile);
+		//<protectVectors> makes the whole vector page ($FF00-$FFFF) ROM, so only use it when the program doesn't write there
+		System(char* executableFile, bool protectVectors = false);
 		~System();
 	};
 }
\ No newline at end of file
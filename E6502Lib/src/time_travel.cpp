@@ -0,0 +1,150 @@
+#include <string.h>
+#include "time_travel.h"
+
+namespace E6502 {
+
+	TimeTravel::TimeTravel(CPUInternal* cpu, CPUState* state, Memory* memory, u64 interval, size_t maxCheckpoints, size_t maxBytes)
+		: cpu(cpu), state(state), memory(memory), interval(interval), maxCheckpoints(maxCheckpoints), maxBytes(maxBytes) {}
+
+	/* Records the pages changed since the newest checkpoint as its undo record, then adds a new one */
+	void TimeTravel::checkpoint() {
+		const Byte* data = &(*memory)[0x0000];
+		if (ring.empty()) {
+			shadow.assign(data, data + MAX_MEM);
+		}
+		else {
+			Checkpoint& newest = ring.back();
+			for (int page = 0; page < 0x100; page++) {
+				const Byte* current = data + (page << 8);
+				Byte* saved = shadow.data() + (page << 8);
+				if (memcmp(current, saved, 0x100) == 0) continue;
+				newest.pages.push_back(page);
+				newest.undo.insert(newest.undo.end(), saved, saved + 0x100);
+				memcpy(saved, current, 0x100);
+				undoBytes += 0x101;
+			}
+		}
+
+		Checkpoint next;
+		next.state = *state;
+		next.cycles = cpu->getCycles();
+		ring.push_back(next);
+
+		// The oldest checkpoint is only needed to go back before the second oldest
+		while (ring.size() > 1 && (ring.size() > maxCheckpoints || bytesUsed() > maxBytes)) {
+			undoBytes -= ring.front().pages.size() * 0x101;
+			ring.pop_front();
+		}
+	}
+
+	/* Undoes memory back to the newest checkpoint, then through the undo records to ring[index] */
+	void TimeTravel::restore(size_t index) {
+		Byte* data = &(*memory)[0x0000];
+		for (int page = 0; page < 0x100; page++)
+			if (memcmp(data + (page << 8), shadow.data() + (page << 8), 0x100) != 0)
+				memcpy(data + (page << 8), shadow.data() + (page << 8), 0x100);
+
+		while (ring.size() > index + 1) {
+			ring.pop_back();
+			Checkpoint& previous = ring.back();
+			for (size_t i = 0; i < previous.pages.size(); i++)
+				memcpy(data + (previous.pages[i] << 8), previous.undo.data() + i * 0x100, 0x100);
+			undoBytes -= previous.pages.size() * 0x101;
+			previous.pages.clear();
+			previous.undo.clear();
+		}
+		shadow.assign(data, data + MAX_MEM);
+
+		*state = ring.back().state;
+		cpu->setCycles(ring.back().cycles);
+	}
+
+	int TimeTravel::checkpointBefore(u64 cycle) const {
+		for (int i = (int)ring.size() - 1; i >= 0; i--)
+			if (ring[i].cycles < cycle) return i;
+		return -1;
+	}
+
+	void TimeTravel::runTo(u64 cycle) {
+		while (cpu->getCycles() < cycle) {
+			u64 before = cpu->getCycles();
+			run(cycle - before, true);
+			if (cpu->getCycles() == before) break;
+		}
+	}
+
+	/* Runs in chunks that end on checkpoint boundaries */
+	u8 TimeTravel::run(u64 cycleBudget, bool resume) {
+		if (ring.empty()) checkpoint();
+		u64 end = cpu->getCycles() + cycleBudget;
+		while (true) {
+			u64 next = ring.back().cycles + interval;
+			u64 until = next < end ? next : end;
+			u64 now = cpu->getCycles();
+			u8 reason = CPUInternal::STOP_BUDGET;
+			if (now < until) {
+				reason = cpu->run(until - now, resume);
+				resume = false;
+			}
+			if (cpu->getCycles() >= next) checkpoint();
+			if (reason != CPUInternal::STOP_BUDGET || cpu->getCycles() >= end) return reason;
+		}
+	}
+
+	/* Counts the instructions from the checkpoint to now, then runs one fewer */
+	bool TimeTravel::stepBack() {
+		u64 now = cpu->getCycles();
+		int index = checkpointBefore(now);
+		if (index < 0) return false;
+
+		restore(index);
+		u64 count = 0;
+		while (cpu->getCycles() < now) {
+			cpu->execute(1);
+			count++;
+		}
+		restore(index);
+		for (; count > 1; count--)
+			cpu->execute(1);
+		return true;
+	}
+
+	/* Searches back a checkpoint interval at a time, remembering the last breakpoint reached in each */
+	bool TimeTravel::runBackToBreakpoint() {
+		u64 now = cpu->getCycles();
+		u64 end = now;
+		for (int index = checkpointBefore(now); index >= 0; index--) {
+			restore(index);
+			u64 start = cpu->getCycles();
+			bool found = cpu->isBreakpoint(state->PC);
+			u64 hit = start;
+			while (cpu->getCycles() < end) {
+				u8 reason = cpu->run(end - cpu->getCycles(), true);		// The start and each breakpoint found are stepped over
+				if (reason == CPUInternal::STOP_BREAKPOINT && cpu->getCycles() < end) {
+					found = true;
+					hit = cpu->getCycles();
+				}
+				else if (reason != CPUInternal::STOP_BUDGET) break;
+			}
+			if (found) {
+				restore(index);
+				runTo(hit);
+				return true;
+			}
+			end = start;
+		}
+
+		// Nothing found, go back to where we were
+		if (!ring.empty()) {
+			restore(0);
+			runTo(now);
+		}
+		return false;
+	}
+
+	void TimeTravel::clear() {
+		ring.clear();
+		shadow.clear();
+		undoBytes = 0;
+	}
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <deque>
+#include <vector>
+#include "types.h"
+#include "memory.h"
+#include "cpu.h"
+
+namespace E6502 {
+
+	/**
+	 * Reverse execution for debugging. run() takes a checkpoint every <interval> cycles into a bounded ring, going
+	 * back restores the nearest checkpoint before the target and runs forward to it.
+	 *
+	 * A checkpoint holds the registers and cycle counter plus an undo record of the memory pages that changed
+	 * before the next checkpoint (their contents at the checkpoint). Changed pages are found by comparing memory
+	 * with a shadow copy of the newest checkpoint, so running costs nothing between checkpoints and a checkpoint
+	 * costs one 64KB compare plus a copy of each dirty page. Restoring walks the undo records back from the newest
+	 * checkpoint. The oldest checkpoints are dropped once there are more than <maxCheckpoints> or the undo records
+	 * and shadow use more than <maxBytes>.
+	 *
+	 * Going back relies on re-running being deterministic. Devices, scheduled events and IRQ lines are not part of
+	 * a checkpoint, so programs using devices should be replayed from an InputLog.
+	 */
+	class TimeTravel {
+	private:
+		struct Checkpoint {
+			CPUState state;
+			u64 cycles;
+			std::vector<Byte> pages;	// Pages changed before the next checkpoint
+			std::vector<Byte> undo;		// Their contents at this checkpoint, 256 bytes each
+		};
+
+		CPUInternal* cpu;
+		CPUState* state;
+		Memory* memory;
+		u64 interval;
+		size_t maxCheckpoints;
+		size_t maxBytes;
+		std::deque<Checkpoint> ring;
+		std::vector<Byte> shadow;		// Memory at the newest checkpoint
+		size_t undoBytes = 0;
+
+		/* Puts the machine back to ring[index] and drops every later checkpoint */
+		void restore(size_t index);
+
+		/* Index of the newest checkpoint before <cycle>, or -1 */
+		int checkpointBefore(u64 cycle) const;
+
+		/* Runs forward to exactly <cycle> (an instruction boundary), ignoring breakpoints */
+		void runTo(u64 cycle);
+
+	public:
+		constexpr static u64 DEFAULT_INTERVAL = 100000;
+
+		/* Travels <cpu> (publishing to <state>) and <memory> */
+		TimeTravel(CPUInternal* cpu, CPUState* state, Memory* memory, u64 interval = DEFAULT_INTERVAL,
+			size_t maxCheckpoints = 256, size_t maxBytes = 16 * 1024 * 1024);
+
+		/* Takes a checkpoint now (run() does this every interval) */
+		void checkpoint();
+
+		/* CPUInternal::run, taking checkpoints along the way. Returns the STOP_ reason */
+		u8 run(u64 cycleBudget, bool resume = false);
+
+		/* Goes back one instruction. Returns false (and changes nothing) if there's no checkpoint before it */
+		bool stepBack();
+
+		/**
+		 * Goes back to the last time an enabled breakpoint was reached, before the current cycle. Returns false if
+		 * none was reached since the oldest checkpoint - the machine is left where it was.
+		 */
+		bool runBackToBreakpoint();
+
+		/* Drops every checkpoint, e.g. after the machine has been changed from outside */
+		void clear();
+
+		/* Checkpoints held */
+		size_t size() const { return ring.size(); }
+
+		/* Memory held by the shadow copy and undo records */
+		size_t bytesUsed() const { return shadow.size() + undoBytes; }
+
+		/* Earliest cycle that can be travelled back to */
+		u64 oldestCycle() const { return ring.empty() ? cpu->getCycles() : ring.front().cycles; }
+	};
+}
@@ -0,0 +1,425 @@
+#include <string.h>
+#include <algorithm>
+#include "trace.h"
+
+namespace E6502 {
+
+	static const Byte MAGIC[4] = { 'E', '6', '5', 'T' };
+	static const Byte CHUNK_MAGIC[4] = { 'E', '6', '5', 'C' };
+	static const Byte FOOTER_MAGIC[4] = { 'E', '6', '5', 'X' };
+
+	static void put16(Byte* out, u16 value) { out[0] = value & 0xFF; out[1] = value >> 8; }
+	static void put32(Byte* out, u32 value) { put16(out, value & 0xFFFF); put16(out + 2, value >> 16); }
+	static void put64(Byte* out, u64 value) { put32(out, value & 0xFFFFFFFF); put32(out + 4, value >> 32); }
+	static u16 get16(const Byte* in) { return in[0] | (in[1] << 8); }
+	static u32 get32(const Byte* in) { return get16(in) | ((u32)get16(in + 2) << 16); }
+	static u64 get64(const Byte* in) { return get32(in) | ((u64)get32(in + 4) << 32); }
+
+	/* Record flags - the low two bits are the PC step (0 if the PC follows), the next three the cycle delta (7 if it follows) */
+	static const Byte DELTA_A = 0x20;
+	static const Byte DELTA_FLAGS = 0x40;
+	static const Byte DELTA_EXTENDED = 0x80;	// An extension byte follows with the rarer registers
+	static const Byte DELTA_X = 0x01;
+	static const Byte DELTA_Y = 0x02;
+	static const Byte DELTA_SP = 0x04;
+
+	/* LZ77 parameters - sequences are a token (literal count, match length - 4), literals, a 2 byte offset */
+	static const size_t MIN_MATCH = 4;
+	static const int HASH_BITS = 14;
+	static const u32 NO_POSITION = 0xFFFFFFFF;
+
+	void TraceFormat::encode(const TraceRecord& previous, const TraceRecord& next, std::vector<Byte>& out) {
+		Byte flags = 0;
+		Byte extended = 0;
+		Word pcStep = next.state.PC - previous.state.PC;
+		bool pcFollows = pcStep < 1 || pcStep > 3;
+		if (!pcFollows) flags |= pcStep;
+		u64 delta = next.cycle - previous.cycle;
+		flags |= (delta < 7 ? delta : 7) << 2;
+		if (next.state.A != previous.state.A) flags |= DELTA_A;
+		if (next.state.FLAGS.byte != previous.state.FLAGS.byte) flags |= DELTA_FLAGS;
+		if (next.state.X != previous.state.X) extended |= DELTA_X;
+		if (next.state.Y != previous.state.Y) extended |= DELTA_Y;
+		if (next.state.SP != previous.state.SP) extended |= DELTA_SP;
+		if (extended != 0) flags |= DELTA_EXTENDED;
+
+		out.push_back(flags);
+		if (extended != 0) out.push_back(extended);
+		if (pcFollows) {
+			out.push_back(next.state.PC & 0xFF);
+			out.push_back(next.state.PC >> 8);
+		}
+		if (delta >= 7) {
+			do {
+				Byte part = delta & 0x7F;
+				delta >>= 7;
+				out.push_back(delta != 0 ? (part | 0x80) : part);
+			} while (delta != 0);
+		}
+		out.push_back(next.opcode);
+		if (flags & DELTA_A) out.push_back(next.state.A);
+		if (flags & DELTA_FLAGS) out.push_back(next.state.FLAGS.byte);
+		if (extended & DELTA_X) out.push_back(next.state.X);
+		if (extended & DELTA_Y) out.push_back(next.state.Y);
+		if (extended & DELTA_SP) out.push_back(next.state.SP);
+	}
+
+	size_t TraceFormat::decode(const Byte* in, size_t size, TraceRecord& record) {
+		size_t pos = 0;
+		if (pos >= size) return 0;
+		Byte flags = in[pos++];
+		Byte extended = 0;
+		if (flags & DELTA_EXTENDED) {
+			if (pos >= size) return 0;
+			extended = in[pos++];
+		}
+		if ((flags & 0x03) == 0) {
+			if (pos + 2 > size) return 0;
+			record.state.PC = get16(in + pos);
+			pos += 2;
+		}
+		else {
+			record.state.PC += flags & 0x03;
+		}
+		u64 delta = (flags >> 2) & 0x07;
+		if (delta == 7) {
+			delta = 0;
+			int shift = 0;
+			bool more = true;
+			while (more) {
+				if (pos >= size || shift >= 64) return 0;
+				delta |= (u64)(in[pos] & 0x7F) << shift;
+				more = (in[pos++] & 0x80) != 0;
+				shift += 7;
+			}
+		}
+		record.cycle += delta;
+
+		size_t needed = 1 + ((flags & DELTA_A) ? 1 : 0) + ((flags & DELTA_FLAGS) ? 1 : 0) + ((extended & DELTA_X) ? 1 : 0)
+			+ ((extended & DELTA_Y) ? 1 : 0) + ((extended & DELTA_SP) ? 1 : 0);
+		if (pos + needed > size) return 0;
+		record.opcode = in[pos++];
+		if (flags & DELTA_A) record.state.A = in[pos++];
+		if (flags & DELTA_FLAGS) record.state.FLAGS.byte = in[pos++];
+		if (extended & DELTA_X) record.state.X = in[pos++];
+		if (extended & DELTA_Y) record.state.Y = in[pos++];
+		if (extended & DELTA_SP) record.state.SP = in[pos++];
+		return pos;
+	}
+
+	/* Appends a literal or match length over the 4 bits that fit in the token */
+	static void putLength(std::vector<Byte>& out, size_t length) {
+		for (; length >= 255; length -= 255) out.push_back(255);
+		out.push_back((Byte)length);
+	}
+
+	static void putSequence(std::vector<Byte>& out, const Byte* literals, size_t literalCount, size_t offset, size_t matchLength) {
+		size_t matchCode = matchLength == 0 ? 0 : matchLength - MIN_MATCH;
+		Byte token = (Byte)(((literalCount < 15 ? literalCount : 15) << 4) | (matchCode < 15 ? matchCode : 15));
+		out.push_back(token);
+		if (literalCount >= 15) putLength(out, literalCount - 15);
+		out.insert(out.end(), literals, literals + literalCount);
+		if (matchLength == 0) return;		// The last sequence is only literals
+		out.push_back(offset & 0xFF);
+		out.push_back((Byte)(offset >> 8));
+		if (matchCode >= 15) putLength(out, matchCode - 15);
+	}
+
+	/* Greedy LZ77 with a hash of the next 4 bytes, matches up to 64K back */
+	void TraceFormat::compress(const Byte* in, size_t size, std::vector<Byte>& out) {
+		out.clear();
+		std::vector<u32> table((size_t)1 << HASH_BITS, NO_POSITION);
+		size_t anchor = 0;
+		size_t pos = 0;
+		while (pos + MIN_MATCH <= size) {
+			u32 sequence = in[pos] | (in[pos + 1] << 8) | (in[pos + 2] << 16) | ((u32)in[pos + 3] << 24);
+			u32 hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+			u32 candidate = table[hash];
+			table[hash] = (u32)pos;
+			if (candidate != NO_POSITION && pos - candidate <= 0xFFFF && memcmp(in + candidate, in + pos, MIN_MATCH) == 0) {
+				size_t length = MIN_MATCH;
+				while (pos + length < size && in[candidate + length] == in[pos + length]) length++;
+				putSequence(out, in + anchor, pos - anchor, pos - candidate, length);
+				pos += length;
+				anchor = pos;
+			}
+			else {
+				pos++;
+			}
+		}
+		if (anchor < size) putSequence(out, in + anchor, size - anchor, 0, 0);
+	}
+
+	/* Reads a length extension, false if the input runs out */
+	static bool getLength(const Byte* in, size_t size, size_t& pos, size_t& length) {
+		Byte next;
+		do {
+			if (pos >= size) return false;
+			next = in[pos++];
+			length += next;
+		} while (next == 255);
+		return true;
+	}
+
+	bool TraceFormat::decompress(const Byte* in, size_t size, Byte* out, size_t rawSize) {
+		size_t pos = 0;
+		size_t written = 0;
+		while (pos < size) {
+			Byte token = in[pos++];
+			size_t literals = token >> 4;
+			if (literals == 15 && !getLength(in, size, pos, literals)) return false;
+			if (pos + literals > size || written + literals > rawSize) return false;
+			memcpy(out + written, in + pos, literals);
+			pos += literals;
+			written += literals;
+			if (pos == size) break;
+
+			if (pos + 2 > size) return false;
+			size_t offset = get16(in + pos);
+			pos += 2;
+			size_t length = token & 0x0F;
+			if (length == 15 && !getLength(in, size, pos, length)) return false;
+			length += MIN_MATCH;
+			if (offset == 0 || offset > written || written + length > rawSize) return false;
+			for (size_t i = 0; i < length; i++, written++)		// Byte at a time, matches can overlap themselves
+				out[written] = out[written - offset];
+		}
+		return written == rawSize;
+	}
+
+
+	TraceWriter::TraceWriter(FILE* out, size_t chunkRecords, size_t maxPending)
+		: out(out), chunkRecords(chunkRecords), maxPending(maxPending) {}
+
+	TraceWriter::~TraceWriter() {
+		finish();
+	}
+
+	bool TraceWriter::start() {
+		if (started) return true;
+		Byte header[TraceFormat::HEADER_SIZE] = {};
+		memcpy(header, MAGIC, sizeof(MAGIC));
+		put16(header + 4, TraceFormat::VERSION);
+		put16(header + 6, TraceFormat::HEADER_SIZE);
+		put32(header + 8, (u32)chunkRecords);
+		failed = false;
+		written = 0;
+		count = 0;
+		index.clear();
+		writeBytes(header, sizeof(header));
+		if (failed) return false;
+
+		active = Pending();
+		active.deltas.reserve(chunkRecords * 4);
+		stopping = false;
+		started = true;
+		writer = std::thread(&TraceWriter::writerLoop, this);
+		return true;
+	}
+
+	bool TraceWriter::finish() {
+		if (!started) return !failed;
+		if (active.records > 0) handOff();
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			stopping = true;
+		}
+		changed.notify_all();
+		writer.join();
+		started = false;
+
+		// Index and footer
+		u64 indexOffset = written;
+		std::vector<Byte> tail(index.size() * TraceFormat::INDEX_ENTRY_SIZE + TraceFormat::FOOTER_SIZE, 0);
+		Byte* entry = tail.data();
+		for (const TraceChunk& chunk : index) {
+			put64(entry, chunk.keyframe.cycle);
+			put64(entry + 8, chunk.offset);
+			put32(entry + 16, chunk.records);
+			entry += TraceFormat::INDEX_ENTRY_SIZE;
+		}
+		put64(entry, indexOffset);
+		put32(entry + 8, (u32)index.size());
+		memcpy(entry + 12, FOOTER_MAGIC, sizeof(FOOTER_MAGIC));
+		writeBytes(tail.data(), tail.size());
+		if (fflush(out) != 0) failed = true;
+		return !failed;
+	}
+
+	/* Keyframes start each chunk, everything else is a delta from the record before */
+	void TraceWriter::trace(const CPUState& state, u64 cycle, Byte opcode) {
+		if (!started) return;
+		TraceRecord next;
+		next.cycle = cycle;
+		next.state = state;
+		next.opcode = opcode;
+		if (active.records == 0) active.keyframe = next;
+		else TraceFormat::encode(last, next, active.deltas);
+		last = next;
+		active.records++;
+		count++;
+		if (active.records == chunkRecords) handOff();
+	}
+
+	/* Waits only if the writer has fallen <maxPending> chunks behind */
+	void TraceWriter::handOff() {
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			changed.wait(guard, [this] { return queue.size() < maxPending; });
+			queue.push_back(std::move(active));
+		}
+		changed.notify_all();
+		active = Pending();
+		active.deltas.reserve(chunkRecords * 4);
+	}
+
+	void TraceWriter::writerLoop() {
+		std::vector<Byte> compressed;
+		std::unique_lock<std::mutex> guard(lock);
+		while (true) {
+			changed.wait(guard, [this] { return !queue.empty() || stopping; });
+			if (queue.empty()) break;		// Stopping and everything is written
+			Pending chunk = std::move(queue.front());
+			queue.pop_front();
+			guard.unlock();
+			changed.notify_all();
+			writeChunk(chunk, compressed);
+			guard.lock();
+		}
+	}
+
+	void TraceWriter::writeChunk(Pending& chunk, std::vector<Byte>& compressed) {
+		TraceFormat::compress(chunk.deltas.data(), chunk.deltas.size(), compressed);
+
+		TraceChunk entry;
+		entry.offset = written;
+		entry.compressedSize = (u32)compressed.size();
+		entry.rawSize = (u32)chunk.deltas.size();
+		entry.records = chunk.records;
+		entry.keyframe = chunk.keyframe;
+		index.push_back(entry);
+
+		Byte header[TraceFormat::CHUNK_HEADER_SIZE];
+		memcpy(header, CHUNK_MAGIC, sizeof(CHUNK_MAGIC));
+		put32(header + 4, entry.compressedSize);
+		put32(header + 8, entry.rawSize);
+		put32(header + 12, entry.records);
+		put64(header + 16, entry.keyframe.cycle);
+		put16(header + 24, entry.keyframe.state.PC);
+		header[26] = entry.keyframe.opcode;
+		header[27] = entry.keyframe.state.A;
+		header[28] = entry.keyframe.state.X;
+		header[29] = entry.keyframe.state.Y;
+		header[30] = entry.keyframe.state.SP;
+		header[31] = entry.keyframe.state.FLAGS.byte;
+		writeBytes(header, sizeof(header));
+		writeBytes(compressed.data(), compressed.size());
+	}
+
+	void TraceWriter::writeBytes(const void* bytes, size_t length) {
+		if (length == 0) return;
+		if (fwrite(bytes, 1, length, out) != length) failed = true;
+		written += length;
+	}
+
+
+	bool TraceReader::open(const Byte* traceData, size_t traceSize) {
+		data = traceData;
+		size = traceSize;
+		chunks.clear();
+		count = 0;
+		if (size < TraceFormat::HEADER_SIZE || memcmp(data, MAGIC, sizeof(MAGIC)) != 0) return false;
+		if (get16(data + 4) != TraceFormat::VERSION) return false;
+		u16 headerSize = get16(data + 6);
+		if (headerSize < TraceFormat::HEADER_SIZE || headerSize > size) return false;
+
+		// Use the index if the writer finished, otherwise walk the chunks
+		bool indexed = false;
+		if (size >= (size_t)headerSize + TraceFormat::FOOTER_SIZE && memcmp(data + size - 4, FOOTER_MAGIC, sizeof(FOOTER_MAGIC)) == 0) {
+			const Byte* footer = data + size - TraceFormat::FOOTER_SIZE;
+			u64 indexOffset = get64(footer);
+			u32 chunkCount = get32(footer + 8);
+			if (indexOffset + (u64)chunkCount * TraceFormat::INDEX_ENTRY_SIZE + TraceFormat::FOOTER_SIZE == size) {
+				indexed = true;
+				for (u32 i = 0; i < chunkCount && indexed; i++) {
+					TraceChunk chunk;
+					indexed = readChunkHeader(get64(data + indexOffset + i * TraceFormat::INDEX_ENTRY_SIZE + 8), chunk);
+					chunks.push_back(chunk);
+				}
+			}
+		}
+		if (!indexed && !scanChunks()) return false;
+
+		for (const TraceChunk& chunk : chunks)
+			count += chunk.records;
+		return true;
+	}
+
+	bool TraceReader::scanChunks() {
+		chunks.clear();
+		u64 offset = get16(data + 6);
+		TraceChunk chunk;
+		while (readChunkHeader(offset, chunk)) {
+			chunks.push_back(chunk);
+			offset += TraceFormat::CHUNK_HEADER_SIZE + chunk.compressedSize;
+		}
+		return true;
+	}
+
+	bool TraceReader::readChunkHeader(u64 offset, TraceChunk& chunk) const {
+		if (offset + TraceFormat::CHUNK_HEADER_SIZE > size) return false;
+		const Byte* header = data + offset;
+		if (memcmp(header, CHUNK_MAGIC, sizeof(CHUNK_MAGIC)) != 0) return false;
+		chunk.offset = offset;
+		chunk.compressedSize = get32(header + 4);
+		chunk.rawSize = get32(header + 8);
+		chunk.records = get32(header + 12);
+		if (offset + TraceFormat::CHUNK_HEADER_SIZE + chunk.compressedSize > size || chunk.records == 0) return false;
+		chunk.keyframe.cycle = get64(header + 16);
+		chunk.keyframe.state.PC = get16(header + 24);
+		chunk.keyframe.opcode = header[26];
+		chunk.keyframe.state.A = header[27];
+		chunk.keyframe.state.X = header[28];
+		chunk.keyframe.state.Y = header[29];
+		chunk.keyframe.state.SP = header[30];
+		chunk.keyframe.state.FLAGS.byte = header[31];
+		return true;
+	}
+
+	bool TraceReader::readChunk(size_t index, std::vector<TraceRecord>& out) const {
+		const TraceChunk& chunk = chunks[index];
+		std::vector<Byte> raw(chunk.rawSize);
+		out.clear();
+		if (!TraceFormat::decompress(data + chunk.offset + TraceFormat::CHUNK_HEADER_SIZE, chunk.compressedSize, raw.data(), raw.size()))
+			return false;
+
+		out.reserve(chunk.records);
+		TraceRecord record = chunk.keyframe;
+		out.push_back(record);
+		size_t pos = 0;
+		for (u32 i = 1; i < chunk.records; i++) {
+			size_t used = TraceFormat::decode(raw.data() + pos, raw.size() - pos, record);
+			if (used == 0) return false;
+			pos += used;
+			out.push_back(record);
+		}
+		return pos == raw.size();
+	}
+
+	int TraceReader::findChunk(u64 cycle) const {
+		auto after = std::upper_bound(chunks.begin(), chunks.end(), cycle,
+			[](u64 value, const TraceChunk& chunk) { return value < chunk.keyframe.cycle; });
+		return (int)(after - chunks.begin()) - 1;
+	}
+
+	bool TraceReader::seek(u64 cycle, TraceRecord& out) const {
+		int index = findChunk(cycle);
+		if (index < 0) return false;
+		std::vector<TraceRecord> records;
+		if (!readChunk(index, records)) return false;
+		auto after = std::upper_bound(records.begin(), records.end(), cycle,
+			[](u64 value, const TraceRecord& record) { return value < record.cycle; });
+		out = *(after - 1);
+		return true;
+	}
+}
@@ -0,0 +1,181 @@
+#pragma once
+#include <stdio.h>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "types.h"
+#include "cpu.h"
+
+namespace E6502 {
+
+	/* One traced instruction - the registers before it ran */
+	struct TraceRecord {
+		u64 cycle = 0;
+		CPUState state;
+		Byte opcode = 0;
+	};
+
+	/* Where a chunk is and what it starts with */
+	struct TraceChunk {
+		u64 offset = 0;				// File offset of the chunk header
+		u32 compressedSize = 0;
+		u32 rawSize = 0;
+		u32 records = 0;
+		TraceRecord keyframe;		// First record of the chunk, stored whole in the header
+	};
+
+	/**
+	 * Instruction trace file format.
+	 *
+	 * Layout (little endian):
+	 *   Header  16 bytes  "E65T", version, header size, records per chunk, (reserved)
+	 *   Chunks  32 byte header ("E65C", compressed size, raw size, records, keyframe cycle, keyframe registers
+	 *           and opcode) then the compressed deltas of the records after the keyframe
+	 *   Index   24 bytes a chunk (keyframe cycle, file offset, records, reserved)
+	 *   Footer  16 bytes  index offset, chunk count, "E65X"
+	 *
+	 * Each record after the keyframe is a flags byte then only what changed: the PC unless it moved on by 1-3
+	 * bytes, the cycle delta unless it is under 7, the opcode, then A, FLAGS, X, Y and SP if they changed. Most
+	 * instructions take 2-4 bytes. The deltas of each chunk are then compressed on their own with a small LZ77
+	 * codec (tight loops produce the same bytes over and over), so any chunk can be decoded without the others.
+	 *
+	 * A file whose writer never finished has no index, readers rebuild it by walking the chunk headers.
+	 */
+	class TraceFormat {
+	private:
+		TraceFormat();		// Only used statically
+
+	public:
+		constexpr static u16 VERSION = 1;
+		constexpr static u16 HEADER_SIZE = 16;
+		constexpr static u16 CHUNK_HEADER_SIZE = 32;
+		constexpr static u16 INDEX_ENTRY_SIZE = 24;
+		constexpr static u16 FOOTER_SIZE = 16;
+
+		/* Appends <next> to <out> as a delta from <previous> */
+		static void encode(const TraceRecord& previous, const TraceRecord& next, std::vector<Byte>& out);
+
+		/* Reads the delta at <in> and applies it to <record>, returns the bytes used or 0 if it's cut short */
+		static size_t decode(const Byte* in, size_t size, TraceRecord& record);
+
+		/* LZ77 compresses <size> bytes to <out> */
+		static void compress(const Byte* in, size_t size, std::vector<Byte>& out);
+
+		/* Expands <size> compressed bytes into exactly <rawSize> bytes at <out>, false if the data is corrupt */
+		static bool decompress(const Byte* in, size_t size, Byte* out, size_t rawSize);
+	};
+
+	/**
+	 * Streams a trace of every instruction the CPU runs to a file (use as the CPU's Tracer).
+	 *
+	 * trace() only delta encodes into the current chunk, full chunks are handed to a writer thread that
+	 * compresses and writes them, so the emulation thread never waits on compression or the disk unless
+	 * <maxPending> chunks are queued.
+	 */
+	class TraceWriter : public Tracer {
+	private:
+		struct Pending {
+			std::vector<Byte> deltas;
+			TraceRecord keyframe;
+			u32 records = 0;
+		};
+
+		FILE* out;
+		size_t chunkRecords;
+		size_t maxPending;
+
+		Pending active;					// Filled by the emulation thread
+		TraceRecord last;
+		u64 count = 0;
+
+		std::deque<Pending> queue;		// Full chunks waiting for the writer
+		std::vector<TraceChunk> index;	// Written chunks (writer thread only until finish())
+		std::atomic<u64> written{ 0 };	// Bytes written to <out>
+		bool failed = false;
+		bool stopping = false;
+		bool started = false;
+		std::thread writer;
+		std::mutex lock;
+		std::condition_variable changed;
+
+		/* Queues the active chunk for the writer */
+		void handOff();
+
+		/* Writer thread loop */
+		void writerLoop();
+
+		/* Compresses and writes one chunk (writer thread) */
+		void writeChunk(Pending& chunk, std::vector<Byte>& compressed);
+
+		void writeBytes(const void* data, size_t size);
+
+	public:
+		constexpr static size_t DEFAULT_CHUNK_RECORDS = 0x10000;
+
+		/* Writes to <out> (owned by the caller), <chunkRecords> instructions a chunk */
+		TraceWriter(FILE* out, size_t chunkRecords = DEFAULT_CHUNK_RECORDS, size_t maxPending = 8);
+
+		/* Finishes the file if finish() wasn't called */
+		~TraceWriter();
+
+		TraceWriter(const TraceWriter&) = delete;
+		TraceWriter& operator=(const TraceWriter&) = delete;
+
+		/* Writes the header and starts the writer thread */
+		bool start();
+
+		/* Writes the last chunk, the index and footer. Returns false if anything failed to write */
+		bool finish();
+
+		/* Instructions traced */
+		u64 records() const { return count; }
+
+		/* Bytes written to the file so far */
+		u64 bytesWritten() const { return written; }
+
+		/** Tracer */
+		virtual void trace(const CPUState& state, u64 cycle, Byte opcode);
+	};
+
+	/**
+	 * Reads a trace from memory (e.g. a mapped file). open() only reads the index and chunk headers, chunks are decoded on demand.
+	 */
+	class TraceReader {
+	private:
+		const Byte* data = nullptr;
+		size_t size = 0;
+		std::vector<TraceChunk> chunks;
+		u64 count = 0;
+
+		/* Builds the index by walking the chunk headers (for a trace that wasn't finished) */
+		bool scanChunks();
+
+		/* Reads the chunk header at <offset> */
+		bool readChunkHeader(u64 offset, TraceChunk& chunk) const;
+
+	public:
+		/* Uses the <size> bytes at <data>, which must stay valid. Returns false if it isn't a trace */
+		bool open(const Byte* data, size_t size);
+
+		/* Number of chunks */
+		size_t chunkCount() const { return chunks.size(); }
+
+		/* Chunk <index> */
+		const TraceChunk& chunk(size_t index) const { return chunks[index]; }
+
+		/* Total instructions */
+		u64 records() const { return count; }
+
+		/* Decodes every record of chunk <index> into <out>, false if it is corrupt */
+		bool readChunk(size_t index, std::vector<TraceRecord>& out) const;
+
+		/* Index of the chunk holding the instruction running at <cycle> (found from the keyframes), or -1 before the first */
+		int findChunk(u64 cycle) const;
+
+		/* The last instruction starting at or before <cycle>, decoding only its chunk. False if there is none */
+		bool seek(u64 cycle, TraceRecord& out) const;
+	};
+}
@@ -0,0 +1,164 @@
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include "trace_analysis.h"
+
+namespace E6502 {
+
+	void TraceProfile::merge(const TraceProfile& other) {
+		instructions += other.instructions;
+		cycles += other.cycles;
+		for (int i = 0; i < 0x100; i++) {
+			opcodeCounts[i] += other.opcodeCounts[i];
+			opcodeCycles[i] += other.opcodeCycles[i];
+			stackDepth[i] += other.stackDepth[i];
+		}
+		for (int i = 0; i < MAX_MEM; i++)
+			executed[i] += other.executed[i];
+	}
+
+	/* Threads to use for <jobs> chunks */
+	static unsigned workerCount(unsigned threads, size_t jobs) {
+		if (threads == 0) threads = std::thread::hardware_concurrency();
+		if (threads == 0) threads = 1;
+		if (threads > jobs) threads = jobs == 0 ? 1 : (unsigned)jobs;
+		return threads;
+	}
+
+	/* Runs <work>(worker) on <workers> threads, including this one */
+	template<typename Work>
+	static void runWorkers(unsigned workers, Work work) {
+		std::vector<std::thread> pool;
+		for (unsigned i = 1; i < workers; i++)
+			pool.emplace_back(work, i);
+		work(0);
+		for (std::thread& thread : pool)
+			thread.join();
+	}
+
+	/* Index of the first record of each chunk, plus the total at the end */
+	static std::vector<u64> chunkStarts(const TraceReader& reader) {
+		std::vector<u64> starts(1, 0);
+		for (size_t i = 0; i < reader.chunkCount(); i++)
+			starts.push_back(starts.back() + reader.chunk(i).records);
+		return starts;
+	}
+
+	static bool sameRecord(const TraceRecord& a, const TraceRecord& b) {
+		return a.cycle == b.cycle && a.opcode == b.opcode && a.state == b.state;
+	}
+
+	/* Workers take chunks in turn and count into their own profile, merged at the end */
+	bool TraceAnalysis::profile(const TraceReader& reader, TraceProfile& out, unsigned threads) {
+		out = TraceProfile();
+		size_t chunks = reader.chunkCount();
+		unsigned workers = workerCount(threads, chunks);
+		std::vector<TraceProfile> partial(workers);
+		std::atomic<size_t> next{ 0 };
+		std::atomic<bool> ok{ true };
+
+		runWorkers(workers, [&](unsigned worker) {
+			TraceProfile& counts = partial[worker];
+			std::vector<TraceRecord> records;
+			for (size_t chunk = next++; chunk < chunks && ok; chunk = next++) {
+				if (!reader.readChunk(chunk, records)) {
+					ok = false;
+					break;
+				}
+				for (size_t i = 0; i < records.size(); i++) {
+					const TraceRecord& record = records[i];
+					counts.opcodeCounts[record.opcode]++;
+					counts.executed[record.state.PC]++;
+					counts.stackDepth[record.state.SP]++;
+
+					// An instruction's cycles run until the next one starts, which may be in the next chunk
+					u64 following;
+					if (i + 1 < records.size()) following = records[i + 1].cycle;
+					else if (chunk + 1 < chunks) following = reader.chunk(chunk + 1).keyframe.cycle;
+					else continue;
+					counts.opcodeCycles[record.opcode] += following - record.cycle;
+					counts.cycles += following - record.cycle;
+				}
+				counts.instructions += records.size();
+			}
+		});
+
+		for (const TraceProfile& counts : partial)
+			out.merge(counts);
+		return ok;
+	}
+
+	std::vector<HotSpot> TraceAnalysis::hotSpots(const TraceProfile& profile, size_t count) {
+		std::vector<HotSpot> spots;
+		for (int address = 0; address < MAX_MEM; address++) {
+			if (profile.executed[address] == 0) continue;
+			HotSpot spot;
+			spot.address = address;
+			spot.count = profile.executed[address];
+			spots.push_back(spot);
+		}
+		auto busier = [](const HotSpot& a, const HotSpot& b) { return a.count != b.count ? a.count > b.count : a.address < b.address; };
+		if (count < spots.size()) {
+			std::partial_sort(spots.begin(), spots.begin() + count, spots.end(), busier);
+			spots.resize(count);
+		}
+		else {
+			std::sort(spots.begin(), spots.end(), busier);
+		}
+		return spots;
+	}
+
+	void TraceAnalysis::writeHeatmap(const TraceProfile& profile, FILE* out) {
+		for (int page = 0; page < 0x100; page++) {
+			for (int offset = 0; offset < 0x100; offset++)
+				fprintf(out, offset == 0 ? "%llu" : ",%llu", (unsigned long long)profile.executed[(page << 8) | offset]);
+			fputc('\n', out);
+		}
+	}
+
+	/* Workers compare a chunk of <a> at a time against the matching records of <b>, keeping the earliest difference */
+	s64 TraceAnalysis::firstDivergence(const TraceReader& a, const TraceReader& b, unsigned threads) {
+		std::vector<u64> startsA = chunkStarts(a);
+		std::vector<u64> startsB = chunkStarts(b);
+		u64 common = std::min(a.records(), b.records());
+		size_t chunks = a.chunkCount();
+		std::atomic<u64> first{ common };
+		std::atomic<size_t> next{ 0 };
+		std::atomic<bool> ok{ true };
+
+		runWorkers(workerCount(threads, chunks), [&](unsigned) {
+			std::vector<TraceRecord> recordsA;
+			std::vector<TraceRecord> recordsB;
+			size_t loadedB = b.chunkCount();
+			for (size_t chunk = next++; chunk < chunks && ok; chunk = next++) {
+				u64 start = startsA[chunk];
+				if (start >= first) break;		// Chunks are handed out in order, later ones can't be earlier
+				if (!a.readChunk(chunk, recordsA)) {
+					ok = false;
+					break;
+				}
+				for (size_t i = 0; i < recordsA.size(); i++) {
+					u64 index = start + i;
+					if (index >= first) break;
+					size_t chunkB = (size_t)(std::upper_bound(startsB.begin(), startsB.end(), index) - startsB.begin()) - 1;
+					if (chunkB != loadedB) {
+						if (!b.readChunk(chunkB, recordsB)) {
+							ok = false;
+							break;
+						}
+						loadedB = chunkB;
+					}
+					if (!sameRecord(recordsA[i], recordsB[index - startsB[chunkB]])) {
+						u64 current = first;
+						while (index < current && !first.compare_exchange_weak(current, index)) {}
+						break;
+					}
+				}
+			}
+		});
+
+		if (!ok) return -2;
+		if (first < common) return (s64)first;
+		return a.records() == b.records() ? -1 : (s64)common;
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <stdio.h>
+#include <vector>
+#include "types.h"
+#include "trace.h"
+
+namespace E6502 {
+
+	/* Totals gathered from a trace */
+	struct TraceProfile {
+		u64 instructions = 0;
+		u64 cycles = 0;							// From the first instruction to the start of the last
+		u64 opcodeCounts[0x100] = {};
+		u64 opcodeCycles[0x100] = {};			// Cycles until the next instruction, so IRQ entry is charged to the instruction before
+		std::vector<u64> executed;				// Instructions started at each address - the fetch heatmap
+		u64 stackDepth[0x100] = {};				// Instructions run at each stack pointer value
+
+		TraceProfile() : executed(MAX_MEM, 0) {}
+
+		/* Adds another profile's counts to this one */
+		void merge(const TraceProfile& other);
+	};
+
+	/* An address and how many instructions started there */
+	struct HotSpot {
+		Word address;
+		u64 count;
+	};
+
+	/**
+	 * Analyses of a whole trace. Chunks are independent, so each analysis hands them out to <threads> worker
+	 * threads (0 for one per core) and combines the results.
+	 */
+	class TraceAnalysis {
+	private:
+		TraceAnalysis();		// Only used statically
+
+	public:
+		/* Counts opcodes, cycles, addresses and stack depths over every instruction. False if a chunk is corrupt */
+		static bool profile(const TraceReader& reader, TraceProfile& out, unsigned threads = 0);
+
+		/* The <count> addresses the most instructions started at, busiest first */
+		static std::vector<HotSpot> hotSpots(const TraceProfile& profile, size_t count);
+
+		/* Writes the fetch heatmap as CSV, a row of 256 counts for each page */
+		static void writeHeatmap(const TraceProfile& profile, FILE* out);
+
+		/**
+		 * Index of the first instruction that differs between two traces (cycle, registers or opcode). If one trace
+		 * is the start of the other this is the length of the shorter one, -1 if they are the same. -2 if a chunk
+		 * is corrupt.
+		 */
+		static s64 firstDivergence(const TraceReader& a, const TraceReader& b, unsigned threads = 0);
+	};
+}
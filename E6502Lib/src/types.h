@@ -1,6 +1,7 @@
 #pragma once
 #include <stdio.h>
 #include <vector>
+#include <type_traits>
 
 // TODO -> Move InstructionHandler, inHandlrFn, Memory and CPUState into new files
 namespace E6502 {
@@ -14,6 +15,12 @@ namespace E6502 {
 	using u16 = unsigned short;
 	using s16 = signed short;
 
+	using u32 = unsigned int;
+	using s32 = signed int;
+
+	using u64 = unsigned long long;
+	using s64 = signed long long;
+
 	/* Bitwise flag register */
 	struct StatusFlags {
 		// Status Flags
@@ -35,7 +42,7 @@ namespace E6502 {
 		};
 	};
 
-	/* Represents the internal state of a CPU (Not including memory) */
+	/* Represents the internal state of a CPU (Not including memory) - a plain struct so it can be copied in and out of the CPU cheaply */
 	struct CPUState {
 
 	public:
@@ -57,7 +64,7 @@ namespace E6502 {
 		Byte Y = 0;
 
 		/** Resets all fields in this state back to 0, SP init to 0xFF, PC init to DEFAULT_RESET_VECTOR */
-		virtual void reset() {
+		void reset() {
 			A = X = Y = 0;
 			PC = DEFAULT_RESET_VECTOR;
 			SP = DEFAULT_SP;
@@ -71,6 +78,7 @@ namespace E6502 {
 				FLAGS.byte == other.FLAGS.byte);
 		}
 	};
+	static_assert(std::is_standard_layout<CPUState>::value, "CPUState must remain a plain standard-layout struct");
 
 	struct Program {
 		Word loadAddress = 0x8000;
@@ -0,0 +1,59 @@
+#include "write_log.h"
+
+namespace E6502 {
+
+	WriteLog::WriteLog(size_t maxChunks) : maxChunks(maxChunks), newest(MAX_MEM, 0) {}
+
+	void WriteLog::addChunk() {
+		if (maxChunks != 0 && chunks.size() >= maxChunks) {
+			chunks.pop_front();
+			first += CHUNK_SIZE;
+		}
+		chunks.push_back(Chunk());
+		current = &chunks.back();
+		current->cycle.resize(CHUNK_SIZE);
+		current->pc.resize(CHUNK_SIZE);
+		current->address.resize(CHUNK_SIZE);
+		current->oldValue.resize(CHUNK_SIZE);
+		current->newValue.resize(CHUNK_SIZE);
+		current->previous.resize(CHUNK_SIZE);
+		fill = 0;
+	}
+
+	/* Follows the links back from the newest write to the address */
+	size_t WriteLog::lastWriters(Word address, size_t count, std::vector<WriteRecord>& out) const {
+		out.clear();
+		if (newest[address] == 0) return 0;
+		u64 index = newest[address] - 1;
+		while (out.size() < count && index >= first) {
+			const Chunk& chunk = chunks[(index - first) / CHUNK_SIZE];
+			size_t offset = (index - first) % CHUNK_SIZE;
+			out.push_back(at(index));
+			u32 distance = chunk.previous[offset];
+			if (distance == 0 || distance > index) break;
+			index -= distance;
+		}
+		return out.size();
+	}
+
+	WriteRecord WriteLog::at(u64 index) const {
+		const Chunk& chunk = chunks[(index - first) / CHUNK_SIZE];
+		size_t offset = (index - first) % CHUNK_SIZE;
+		WriteRecord record;
+		record.cycle = chunk.cycle[offset];
+		record.pc = chunk.pc[offset];
+		record.address = chunk.address[offset];
+		record.oldValue = chunk.oldValue[offset];
+		record.newValue = chunk.newValue[offset];
+		return record;
+	}
+
+	void WriteLog::clear() {
+		chunks.clear();
+		current = nullptr;
+		fill = CHUNK_SIZE;
+		first = 0;
+		next = 0;
+		newest.assign(MAX_MEM, 0);
+	}
+}
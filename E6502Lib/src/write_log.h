@@ -0,0 +1,91 @@
+#pragma once
+#include <deque>
+#include <vector>
+#include "types.h"
+#include "memory.h"
+
+namespace E6502 {
+
+	/* One logged write */
+	struct WriteRecord {
+		u64 cycle;			// Cycle the writing instruction started
+		Word pc;			// Address of the writing instruction
+		Word address;
+		Byte oldValue;
+		Byte newValue;
+	};
+
+	/**
+	 * History of the writes instructions make through CPU::writeByte / writeReferenceByte (stack pushes aren't
+	 * included), for finding which instruction left a bad value in memory.
+	 *
+	 * Records are stored by column in chunks of CHUNK_SIZE so appending is a handful of stores into arrays that
+	 * are already allocated. Each record also holds the distance back to the previous write to the same address
+	 * and the log keeps the newest write to every address, so the last N writers of an address are found by
+	 * following N links whatever the length of the log.
+	 *
+	 * With <maxChunks> set the oldest chunk is dropped when a new one is needed, otherwise the log grows without
+	 * limit (18 bytes a write).
+	 */
+	class WriteLog {
+	private:
+		struct Chunk {
+			std::vector<u64> cycle;
+			std::vector<Word> pc;
+			std::vector<Word> address;
+			std::vector<Byte> oldValue;
+			std::vector<Byte> newValue;
+			std::vector<u32> previous;		// Records back to the last write to the same address, 0 if none (or too far)
+		};
+
+		std::deque<Chunk> chunks;
+		Chunk* current = nullptr;
+		size_t fill = CHUNK_SIZE;			// Records used in the current chunk
+		u64 first = 0;						// Index of the oldest record kept
+		u64 next = 0;						// Index of the next record
+		size_t maxChunks;
+		std::vector<u64> newest;			// Index + 1 of the newest write to each address, 0 if none
+
+		/* Starts a new chunk, dropping the oldest if there are too many */
+		void addChunk();
+
+	public:
+		constexpr static size_t CHUNK_SIZE = 0x10000;
+
+		/* Keeps at most <maxChunks> chunks (0 for no limit) */
+		WriteLog(size_t maxChunks = 0);
+
+		/* Appends a write */
+		void record(u64 cycle, Word pc, Word address, Byte oldValue, Byte newValue) {
+			if (fill == CHUNK_SIZE) addChunk();
+			u64 index = next++;
+			u64 last = newest[address];
+			newest[address] = index + 1;
+			u64 distance = last == 0 ? 0 : index - (last - 1);
+
+			Chunk& chunk = *current;
+			chunk.cycle[fill] = cycle;
+			chunk.pc[fill] = pc;
+			chunk.address[fill] = address;
+			chunk.oldValue[fill] = oldValue;
+			chunk.newValue[fill] = newValue;
+			chunk.previous[fill] = distance > 0xFFFFFFFFULL ? 0 : (u32)distance;
+			fill++;
+		}
+
+		/* Copies up to <count> of the latest writes to <address> into <out> (newest first), returns how many */
+		size_t lastWriters(Word address, size_t count, std::vector<WriteRecord>& out) const;
+
+		/* The record at <index>, which must be between firstIndex() and size() */
+		WriteRecord at(u64 index) const;
+
+		/* Writes logged since construction or clear(), including dropped ones */
+		u64 size() const { return next; }
+
+		/* Index of the oldest record still held */
+		u64 firstIndex() const { return first; }
+
+		/* Forgets every record */
+		void clear();
+	};
+}
@@ -0,0 +1,128 @@
+#include <gmock/gmock.h>
+#include <stdio.h>
+#include <string>
+#include <algorithm>
+#include "types.h"
+#include "machine_test.h"
+#include "access_heatmap.h"
+
+namespace E6502 {
+
+	class TestAccessHeatmap : public TestMachine {
+	public:
+		virtual void SetUp() {
+			TestMachine::SetUp();
+
+			Byte program[] = {
+				INS_LDA_ZP.opcode, 0x10,				// $1000 LDA $10
+				INS_STA_ABS.opcode, 0x00, 0x30,			// $1002 STA $3000
+				INS_JSR.opcode, 0x00, 0x20,				// $1005 JSR $2000
+				INS_INC_ABX.opcode, 0x00, 0x30,			// $1008 INC $3000,X
+			};
+			Byte sub[] = { INS_RTS.opcode };
+			memory->loadProgram(0x1000, program, sizeof(program));
+			memory->loadProgram(0x2000, sub, sizeof(sub));
+		}
+
+		static void expectCounts(const AccessCounts& counts, u64 reads, u64 writes, u64 fetches) {
+			EXPECT_EQ(counts.reads, reads);
+			EXPECT_EQ(counts.writes, writes);
+			EXPECT_EQ(counts.fetches, fetches);
+		}
+
+		/* Everything written to <file> */
+		static std::string contents(FILE* file) {
+			std::string text(ftell(file), ' ');
+			rewind(file);
+			EXPECT_EQ(fread(&text[0], 1, text.size(), file), text.size());
+			fclose(file);
+			return text;
+		}
+	};
+
+	/* Test reads, writes and fetches are counted against their pages */
+	TEST_F(TestAccessHeatmap, TestPageCounts) {
+		// Given:
+		AccessHeatmap heatmap;
+		cpu->setAccessHeatmap(&heatmap);
+
+		// When:
+		cpu->execute(5);
+		cpu->setAccessHeatmap(nullptr);
+		cpu->execute(1);
+
+		// Then: opcodes and operands are fetches, the stack is the return address pushed then pulled
+		expectCounts(heatmap.page(0x00), 1, 0, 0);
+		expectCounts(heatmap.page(0x01), 2, 2, 0);
+		expectCounts(heatmap.page(0x10), 0, 0, 11);
+		expectCounts(heatmap.page(0x20), 0, 0, 1);
+		expectCounts(heatmap.page(0x30), 1, 2, 0);		// STA, then INC reads and writes
+		expectCounts(heatmap.page(0x40), 0, 0, 0);
+		EXPECT_FALSE(heatmap.hasAddresses());
+		expectCounts(heatmap.address(0x3000), 0, 0, 0);
+	}
+
+	/* Test per address counts when asked for */
+	TEST_F(TestAccessHeatmap, TestAddressCounts) {
+		// Given:
+		AccessHeatmap heatmap(true);
+		cpu->setAccessHeatmap(&heatmap);
+
+		// When:
+		cpu->execute(5);
+
+		// Then:
+		EXPECT_TRUE(heatmap.hasAddresses());
+		expectCounts(heatmap.address(0x0010), 1, 0, 0);
+		expectCounts(heatmap.address(0x01FF), 1, 1, 0);
+		expectCounts(heatmap.address(0x01FE), 1, 1, 0);
+		expectCounts(heatmap.address(0x1000), 0, 0, 1);
+		expectCounts(heatmap.address(0x100A), 0, 0, 1);
+		expectCounts(heatmap.address(0x100B), 0, 0, 0);
+		expectCounts(heatmap.address(0x3000), 1, 2, 0);
+
+		// When:
+		heatmap.clear();
+
+		// Then:
+		expectCounts(heatmap.address(0x3000), 0, 0, 0);
+		expectCounts(heatmap.page(0x10), 0, 0, 0);
+	}
+
+	/* Test the CSV and JSON exports */
+	TEST_F(TestAccessHeatmap, TestExport) {
+		// Given:
+		AccessHeatmap heatmap(true);
+		cpu->setAccessHeatmap(&heatmap);
+		cpu->execute(2);
+
+		// When:
+		FILE* pages = tmpfile();
+		FILE* addresses = tmpfile();
+		FILE* json = tmpfile();
+		ASSERT_NE(pages, nullptr);
+		ASSERT_NE(addresses, nullptr);
+		ASSERT_NE(json, nullptr);
+		heatmap.writeCSV(pages);
+		heatmap.writeCSV(addresses, true);
+		heatmap.writeJSON(json);
+		std::string pageText = contents(pages);
+		std::string addressText = contents(addresses);
+		std::string jsonText = contents(json);
+
+		// Then: a header and 256 pages
+		EXPECT_EQ(std::count(pageText.begin(), pageText.end(), '\n'), 257);
+		EXPECT_EQ(pageText.find("address,reads,writes,fetches\n$0000,1,0,0\n"), 0);
+		EXPECT_NE(pageText.find("\n$1000,0,0,5\n"), std::string::npos);
+		EXPECT_NE(pageText.find("\n$3000,0,1,0\n"), std::string::npos);
+
+		// Then: only the addresses touched
+		EXPECT_EQ(addressText, "address,reads,writes,fetches\n$0010,1,0,0\n$1000,0,0,1\n$1001,0,0,1\n$1002,0,0,1\n"
+			"$1003,0,0,1\n$1004,0,0,1\n$3000,0,1,0\n");
+
+		// Then:
+		EXPECT_EQ(jsonText.find("{\"pages\":[{\"page\":0,\"reads\":1,\"writes\":0,\"fetches\":0},"), 0);
+		EXPECT_NE(jsonText.find(",{\"page\":255,\"reads\":0,\"writes\":0,\"fetches\":0}],\"addresses\":[{\"address\":16,"), std::string::npos);
+		EXPECT_NE(jsonText.find("{\"address\":12288,\"reads\":0,\"writes\":1,\"fetches\":0}]}\n"), std::string::npos);
+	}
+}
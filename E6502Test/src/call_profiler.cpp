@@ -0,0 +1,202 @@
+#include <gmock/gmock.h>
+#include <stdio.h>
+#include <string>
+#include "types.h"
+#include "machine_test.h"
+#include "call_profiler.h"
+#include "symbol_table.h"
+
+namespace E6502 {
+
+	class TestCallProfiler : public TestMachine {
+	public:
+		/* The profile for <address>, fails the test if it wasn't called */
+		static FunctionProfile find(const std::vector<FunctionProfile>& functions, Word address) {
+			for (const FunctionProfile& function : functions)
+				if (function.address == address) return function;
+			ADD_FAILURE() << "No profile for " << address;
+			return FunctionProfile();
+		}
+
+		/* Everything writeFolded() writes */
+		static std::string folded(const CallProfiler& profiler, const SymbolTable* symbols = nullptr) {
+			FILE* file = tmpfile();
+			EXPECT_NE(file, nullptr);
+			profiler.writeFolded(file, symbols);
+			std::string text(ftell(file), ' ');
+			rewind(file);
+			EXPECT_EQ(fread(&text[0], 1, text.size(), file), text.size());
+			fclose(file);
+			return text;
+		}
+	};
+
+	/* Test cycles are charged to the subroutines on the stack and split by call path */
+	TEST_F(TestCallProfiler, TestNestedCalls) {
+		// Given: main calls A then B, A also calls B
+		Byte program[] = {
+			INS_JSR.opcode, 0x00, 0x20,			// $1000 JSR A
+			INS_JSR.opcode, 0x00, 0x30,			// $1003 JSR B
+			INS_JMP_ABS.opcode, 0x00, 0x10,		// $1006 JMP $1000
+		};
+		Byte subA[] = { INS_JSR.opcode, 0x00, 0x30, INS_RTS.opcode };
+		Byte subB[] = { INS_NOP_IMP.opcode, INS_RTS.opcode };
+		memory->loadProgram(0x1000, program, sizeof(program));
+		memory->loadProgram(0x2000, subA, sizeof(subA));
+		memory->loadProgram(0x3000, subB, sizeof(subB));
+		CallProfiler profiler(cpu);
+		profiler.start();
+
+		// When: 10 times round the loop
+		u64 startCycle = cpu->getCycles();
+		for (int i = 0; i < 10; i++)
+			cpu->execute(9);
+		u64 cycles = cpu->getCycles() - startCycle;
+		profiler.finish();
+		std::vector<FunctionProfile> functions = profiler.functions();
+
+		// Then: B is NOP + RTS, A is JSR + B + RTS
+		EXPECT_EQ(cycles, 430);
+		ASSERT_EQ(functions.size(), 2);
+		EXPECT_EQ(functions[0].address, 0x2000);
+		EXPECT_EQ(functions[0].calls, 10);
+		EXPECT_EQ(functions[0].inclusive, 200);
+		EXPECT_EQ(functions[0].exclusive, 120);
+		EXPECT_EQ(functions[1].address, 0x3000);
+		EXPECT_EQ(functions[1].calls, 20);
+		EXPECT_EQ(functions[1].inclusive, 160);
+		EXPECT_EQ(functions[1].exclusive, 160);
+		EXPECT_FALSE(functions[1].interrupt);
+
+		// Then: every cycle appears once in the folded stacks
+		EXPECT_EQ(folded(profiler), "root 150\nroot;$2000 120\nroot;$2000;$3000 80\nroot;$3000 80\n");
+	}
+
+	/* Test an interrupt handler gets its own frame under whatever it interrupted */
+	TEST_F(TestCallProfiler, TestInterrupt) {
+		// Given:
+		Byte subB[] = { INS_NOP_IMP.opcode, INS_RTS.opcode };
+		Byte handler[] = { INS_NOP_IMP.opcode, INS_RTI.opcode };
+		Byte program[] = { INS_JSR.opcode, 0x00, 0x30 };
+		memory->loadProgram(0x1000, program, sizeof(program));
+		memory->loadProgram(0x3000, subB, sizeof(subB));
+		memory->loadProgram(0x4000, handler, sizeof(handler));
+		(*memory)[CPUInternal::IRQ_VECTOR] = 0x00;
+		(*memory)[CPUInternal::IRQ_VECTOR + 1] = 0x40;
+		state->FLAGS.bit.I = 0;
+		CallProfiler profiler(cpu);
+		profiler.start();
+
+		// When: the IRQ arrives inside B
+		cpu->execute(1);
+		cpu->setIRQ(0, true);
+		cpu->execute(1);
+		cpu->setIRQ(0, false);
+		size_t depthInHandler = profiler.depth();
+		cpu->execute(4);		// NOP, RTI, NOP, RTS
+		size_t depthAfter = profiler.depth();
+		profiler.finish();
+		std::vector<FunctionProfile> functions = profiler.functions();
+
+		// Then: the handler (NOP + RTI) is charged to itself, taking the IRQ is charged to B like a JSR to its caller
+		EXPECT_EQ(depthInHandler, 2);
+		EXPECT_EQ(depthAfter, 0);
+		FunctionProfile irq = find(functions, 0x4000);
+		EXPECT_TRUE(irq.interrupt);
+		EXPECT_EQ(irq.calls, 1);
+		EXPECT_EQ(irq.inclusive, 8);
+		EXPECT_EQ(irq.exclusive, 8);
+		FunctionProfile sub = find(functions, 0x3000);
+		EXPECT_EQ(sub.inclusive, 7 + 8 + 8);
+		EXPECT_EQ(sub.exclusive, 7 + 8);
+		EXPECT_EQ(folded(profiler), "root 6\nroot;$3000 15\nroot;$3000;irq $4000 8\n");
+	}
+
+	/* Test frames are dropped when the guest discards a return address instead of returning */
+	TEST_F(TestCallProfiler, TestDiscardedReturn) {
+		// Given: a subroutine that pulls its return address and jumps back
+		Byte program[] = { INS_JSR.opcode, 0x00, 0x20 };
+		Byte sub[] = { INS_PLA.opcode, INS_PLA.opcode, INS_JMP_ABS.opcode, 0x00, 0x10 };
+		memory->loadProgram(0x1000, program, sizeof(program));
+		memory->loadProgram(0x2000, sub, sizeof(sub));
+		CallProfiler profiler(cpu);
+		profiler.start();
+
+		// When:
+		size_t deepest = 0;
+		for (int i = 0; i < 50; i++) {
+			cpu->execute(4);
+			deepest = std::max(deepest, profiler.depth());
+		}
+		profiler.finish();
+
+		// Then: the shadow stack doesn't grow
+		EXPECT_EQ(deepest, 1);
+		std::vector<FunctionProfile> functions = profiler.functions();
+		ASSERT_EQ(functions.size(), 1);
+		EXPECT_EQ(functions[0].calls, 50);
+	}
+
+	/* Test recursive calls are only counted once in inclusive cycles */
+	TEST_F(TestCallProfiler, TestRecursion) {
+		// Given: a subroutine that calls itself until X reaches 0
+		Byte program[] = { INS_LDX_IMM.opcode, 0x03, INS_JSR.opcode, 0x00, 0x20 };
+		Byte sub[] = {
+			INS_DEX_IMP.opcode,					// $2000 DEX
+			INS_BEQ_REL.opcode, 0x03,			// $2001 BEQ done
+			INS_JSR.opcode, 0x00, 0x20,			// $2003 JSR $2000
+			INS_RTS.opcode,						// $2006 done: RTS
+		};
+		memory->loadProgram(0x1000, program, sizeof(program));
+		memory->loadProgram(0x2000, sub, sizeof(sub));
+		CallProfiler profiler(cpu);
+		profiler.start();
+
+		// When: LDX, JSR then the subroutine
+		cpu->execute(2);
+		u64 entered = cpu->getCycles();
+		cpu->execute(11);
+		u64 returned = cpu->getCycles();
+		profiler.finish();
+		std::vector<FunctionProfile> functions = profiler.functions();
+
+		// Then:
+		EXPECT_EQ(state->PC, 0x1005);
+		ASSERT_EQ(functions.size(), 1);
+		EXPECT_EQ(functions[0].calls, 3);
+		EXPECT_EQ(functions[0].inclusive, returned - entered);
+		EXPECT_EQ(functions[0].exclusive, returned - entered);
+	}
+
+	/* Test the current subroutine follows the shadow stack and folded stacks can be named from a symbol table */
+	TEST_F(TestCallProfiler, TestSymbols) {
+		// Given:
+		Byte program[] = { INS_LDX_IMM.opcode, 0x02, INS_JSR.opcode, 0x00, 0x20 };
+		Byte sub[] = {
+			INS_DEX_IMP.opcode,					// $2000 recurse: DEX
+			INS_BEQ_REL.opcode, 0x03,			// $2001 BEQ done
+			INS_JSR.opcode, 0x00, 0x20,			// $2003 JSR recurse
+			INS_RTS.opcode,						// $2006 done: RTS
+		};
+		memory->loadProgram(0x1000, program, sizeof(program));
+		memory->loadProgram(0x2000, sub, sizeof(sub));
+		SymbolTable symbols;
+		symbols.add("recurse", 0x2000);
+		CallProfiler profiler(cpu);
+		profiler.start();
+
+		// When:
+		s32 before = profiler.current();
+		cpu->execute(2);
+		s32 inside = profiler.current();
+		cpu->execute(7);
+		s32 after = profiler.current();
+		profiler.finish();
+
+		// Then:
+		EXPECT_EQ(before, -1);
+		EXPECT_EQ(inside, 0x2000);
+		EXPECT_EQ(after, -1);
+		EXPECT_THAT(folded(profiler, &symbols), testing::HasSubstr("\nroot;recurse;recurse "));
+	}
+}
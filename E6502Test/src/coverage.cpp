@@ -0,0 +1,158 @@
+#include <gmock/gmock.h>
+#include <stdio.h>
+#include <string>
+#include "types.h"
+#include "machine_test.h"
+#include "coverage.h"
+
+namespace E6502 {
+
+	class TestCoverage : public TestMachine {
+	public:
+		Coverage coverage;
+
+		virtual void SetUp() {
+			TestMachine::SetUp();
+			cpu->setCoverage(&coverage);
+
+			// Assembly/helloworld.lst, the JMP end at $1009 never runs
+			Byte program[] = {
+				INS_LDX_ZP.opcode, 0x00,				// $1000 LDX $00
+				INS_JSR.opcode, 0x0C, 0x10,				// $1002 JSR pushchar
+				INS_INX_IMP.opcode,						// $1005 INX
+				INS_JMP_ABS.opcode, 0x02, 0x10,			// $1006 JMP loop
+				INS_JMP_ABS.opcode, 0x09, 0x10,			// $1009 end: JMP end
+				INS_LDA_ABSX.opcode, 0x00, 0x11,		// $100C pushchar: LDA data,X
+				INS_STA_ZPX.opcode, 0x00,				// $100F STA $00,X
+				INS_RTS.opcode,							// $1011 RTS
+			};
+			memory->loadProgram(0x1000, program, sizeof(program));
+		}
+
+		/* Everything written to <file> */
+		static std::string contents(FILE* file) {
+			std::string text(ftell(file), ' ');
+			rewind(file);
+			EXPECT_EQ(fread(&text[0], 1, text.size(), file), text.size());
+			fclose(file);
+			return text;
+		}
+	};
+
+	/* Test the address and opcode bitmaps record what ran */
+	TEST_F(TestCoverage, TestRecord) {
+		// When: once round the loop
+		cpu->execute(7);
+
+		// Then:
+		Word ran[] = { 0x1000, 0x1002, 0x100C, 0x100F, 0x1011, 0x1005, 0x1006 };
+		for (Word address : ran)
+			EXPECT_TRUE(coverage.executed(address)) << address;
+		EXPECT_FALSE(coverage.executed(0x1001));
+		EXPECT_FALSE(coverage.executed(0x1009));
+		EXPECT_EQ(coverage.addressCount(), 7);
+		EXPECT_TRUE(coverage.opcodeExecuted(INS_JSR.opcode));
+		EXPECT_TRUE(coverage.opcodeExecuted(INS_STA_ZPX.opcode));
+		EXPECT_FALSE(coverage.opcodeExecuted(INS_NOP_IMP.opcode));
+		EXPECT_EQ(coverage.opcodeCount(), 7);
+
+		// When:
+		Coverage other;
+		other.record(0x1009, INS_NOP_IMP.opcode);
+		coverage.merge(other);
+
+		// Then:
+		EXPECT_TRUE(coverage.executed(0x1009));
+		EXPECT_TRUE(coverage.opcodeExecuted(INS_NOP_IMP.opcode));
+		EXPECT_EQ(coverage.addressCount(), 8);
+
+		// When:
+		coverage.clear();
+
+		// Then:
+		EXPECT_EQ(coverage.addressCount(), 0);
+		EXPECT_EQ(coverage.opcodeCount(), 0);
+	}
+
+	/* Test the listing is annotated with the instruction lines that ran and those that didn't */
+	TEST_F(TestCoverage, TestAnnotate) {
+		// Given:
+		std::string text =
+			"   4                   start\n"
+			"   5 1000 a6 00        \tldx $00\n"
+			"   6                   loop\n"
+			"   7 1002 20 0c 10     \tjsr pushchar\n"
+			"   9 1005 e8           \tinx\n"
+			"  10 1006 4c 02 10     \tJMP loop\n"
+			"  14 1009 4c 09 10     \tJMP end\n"
+			"  18 100c bd 00 11     \tlda\tdata,x\n"
+			"  19 100f 95 00        \tsta $00,x\n"
+			"  20 1011 60           \trts;\n"
+			"  25 1100 48 65 6c 6c  .byte 72, 101, 108, 108\n";
+		Listing listing;
+		listing.load(text.data(), text.size());
+		cpu->execute(20);
+
+		// When:
+		FILE* file = tmpfile();
+		ListingCoverage result = coverage.annotate(listing, file);
+		std::string annotated = contents(file);
+
+		// Then:
+		EXPECT_EQ(result.instructions, 8);
+		EXPECT_EQ(result.executed, 7);
+		EXPECT_EQ(annotated,
+			"; 7 of 8 instructions executed (87.5%)\n"
+			"     4                   start\n"
+			"+    5 1000 a6 00        \tldx $00\n"
+			"     6                   loop\n"
+			"+    7 1002 20 0c 10     \tjsr pushchar\n"
+			"+    9 1005 e8           \tinx\n"
+			"+   10 1006 4c 02 10     \tJMP loop\n"
+			"-   14 1009 4c 09 10     \tJMP end\n"
+			"+   18 100c bd 00 11     \tlda\tdata,x\n"
+			"+   19 100f 95 00        \tsta $00,x\n"
+			"+   20 1011 60           \trts;\n"
+			"    25 1100 48 65 6c 6c  .byte 72, 101, 108, 108\n");
+	}
+
+	/* Test instructions that ran outside the listing are listed after it */
+	TEST_F(TestCoverage, TestAnnotateUnlisted) {
+		// Given: a listing of only the first instruction
+		std::string text = "   5 1000 a6 00        \tldx $00\n";
+		Listing listing;
+		listing.load(text.data(), text.size());
+		cpu->execute(3);
+
+		// When:
+		FILE* file = tmpfile();
+		coverage.annotate(listing, file);
+		std::string annotated = contents(file);
+
+		// Then:
+		EXPECT_EQ(annotated,
+			"; 1 of 1 instructions executed (100.0%)\n"
+			"+    5 1000 a6 00        \tldx $00\n"
+			"; Ran outside the listing:\n"
+			"+ $1002\n"
+			"+ $100C\n");
+	}
+
+	/* Test the opcode matrix shows what ran in capitals and what didn't in lower case */
+	TEST_F(TestCoverage, TestOpcodeMatrix) {
+		// Given:
+		InstructionManager instructions(&InstructionUtils::loader);
+		cpu->execute(7);
+
+		// When:
+		FILE* file = tmpfile();
+		coverage.writeOpcodeMatrix(file, instructions);
+		std::string matrix = contents(file);
+
+		// Then: row 2- is JSR AND ... ... BIT AND ROL ... PLP AND ROL ... BIT AND ROL ...
+		EXPECT_THAT(matrix, testing::StartsWith("     -0  -1"));
+		EXPECT_THAT(matrix, testing::HasSubstr("\n2-  JSR and ... ... bit and rol ... plp and rol ... bit and rol ...\n"));
+		EXPECT_THAT(matrix, testing::HasSubstr("\n6-  RTS "));
+		EXPECT_THAT(matrix, testing::HasSubstr("\n7 of 136 implemented opcodes executed\n"));
+	}
+}
@@ -2,7 +2,9 @@
 #include <cstdlib>
 #include <gmock/gmock.h>
 #include "cpu.h"
+#include "decimal_table.h"
 #include "instructions/base.h"
+#include "instructions/instruction_utils.h"
 
 namespace E6502 {
 
@@ -10,12 +12,13 @@ namespace E6502 {
 		MOCK_METHOD(void, reset, ());
 	};
 
-	struct MockState : public CPUState {
-		MOCK_METHOD(void, reset, ());
-	};
-
 	struct MockLoader : public InstructionLoader {};
 
+	struct MockDevice : public Device {
+		MOCK_METHOD(Byte, read, (Word address));
+		MOCK_METHOD(void, write, (Word address, Byte value));
+	};
+
 	class TestCPU : public testing::Test {
 
 	public:
@@ -39,11 +42,12 @@ namespace E6502 {
 
 		/** returns a FlagUnion of the flags that would be expected after adding the provided operands */
 		FlagUnion getExpectedFlagsForBinaryADCOp(Byte operandA, Byte operandB, bool carryIn) {
-			Byte result = operandA + operandB + (carryIn ? 1 : 0);
+			Word sum = operandA + operandB + (carryIn ? 1 : 0);
+			Byte result = sum & 0xFF;
 			FlagUnion flagResult{ 0x00 };
-			if (result < operandB) flagResult.bit.C = 1;
+			if (sum > 0xFF) flagResult.bit.C = 1;
 			if (result == 0x00) flagResult.bit.Z = 1;
-			if (result >> 7 != operandA >> 7) flagResult.bit.V = 1;
+			if ((operandA >> 7) == (operandB >> 7) && (result >> 7) != (operandA >> 7)) flagResult.bit.V = 1;
 			flagResult.bit.N = result >> 7;
 			return flagResult;
 		}
@@ -78,14 +82,14 @@ namespace E6502 {
 						AL = (a & 0x0f) + (b & 0x0F) + carryIn;
 						if (AL > 0x09) AL = ((AL + 0x06) & 0x0F) + 0x10;
 						AL = ((a & 0xF0) + (b & 0x0F0)) + AL;
+						Byte unadjusted = AL & 0xFF;		// NMOS: N and V from the sum before the MSD is adjusted
 						if (AL > 0x99) AL = AL + 0x60;
 						expectResult = AL;
 						
-						// Flags
+						// Flags (Z stays as for the binary sum)
 						expectFlags.bit.C = AL > 0x99;
-						expectFlags.bit.V = (expectResult >> 7) != (a >> 7);
-						expectFlags.bit.Z = (expectResult == 0);
-						expectFlags.bit.N = (expectResult >> 7);
+						expectFlags.bit.V = ((a >> 7) == (b >> 7)) && ((unadjusted >> 7) != (a >> 7));
+						expectFlags.bit.N = (unadjusted >> 7);
 					}
 					
 					// Given:
@@ -95,12 +99,14 @@ namespace E6502 {
 					state->FLAGS.bit.C = carryIn;				// (Carry is special as it is used on both sides of the operation)
 					state->FLAGS.bit.D = decimal;
 					Byte cycles = 0;
+					cpu->loadState();
 
 
 					
 
 					// When:
 					cpu->addAccumulator(cycles, b);
+					cpu->syncState();
 
 					// Then:
 					// Check result
@@ -139,6 +145,60 @@ namespace E6502 {
 			}
 		}
 		
+		// Helper for subAccumulator instructions
+		void testSubAccumulator(bool decimal, bool carryIn) {
+			for (int a = 0x00; a < 0x100; a++) {
+				for (int b = 0x00; b < 0x100; b++) {
+					// Default to binary - subtraction is addition of the ones complement
+					Byte expectResult = a + (Byte)~b + carryIn;
+					FlagUnion expectFlags = getExpectedFlagsForBinaryADCOp(a, ~b, carryIn);
+
+					// Change values for decimal (NMOS: all the flags are the same as binary)
+					if (decimal) {
+						int AL = (a & 0x0F) - (b & 0x0F) + carryIn - 1;
+						if (AL < 0) AL = ((AL - 0x06) & 0x0F) - 0x10;
+						AL = (a & 0xF0) - (b & 0xF0) + AL;
+						if (AL < 0) AL = AL - 0x60;
+						expectResult = AL & 0xFF;
+					}
+
+					// Given:
+					state->A = a;
+					state->FLAGS.byte = ~expectFlags.byte;		// Ensures operation must change all the required flags
+					state->FLAGS.bit.C = carryIn;				// (Carry is special as it is used on both sides of the operation)
+					state->FLAGS.bit.D = decimal;
+					Byte cycles = 0;
+					cpu->loadState();
+
+					// When:
+					cpu->subAccumulator(cycles, b);
+					cpu->syncState();
+
+					// Then:
+					const char* mode = decimal ? "Decimal" : "Binary";
+					const char* carry = carryIn ? "1" : "0";
+					Byte flagMask = 0xC3;	// N, V, Z, C
+
+					if (state->A != expectResult) {
+						fprintf(stderr, "Invalid result in %s subAccumulator %X - %X - !%s, expected %X got %X\n", mode, a, b, carry, expectResult, state->A);
+						ASSERT_TRUE(false) << "Error testing subAccumulator, see stderr for details.";
+					}
+					if ((state->FLAGS.byte & flagMask) != (expectFlags.byte & flagMask)) {
+						fprintf(stderr, "Flags not set correctly in %s subAccumulator %X - %X - !%s = %X - Expected %X got %X\n", mode, a, b, carry, state->A, expectFlags.byte & flagMask, state->FLAGS.byte & flagMask);
+						ASSERT_TRUE(false) << "Error testing subAccumulator, see stderr for details.";
+					}
+					if (state->FLAGS.bit.D != decimal) {
+						fprintf(stderr, "Decimal flag changed in %s subAccumulator %X - %X - !%s\n", mode, a, b, carry);
+						ASSERT_TRUE(false) << "Error testing subAccumulator, see stderr for details.";
+					}
+					if (cycles != 0) {
+						fprintf(stderr, "Incorrect cycles used in %s subAccumulator %X - %X - !%s. Expected 0 got %d\n", mode, a, b, carry, cycles);
+						ASSERT_TRUE(false) << "Error testing subAccumulator, see stderr for details.";
+					}
+				}
+			}
+		}
+		
 		virtual void SetUp() {
 			cpu = new CPUInternal(state, memory, &loader);
 		}
@@ -152,18 +212,24 @@ namespace E6502 {
 	TEST_F(TestCPU, TestCPUReset) {
 		// Given:
 		MockMem* mMem = new MockMem;
-		MockState* mState = new MockState;
-		CPUInternal* testCPU = new CPUInternal(mState, mMem, &loader);
+		CPUState* testState = new CPUState;
+		CPUInternal* testCPU = new CPUInternal(testState, mMem, &loader);
+		testState->A = testState->X = testState->Y = 0x42;
+		testState->PC = 0x1234;
+		testState->SP = 0x42;
+		testState->FLAGS.byte = 0xFF;
 
 		// Memory is initialised
 		EXPECT_CALL(*mMem, reset()).Times(1);
-		EXPECT_CALL(*mState, reset()).Times(1);
 
 		// When:
 		testCPU->reset();
 
+		// Then: state is back to its initial values
+		EXPECT_EQ(*testState, CPUState());
+
 		delete mMem;
-		delete mState;
+		delete testState;
 		delete testCPU;
 
 	};
@@ -187,6 +253,393 @@ namespace E6502 {
 		EXPECT_EQ(cyclesExecuted, 2);				// NOP uses 2 cycles
 	};
 
+	/* Test execute keeps the cycle counter */
+	TEST_F(TestCPU, TestCPUExecuteCountsCycles) {
+		// Given:
+		cpu->reset();
+		(*memory)[0xFFFC] = INS_NOP_IMP.opcode;
+		(*memory)[0xFFFD] = INS_NOP_IMP.opcode;
+
+		// When:
+		cpu->execute(2);
+
+		// Then:
+		EXPECT_EQ(cpu->getCycles(), 4);
+	}
+
+	/* Test run uses at least the cycle budget and publishes registers on exit */
+	TEST_F(TestCPU, TestCPURunBudget) {
+		// Given:
+		cpu->reset();
+		state->PC = 0x1000;
+		for (Word i = 0x1000; i < 0x1100; i++)
+			(*memory)[i] = INS_NOP_IMP.opcode;
+
+		// When:
+		u8 reason = cpu->run(9);
+
+		// Then: 5 NOPs (2 cycles each) are needed to use 9 cycles
+		EXPECT_EQ(reason, CPUInternal::STOP_BUDGET);
+		EXPECT_EQ(state->PC, 0x1005);
+		EXPECT_EQ(cpu->getCycles(), 10);
+	}
+
+	/* Test run stops at a breakpoint and can resume from it */
+	TEST_F(TestCPU, TestCPURunBreakpoint) {
+		// Given:
+		cpu->reset();
+		state->PC = 0x1000;
+		for (Word i = 0x1000; i < 0x1100; i++)
+			(*memory)[i] = INS_NOP_IMP.opcode;
+		cpu->setBreakpoint(0x1003, true);
+
+		// When:
+		u8 reason = cpu->run(100);
+
+		// Then:
+		EXPECT_EQ(reason, CPUInternal::STOP_BREAKPOINT);
+		EXPECT_EQ(state->PC, 0x1003);
+		EXPECT_EQ(cpu->getCycles(), 6);
+
+		// When: run again without resuming
+		reason = cpu->run(4);
+
+		// Then: stopped before running anything
+		EXPECT_EQ(reason, CPUInternal::STOP_BREAKPOINT);
+		EXPECT_EQ(cpu->getCycles(), 6);
+
+		// When: resumed, the breakpoint is not hit again immediately
+		reason = cpu->run(4, true);
+
+		// Then:
+		EXPECT_EQ(reason, CPUInternal::STOP_BUDGET);
+		EXPECT_EQ(state->PC, 0x1005);
+
+		// When: disabled
+		cpu->setBreakpoint(0x1003, false);
+		state->PC = 0x1000;
+		reason = cpu->run(10);
+
+		// Then:
+		EXPECT_EQ(reason, CPUInternal::STOP_BUDGET);
+		EXPECT_EQ(state->PC, 0x1005);
+	}
+
+	/* Test run fast forwards a JMP to itself to the end of the budget with the same cycle count as running it */
+	TEST_F(TestCPU, TestCPURunIdleSkip) {
+		// Given:
+		CPUInternal idleCPU(state, memory, &InstructionUtils::loader);
+		idleCPU.reset();
+		state->PC = 0x1000;
+		(*memory)[0x1000] = INS_JMP_ABS.opcode;
+		(*memory)[0x1001] = 0x00;
+		(*memory)[0x1002] = 0x10;
+
+		// When:
+		u8 reason = idleCPU.run(1000);
+
+		// Then: 334 iterations of the 3 cycle loop
+		EXPECT_EQ(reason, CPUInternal::STOP_BUDGET);
+		EXPECT_EQ(state->PC, 0x1000);
+		EXPECT_EQ(idleCPU.getCycles(), 1002);
+
+		// When: detection is turned off the result is the same
+		idleCPU.setIdleMode(CPUInternal::IDLE_IGNORE);
+		idleCPU.run(1000);
+
+		// Then:
+		EXPECT_EQ(state->PC, 0x1000);
+		EXPECT_EQ(idleCPU.getCycles(), 2004);
+	}
+
+	/* Test a breakpoint on a jump to itself is reported rather than fast forwarded over */
+	TEST_F(TestCPU, TestCPURunIdleBreakpoint) {
+		// Given:
+		CPUInternal idleCPU(state, memory, &InstructionUtils::loader);
+		idleCPU.reset();
+		state->PC = 0x1000;
+		(*memory)[0x1000] = INS_NOP_IMP.opcode;
+		(*memory)[0x1001] = INS_JMP_ABS.opcode;		// $1001 trap: JMP trap
+		(*memory)[0x1002] = 0x01;
+		(*memory)[0x1003] = 0x10;
+		idleCPU.setBreakpoint(0x1001, true);
+
+		// When:
+		u8 reason = idleCPU.run(1000);
+
+		// Then: stopped before the JMP
+		EXPECT_EQ(reason, CPUInternal::STOP_BREAKPOINT);
+		EXPECT_EQ(state->PC, 0x1001);
+		EXPECT_EQ(idleCPU.getCycles(), 2);
+
+		// When: resumed from the trap
+		reason = idleCPU.run(1000, true);
+
+		// Then: reached again after one iteration
+		EXPECT_EQ(reason, CPUInternal::STOP_BREAKPOINT);
+		EXPECT_EQ(state->PC, 0x1001);
+		EXPECT_EQ(idleCPU.getCycles(), 5);
+	}
+
+	/* Test a budget too big to add to the cycle count runs until something stops it */
+	TEST_F(TestCPU, TestCPURunUnlimitedBudget) {
+		// Given:
+		CPUInternal runCPU(state, memory, &InstructionUtils::loader);
+		runCPU.reset();
+		state->PC = 0x1000;
+		(*memory)[0x1000] = INS_NOP_IMP.opcode;
+		(*memory)[0x1001] = INS_NOP_IMP.opcode;
+		(*memory)[0x1002] = INS_JMP_ABS.opcode;		// $1002 trap: JMP trap
+		(*memory)[0x1003] = 0x02;
+		(*memory)[0x1004] = 0x10;
+		runCPU.setBreakpoint(0x1002, true);
+		runCPU.run(2);
+
+		// When:
+		u8 reason = runCPU.run(~0ULL);
+
+		// Then:
+		EXPECT_EQ(reason, CPUInternal::STOP_BREAKPOINT);
+		EXPECT_EQ(state->PC, 0x1002);
+		EXPECT_EQ(runCPU.getCycles(), 4);
+	}
+
+	/* Test run stops on a branch to itself when halting is requested */
+	TEST_F(TestCPU, TestCPURunIdleHalt) {
+		// Given:
+		CPUInternal idleCPU(state, memory, &InstructionUtils::loader);
+		idleCPU.reset();
+		idleCPU.setIdleMode(CPUInternal::IDLE_HALT);
+		state->PC = 0x1000;
+		state->FLAGS.bit.Z = 0;
+		(*memory)[0x1000] = INS_BNE_REL.opcode;
+		(*memory)[0x1001] = 0xFE;	// Branch to self
+
+		// When:
+		u8 reason = idleCPU.run(1000);
+
+		// Then:
+		EXPECT_EQ(reason, CPUInternal::STOP_HALTED);
+		EXPECT_EQ(state->PC, 0x1000);
+		EXPECT_EQ(idleCPU.getCycles(), 3);
+	}
+
+	/* Test a branch to itself that is not taken is not treated as idle */
+	TEST_F(TestCPU, TestCPURunIdleBranchNotTaken) {
+		// Given:
+		CPUInternal idleCPU(state, memory, &InstructionUtils::loader);
+		idleCPU.reset();
+		idleCPU.setIdleMode(CPUInternal::IDLE_HALT);
+		state->PC = 0x1000;
+		state->FLAGS.bit.Z = 1;
+		(*memory)[0x1000] = INS_BNE_REL.opcode;
+		(*memory)[0x1001] = 0xFE;
+		for (Word i = 0x1002; i < 0x1010; i++)
+			(*memory)[i] = INS_NOP_IMP.opcode;
+
+		// When:
+		u8 reason = idleCPU.run(6);
+
+		// Then: the branch falls through to the NOPs
+		EXPECT_EQ(reason, CPUInternal::STOP_BUDGET);
+		EXPECT_EQ(state->PC, 0x1004);
+	}
+
+	/* Event that records when it fired and can optionally stop the run */
+	class RecordingEvent : public Event {
+	public:
+		CPUInternal* cpu;
+		bool stopRun;
+		std::vector<u64> fired;
+		std::vector<u64> cpuCycles;
+		RecordingEvent(CPUInternal* cpu, bool stopRun) : cpu(cpu), stopRun(stopRun) {}
+		virtual void fire(u64 now) {
+			fired.push_back(now);
+			cpuCycles.push_back(cpu->getCycles());
+			if (stopRun) cpu->stop(CPUInternal::STOP_EXIT);
+		}
+	};
+
+	/* Test scheduled events fire at the first instruction boundary after their deadline */
+	TEST_F(TestCPU, TestCPURunFiresEvents) {
+		// Given:
+		cpu->reset();
+		u64 start = cpu->getCycles();
+		state->PC = 0x1000;
+		for (Word i = 0x1000; i < 0x1100; i++)
+			(*memory)[i] = INS_NOP_IMP.opcode;
+		RecordingEvent first(cpu, false), second(cpu, false);
+		cpu->getScheduler().schedule(&second, start + 9);
+		cpu->getScheduler().schedule(&first, start + 4);
+
+		// When:
+		u8 reason = cpu->run(20);
+
+		// Then: NOPs use 2 cycles so the second event fires one cycle late
+		EXPECT_EQ(reason, CPUInternal::STOP_BUDGET);
+		ASSERT_EQ(first.fired.size(), 1);
+		ASSERT_EQ(second.fired.size(), 1);
+		EXPECT_EQ(first.fired[0], start + 4);
+		EXPECT_EQ(second.fired[0], start + 10);
+		EXPECT_EQ(second.cpuCycles[0], start + 10);
+		EXPECT_EQ(cpu->getScheduler().size(), 0);
+	}
+
+	/* Test an event can end a run */
+	TEST_F(TestCPU, TestCPURunEventStops) {
+		// Given:
+		cpu->reset();
+		u64 start = cpu->getCycles();
+		state->PC = 0x1000;
+		for (Word i = 0x1000; i < 0x1100; i++)
+			(*memory)[i] = INS_NOP_IMP.opcode;
+		RecordingEvent event(cpu, true);
+		cpu->getScheduler().schedule(&event, start + 6);
+
+		// When:
+		u8 reason = cpu->run(100);
+
+		// Then:
+		EXPECT_EQ(reason, CPUInternal::STOP_EXIT);
+		EXPECT_EQ(state->PC, 0x1003);
+		EXPECT_EQ(cpu->getCycles(), start + 6);
+	}
+
+	/* Test idle loops are only skipped up to the next event */
+	TEST_F(TestCPU, TestCPURunIdleSkipStopsAtEvent) {
+		// Given:
+		CPUInternal idleCPU(state, memory, &InstructionUtils::loader);
+		idleCPU.reset();
+		state->PC = 0x1000;
+		(*memory)[0x1000] = INS_JMP_ABS.opcode;
+		(*memory)[0x1001] = 0x00;
+		(*memory)[0x1002] = 0x10;
+		RecordingEvent event(&idleCPU, false);
+		idleCPU.getScheduler().schedule(&event, 500);
+
+		// When:
+		idleCPU.run(1000);
+
+		// Then: the event fires after the iteration that crosses cycle 500 (167 * 3 cycles)
+		ASSERT_EQ(event.fired.size(), 1);
+		EXPECT_EQ(event.fired[0], 501);
+		EXPECT_EQ(idleCPU.getCycles(), 1002);
+	}
+
+	/* Test events also fire from execute() */
+	TEST_F(TestCPU, TestCPUExecuteFiresEvents) {
+		// Given:
+		cpu->reset();
+		u64 start = cpu->getCycles();
+		state->PC = 0x1000;
+		for (Word i = 0x1000; i < 0x1100; i++)
+			(*memory)[i] = INS_NOP_IMP.opcode;
+		RecordingEvent event(cpu, false);
+		cpu->getScheduler().schedule(&event, start + 3);
+
+		// When:
+		cpu->execute(1);
+
+		// Then:
+		EXPECT_TRUE(event.fired.empty());
+
+		// When:
+		cpu->execute(1);
+
+		// Then:
+		ASSERT_EQ(event.fired.size(), 1);
+		EXPECT_EQ(event.fired[0], start + 4);
+	}
+
+	/* Test an asserted IRQ line is taken before the next instruction unless I is set */
+	TEST_F(TestCPU, TestCPUServiceIRQ) {
+		// Given:
+		cpu->reset();
+		state->PC = 0x1000;
+		state->FLAGS.byte = 0x27;	// I, Z and C set
+		for (Word i = 0x1000; i < 0x1100; i++)
+			(*memory)[i] = INS_NOP_IMP.opcode;
+		(*memory)[CPUInternal::IRQ_VECTOR] = 0x00;
+		(*memory)[CPUInternal::IRQ_VECTOR + 1] = 0x30;
+		(*memory)[0x3000] = INS_NOP_IMP.opcode;
+		cpu->setIRQ(5, true);
+
+		// When: masked
+		u8 cycles = cpu->execute(1);
+
+		// Then:
+		EXPECT_EQ(state->PC, 0x1001);
+		EXPECT_EQ(cycles, 2);
+
+		// When: unmasked
+		state->FLAGS.bit.I = 0;
+		cycles = cpu->execute(1);
+
+		// Then: PC and flags (B clear) are pushed and interrupts are disabled
+		EXPECT_EQ(cycles, 7);
+		EXPECT_EQ(state->PC, 0x3000);
+		EXPECT_EQ(state->SP, 0xFC);
+		EXPECT_EQ(state->FLAGS.bit.I, 1);
+		EXPECT_EQ((*memory)[0x1FD], 0x23);
+		EXPECT_EQ(((*memory)[0x1FE] << 8) | (*memory)[0x1FF], 0x1001);
+
+		// When: released
+		cpu->setIRQ(5, false);
+		state->FLAGS.bit.I = 0;
+		cpu->execute(1);
+
+		// Then:
+		EXPECT_EQ(state->PC, 0x3001);
+	}
+
+	/* Test guest writes to ROM are dropped, including read-modify-write instructions */
+	TEST_F(TestCPU, TestWriteProtectedPage) {
+		// Given:
+		CPUInternal romCPU(state, memory, &InstructionUtils::loader);
+		romCPU.reset();
+		state->PC = 0x1000;
+		state->A = 0x55;
+		Byte program[] = {
+			INS_STA_ABS.opcode, 0xFC, 0xFF,			// STA $FFFC
+			INS_INC_ABS.opcode, 0xFD, 0xFF,			// INC $FFFD
+			INS_STA_ABS.opcode, 0x00, 0x20,			// STA $2000
+		};
+		memory->loadProgram(0x1000, program, sizeof(program));
+		(*memory)[0xFFFC] = 0x00;
+		(*memory)[0xFFFD] = 0x10;
+		memory->setPageType(0xFF, Memory::PAGE_ROM);
+
+		// When:
+		romCPU.execute(3);
+
+		// Then:
+		EXPECT_EQ((*memory)[0xFFFC], 0x00);
+		EXPECT_EQ((*memory)[0xFFFD], 0x10);
+		EXPECT_EQ((*memory)[0x2000], 0x55);
+		memory->setPageType(0xFF, Memory::PAGE_RAM);
+	}
+
+	/* Test working registers are only published on request */
+	TEST_F(TestCPU, TestCPULoadSyncState) {
+		// Given:
+		u8 cycles = 0;
+		state->A = 0x42;
+		cpu->loadState();
+
+		// When:
+		cpu->saveToReg(cycles, CPU::REGISTER_A, 0x84);
+
+		// Then:
+		EXPECT_EQ(state->A, 0x42);
+		EXPECT_EQ(cpu->regValue(cycles, CPU::REGISTER_A), 0x84);
+
+		// When:
+		cpu->syncState();
+
+		// Then:
+		EXPECT_EQ(state->A, 0x84);
+	}
+
 	/* Test the readByte function */
 	TEST_F(TestCPU, TestMemReadByte) {
 		// Given:
@@ -238,6 +691,35 @@ namespace E6502 {
 		EXPECT_EQ((*memory)[address], data);
 	}
 
+	/* Test readByte, writeByte and readWord go to a mapped device */
+	TEST_F(TestCPU, TestMemDeviceAccess) {
+		// Given:
+		u8 cycles = 0;
+		MockDevice device;
+		memory->mapDevice(0xC0, &device);
+		(*memory)[0xC010] = 0x11;
+
+		// Then:
+		EXPECT_CALL(device, read(0xC010)).Times(1).WillOnce(testing::Return(0x42));
+		EXPECT_CALL(device, write(0xC011, 0x84)).Times(1);
+		EXPECT_CALL(device, read(0xC0FF)).Times(1).WillOnce(testing::Return(0x34));
+		EXPECT_CALL(device, read(0xC100)).Times(0);
+
+		// When:
+		Byte result = cpu->readByte(cycles, 0xC010);
+		cpu->writeByte(cycles, 0xC011, 0x84);
+		(*memory)[0xC100] = 0x12;
+		Word word = cpu->readWord(cycles, 0xC0FF);
+
+		// Then:
+		EXPECT_EQ(result, 0x42);
+		EXPECT_EQ(word, 0x1234);
+		EXPECT_EQ((*memory)[0xC010], 0x11);		// Memory under the device is untouched
+		EXPECT_EQ((*memory)[0xC011], 0x00);
+		EXPECT_EQ(cycles, 4);
+		memory->mapDevice(0xC0, nullptr);
+	}
+
 	/* Test fetching a byte from PC (With auto increment) */
 	TEST_F(TestCPU, TestreadPCByte) {
 		Word testStart = rand();
@@ -247,10 +729,12 @@ namespace E6502 {
 		state->PC = testStart;
 		u8 cycles = 0;
 		(*memory)[testStart] = 0x42;
+		cpu->loadState();
 
 
 		// When:
 		Byte value = cpu->readPCByte(cycles);
+		cpu->syncState();
 
 		// Then:
 		EXPECT_EQ(value, 0x42);
@@ -268,10 +752,12 @@ namespace E6502 {
 		u8 cycles = 0;
 		(*memory)[testStart] = 0x42;
 		(*memory)[testStart + 1] = 0x84;
+		cpu->loadState();
 
 
 		// When:
 		Word value = cpu->readPCWord(cycles);
+		cpu->syncState();
 
 		// Then:
 		EXPECT_EQ(value, 0x8442);
@@ -286,11 +772,13 @@ namespace E6502 {
 		Byte regX = 0x42;
 		Byte regY = 0x84;
 		u8 cycles = 0;
+		cpu->loadState();
 
 		// When:
 		cpu->saveToReg(cycles, CPU::REGISTER_A, regA);
 		cpu->saveToReg(cycles, CPU::REGISTER_X, regX);
 		cpu->saveToReg(cycles, CPU::REGISTER_Y, regY);
+		cpu->syncState();
 
 		// Then:
 		EXPECT_EQ(state->A, regA);
@@ -305,6 +793,7 @@ namespace E6502 {
 		state->X = 0x42;
 		state->Y = 0x84;
 		Byte cycles = 0;
+		cpu->loadState();
 
 		// When:
 		Byte a = cpu->regValue(cycles, CPU::REGISTER_A);
@@ -312,6 +801,7 @@ namespace E6502 {
 		Byte x = cpu->regValue(cycles, CPU::REGISTER_X);
 		EXPECT_EQ(cycles, 0);
 		Byte y = cpu->regValue(cycles, CPU::REGISTER_Y);
+		cpu->syncState();
 
 		// Then:
 		EXPECT_EQ(cycles, 0);
@@ -327,9 +817,11 @@ namespace E6502 {
 		Word initPC = rand();
 		state->PC = initPC;
 		u8 cycles = 0;
+		cpu->loadState();
 
 		// When:
 		Word value = cpu->getPC(cycles);
+		cpu->syncState();
 
 		// Then:
 		EXPECT_EQ(value, initPC);
@@ -344,9 +836,11 @@ namespace E6502 {
 		s8 offset = (rand() & 0x7F);	// Disable sign bit
 		Word expectPC = (state->PC + offset);
 		u8 cycles = 0;
+		cpu->loadState();
 
 		// When:
 		cpu->branch(cycles, offset);
+		cpu->syncState();
 
 		// Then:
 		EXPECT_EQ(state->PC, expectPC);
@@ -358,9 +852,11 @@ namespace E6502 {
 		s8 offset = (rand() | 0x80);	// enable sign bit
 		Word expectPC = (state->PC + offset);
 		u8 cycles = 0;
+		cpu->loadState();
 
 		// When:
 		cpu->branch(cycles, offset);
+		cpu->syncState();
 
 		// Then:
 		EXPECT_EQ(state->PC, expectPC);
@@ -373,9 +869,11 @@ namespace E6502 {
 		offset |= 0x10;					// Must be at least this big to cross boundary
 		Word expectPC = (state->PC + offset);
 		u8 cycles = 0;
+		cpu->loadState();
 
 		// When:
 		cpu->branch(cycles, offset);
+		cpu->syncState();
 
 		// Then:
 		EXPECT_EQ(state->PC, expectPC);
@@ -388,9 +886,11 @@ namespace E6502 {
 		offset &= 0x8F;					// Ensures it is negtive enough to cross tha page
 		Word expectPC = (state->PC + offset);
 		u8 cycles = 0;
+		cpu->loadState();
 
 		// When:
 		cpu->branch(cycles, offset);
+		cpu->syncState();
 
 		// Then:
 		EXPECT_EQ(state->PC, expectPC);
@@ -409,18 +909,22 @@ namespace E6502 {
 		(*memory)[state->SP] = ~testWord & 0xFF;
 		(*memory)[state->SP - 1] = ~testWord >> 8;
 		cycles = 0;
+		cpu->loadState();
 
 		// When
 		cpu->pushStackWord(cycles, testWord);
+		cpu->syncState();
 
 		// Then:
 		EXPECT_EQ(cycles, 2);
 		EXPECT_EQ(state->SP, initialSP - 2);
 		EXPECT_EQ((*memory)[0x0100 | initialSP], testWord & 0xFF);
 		EXPECT_EQ((*memory)[0x0100 | initialSP - 1], testWord >> 8);
+		cpu->loadState();
 
 		// When
 		Word result = cpu->pullStackWord(cycles);
+		cpu->syncState();
 
 		// Then:
 		EXPECT_EQ(cycles, 4);
@@ -433,9 +937,11 @@ namespace E6502 {
 		// Given:
 		state->PC = 0x1234;
 		u8 cycles = 0;
+		cpu->loadState();
 
 		// When:
 		cpu->setPC(cycles, 0x9876);
+		cpu->syncState();
 
 		// Then:
 		EXPECT_EQ(state->PC, 0x9876);
@@ -449,10 +955,12 @@ namespace E6502 {
 		FlagUnion testValue = FlagUnion();
 
 		for (u16 i = 0x00; i <= 0x100; i++) {
+			cpu->loadState();
 			// When:
 			Byte cycles = 0;
 			testValue.byte = (Byte)i;
 			cpu->setFlags(cycles, testValue);
+			cpu->syncState();
 
 			// Then:
 			EXPECT_EQ(cycles, 1);
@@ -472,9 +980,11 @@ namespace E6502 {
 
 		state->SP = initialSP;
 		(*memory)[0x0100 | initialSP + 1] = testValue;
+		cpu->loadState();
 
 		// When:
 		Byte result = cpu->pullStackByte(cycles);
+		cpu->syncState();
 
 		// Then:
 		EXPECT_EQ(state->SP, (initialSP + 1) & 0x00FF);
@@ -491,9 +1001,11 @@ namespace E6502 {
 
 		state->SP = initialSP;
 		(*memory)[0x0100 | initialSP] = ~testValue;
+		cpu->loadState();
 
 		// When:
 		cpu->pushStackByte(cycles, testValue);
+		cpu->syncState();
 
 		// Then:
 		EXPECT_EQ(state->SP, initialSP - 1);
@@ -507,9 +1019,11 @@ namespace E6502 {
 		Byte cycles = 0;
 		Byte testValue = rand();
 		state->SP = testValue;
+		cpu->loadState();
 
 		// When:
 		Byte result = cpu->getSP(cycles);
+		cpu->syncState();
 
 		// Then:
 		EXPECT_EQ(result, testValue);
@@ -523,9 +1037,11 @@ namespace E6502 {
 		Byte cycles = 0;
 		Byte testValue = rand();
 		state->SP = ~testValue;
+		cpu->loadState();
 
 		// When:
 		cpu->setSP(cycles, testValue);
+		cpu->syncState();
 
 		// Then:
 		EXPECT_EQ(state->SP, testValue);
@@ -590,9 +1106,11 @@ namespace E6502 {
 			Byte testValue = rand();
 			*registerRef[i] = testValue;
 			Byte cycles = 0;
+			cpu->loadState();
 
 			// When:
 			Byte result = cpu->readReferenceByte(cycles, ref);
+			cpu->syncState();
 
 			// Then:
 			EXPECT_EQ(cycles, 0);
@@ -611,9 +1129,11 @@ namespace E6502 {
 			Byte testValue = rand();
 			*registerRef[i] = ~testValue;
 			Byte cycles = 0;
+			cpu->loadState();
 
 			// When:
 			cpu->writeReferenceByte(cycles, ref, testValue);
+			cpu->syncState();
 
 			// Then:
 			EXPECT_EQ(cycles, 0);
@@ -661,10 +1181,53 @@ namespace E6502 {
 	TEST_F(TestCPU, testAddAccumulatorDecimalNoCarryIn) { testAddAccumulator(true, false); }
 	TEST_F(TestCPU, testAddAccumulatorDecimalWithCarryIn) { testAddAccumulator(true, true); }
 		
-	/* Test the sub accumulator function 
-	TEST_F(TestCPU, testSubAccumulatorBinaryNoCarryIn) { EXPECT_TRUE(false); }	// TODO
-	TEST_F(TestCPU, testSubAccumulatorBinaryWithCarryIn) { EXPECT_TRUE(false); }	// TODO
-	TEST_F(TestCPU, testSubAccumulatorDecimalNoCarryIn) { EXPECT_TRUE(false);  }	// TODO
-	TEST_F(TestCPU, testSubAccumulatorDecimalWithCarryIn) { EXPECT_TRUE(false); }	// TODO
-	*/
+	/* Test the sub accumulator function */
+	TEST_F(TestCPU, testSubAccumulatorBinaryNoCarryIn) { testSubAccumulator(false, false); }
+	TEST_F(TestCPU, testSubAccumulatorBinaryWithCarryIn) { testSubAccumulator(false, true); }
+	TEST_F(TestCPU, testSubAccumulatorDecimalNoCarryIn) { testSubAccumulator(true, false); }
+	TEST_F(TestCPU, testSubAccumulatorDecimalWithCarryIn) { testSubAccumulator(true, true); }
+
+	/* Test decimal ADC and SBC against results from an NMOS 6502 */
+	TEST_F(TestCPU, testDecimalKnownAnswers) {
+		struct Vector {
+			bool add;
+			Byte a, b;
+			bool carry;
+			Byte result;
+			Byte flags;		// N, V, Z and C after the operation
+		};
+		const Byte N = 0x80, V = 0x40, Z = 0x02, C = 0x01;
+		const Vector vectors[] = {
+			{ true,  0x09, 0x01, false, 0x10, 0 },
+			{ true,  0x58, 0x46, true,  0x05, N | V | C },		// N and V from $A5 before the MSD is adjusted
+			{ true,  0x99, 0x01, false, 0x00, N | C },			// Z from the binary sum $9A
+			{ true,  0x50, 0x50, false, 0x00, N | V | C },
+			{ true,  0x00, 0x00, false, 0x00, Z },
+			{ true,  0x79, 0x00, true,  0x80, N | V },
+			{ false, 0x00, 0x01, true,  0x99, N },				// Flags from the binary $FF
+			{ false, 0x00, 0x01, false, 0x98, N },
+			{ false, 0x01, 0x01, true,  0x00, Z | C },
+			{ false, 0x80, 0x01, true,  0x79, V | C },
+			{ false, 0x21, 0x34, true,  0x87, N },
+		};
+
+		cpu->reset();
+		for (const Vector& vector : vectors) {
+			// Given:
+			state->A = vector.a;
+			state->FLAGS.byte = 0x08 | (vector.carry ? C : 0);
+			u8 cycles = 0;
+			cpu->loadState();
+
+			// When:
+			if (vector.add) cpu->addAccumulator(cycles, vector.b);
+			else cpu->subAccumulator(cycles, vector.b);
+			cpu->syncState();
+
+			// Then:
+			const char* op = vector.add ? "ADC" : "SBC";
+			EXPECT_EQ(state->A, vector.result) << op << " " << (int)vector.a << " " << (int)vector.b << " " << vector.carry;
+			EXPECT_EQ(state->FLAGS.byte & DecimalTable::FLAG_MASK, vector.flags) << op << " " << (int)vector.a << " " << (int)vector.b << " " << vector.carry;
+		}
+	}
 }
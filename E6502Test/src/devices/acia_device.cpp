@@ -0,0 +1,233 @@
+#include <gmock/gmock.h>
+#include <thread>
+#include <atomic>
+#include "types.h"
+#include "../machine_test.h"
+#include "devices/acia_device.h"
+
+namespace E6502 {
+
+	class TestAciaDevice : public TestMachine {
+	public:
+		const Byte page = 0xFB;
+		const Word base = 0xFB00;
+
+		AciaDevice* acia = nullptr;
+
+		virtual void SetUp() {
+			TestMachine::SetUp();
+			acia = new AciaDevice(cpu, 1, 16);
+			memory->mapDevice(page, acia);
+		}
+
+		virtual void TearDown() {
+			delete acia;
+			TestMachine::TearDown();
+		}
+
+		Byte status() { return acia->read(base + AciaDevice::REG_STATUS); }
+	};
+
+	/* Test status bits follow the buffers */
+	TEST_F(TestAciaDevice, TestStatus) {
+		// Then: nothing received and room to transmit
+		EXPECT_EQ(status(), AciaDevice::STATUS_TX_EMPTY);
+
+		// When:
+		EXPECT_TRUE(acia->hostSend('A'));
+
+		// Then:
+		EXPECT_EQ(status(), AciaDevice::STATUS_TX_EMPTY | AciaDevice::STATUS_RX_FULL);
+
+		// When:
+		Byte value = acia->read(base + AciaDevice::REG_DATA);
+
+		// Then: reading again without new data gives the same byte
+		EXPECT_EQ(value, 'A');
+		EXPECT_EQ(status(), AciaDevice::STATUS_TX_EMPTY);
+		EXPECT_EQ(acia->read(base + AciaDevice::REG_DATA), 'A');
+
+		// When: the transmit buffer fills
+		for (int i = 0; i < 16; i++)
+			acia->write(base + AciaDevice::REG_DATA, i);
+
+		// Then:
+		EXPECT_EQ(status(), 0x00);
+	}
+
+	/* Test transmitted bytes reach the host in order */
+	TEST_F(TestAciaDevice, TestTransmit) {
+		// When:
+		acia->write(base + AciaDevice::REG_DATA, 'O');
+		acia->write(base + AciaDevice::REG_DATA, 'K');
+
+		// Then:
+		Byte value;
+		ASSERT_TRUE(acia->hostReceive(value));
+		EXPECT_EQ(value, 'O');
+		ASSERT_TRUE(acia->hostReceive(value));
+		EXPECT_EQ(value, 'K');
+		EXPECT_FALSE(acia->hostReceive(value));
+	}
+
+	/* Test command / control registers and a programmed reset */
+	TEST_F(TestAciaDevice, TestRegisters) {
+		// When:
+		acia->write(base + AciaDevice::REG_COMMAND, 0xEB);
+		acia->write(base + AciaDevice::REG_CONTROL, 0x1F);
+
+		// Then:
+		EXPECT_EQ(acia->read(base + AciaDevice::REG_COMMAND), 0xEB);
+		EXPECT_EQ(acia->read(base + AciaDevice::REG_CONTROL), 0x1F);
+
+		// When:
+		acia->write(base + AciaDevice::REG_STATUS, 0x00);
+
+		// Then:
+		EXPECT_EQ(acia->read(base + AciaDevice::REG_COMMAND), 0xE0);
+		EXPECT_EQ(acia->read(base + AciaDevice::REG_CONTROL), 0x1F);
+	}
+
+	/* Test a host thread can talk to a guest echo loop while the CPU runs */
+	TEST_F(TestAciaDevice, TestHostThreadEcho) {
+		// Given:
+		Byte program[] = {
+			INS_LDA_ABS.opcode, 0x01, 0xFB,				// loop: LDA STATUS
+			INS_AND_IMM.opcode, AciaDevice::STATUS_RX_FULL,
+			INS_BEQ_REL.opcode, 0xF9,					// BEQ loop
+			INS_LDA_ABS.opcode, 0x00, 0xFB,				// LDA DATA
+			INS_STA_ABS.opcode, 0x00, 0xFB,				// STA DATA
+			INS_JMP_ABS.opcode, 0x00, 0x10,				// JMP loop
+		};
+		memory->loadProgram(0x1000, program, sizeof(program));
+		const std::string message = "The quick brown fox jumps over the lazy dog";
+		std::string echoed;
+		std::atomic<bool> done{ false };
+
+		// When:
+		std::thread host([&] {
+			size_t sent = 0;
+			while (echoed.size() < message.size()) {
+				if (sent < message.size() && acia->hostSend(message[sent])) sent++;
+				Byte value;
+				if (acia->hostReceive(value)) echoed += (char)value;
+				else std::this_thread::yield();
+			}
+			done = true;
+		});
+		for (int slice = 0; slice < 1000000 && !done; slice++)
+			cpu->run(1000);
+		host.join();
+
+		// Then:
+		EXPECT_EQ(echoed, message);
+	}
+
+	/* Test a received byte raises an IRQ the guest can service */
+	TEST_F(TestAciaDevice, TestReceiveInterrupt) {
+		// Given:
+		Byte program[] = {
+			INS_LDA_IMM.opcode, AciaDevice::COMMAND_DTR,
+			INS_STA_ABS.opcode, 0x02, 0xFB,				// STA COMMAND - receive IRQ enabled
+			INS_CLI_IMP.opcode,
+			INS_JMP_ABS.opcode, 0x06, 0x10,				// wait: JMP wait
+		};
+		Byte handler[] = {
+			INS_LDA_ABS.opcode, 0x00, 0xFB,				// LDA DATA
+			INS_STA_ZP.opcode, 0x10,
+			INS_INC_ZP0.opcode, 0x11,
+			INS_RTI.opcode,
+		};
+		memory->loadProgram(0x1000, program, sizeof(program));
+		memory->loadProgram(0x2000, handler, sizeof(handler));
+		(*memory)[CPUInternal::IRQ_VECTOR] = 0x00;
+		(*memory)[CPUInternal::IRQ_VECTOR + 1] = 0x20;
+
+		// When: nothing is sent
+		cpu->run(5000);
+
+		// Then:
+		EXPECT_EQ((*memory)[0x11], 0);
+
+		// When:
+		acia->hostSend('Z');
+		cpu->run(5000);
+
+		// Then: one interrupt, within a character time (87 cycles at the default rate)
+		EXPECT_EQ((*memory)[0x10], 'Z');
+		EXPECT_EQ((*memory)[0x11], 1);
+		EXPECT_EQ(status() & AciaDevice::STATUS_IRQ, 0x00);
+	}
+
+	/* Test the host draining a full transmit buffer raises the transmit IRQ again */
+	TEST_F(TestAciaDevice, TestTransmitInterrupt) {
+		// Given:
+		Byte program[] = {
+			INS_LDA_IMM.opcode, AciaDevice::COMMAND_DTR | AciaDevice::COMMAND_RX_IRQ_DISABLE | AciaDevice::COMMAND_TX_IRQ,
+			INS_STA_ABS.opcode, 0x02, 0xFB,				// STA COMMAND - transmit IRQ only
+			INS_CLI_IMP.opcode,
+			INS_JMP_ABS.opcode, 0x06, 0x10,				// wait: JMP wait
+		};
+		Byte handler[] = {
+			INS_LDA_IMM.opcode, 'T',
+			INS_STA_ABS.opcode, 0x00, 0xFB,				// STA DATA
+			INS_INC_ZP0.opcode, 0x11,
+			INS_RTI.opcode,
+		};
+		memory->loadProgram(0x1000, program, sizeof(program));
+		memory->loadProgram(0x2000, handler, sizeof(handler));
+		(*memory)[CPUInternal::IRQ_VECTOR] = 0x00;
+		(*memory)[CPUInternal::IRQ_VECTOR + 1] = 0x20;
+		FILE* out = tmpfile();
+
+		// When: the guest transmits until the buffer is full
+		cpu->run(5000);
+		Byte sent = (*memory)[0x11];
+
+		// Then: the IRQ drops and stays down
+		EXPECT_GT(sent, 0);
+		EXPECT_EQ(status() & (AciaDevice::STATUS_TX_EMPTY | AciaDevice::STATUS_IRQ), 0x00);
+		cpu->run(5000);
+		EXPECT_EQ((*memory)[0x11], sent);
+
+		// When: the host makes room
+		EXPECT_EQ(acia->drain(out), sent);
+		cpu->run(5000);
+
+		// Then: the guest is interrupted to fill it again
+		EXPECT_EQ((*memory)[0x11], 2 * sent);
+
+		fclose(out);
+	}
+
+	/* Test feeding from and draining to files */
+	TEST_F(TestAciaDevice, TestFeedDrain) {
+		// Given:
+		FILE* in = tmpfile();
+		FILE* out = tmpfile();
+		fputs("0123456789ABCDEFGHIJ", in);
+		rewind(in);
+
+		// When: only 16 bytes fit
+		size_t fed = acia->feed(in);
+
+		// Then:
+		EXPECT_EQ(fed, 16);
+
+		// When: the guest sends everything it received back
+		for (int i = 0; i < 16; i++)
+			acia->write(base + AciaDevice::REG_DATA, acia->read(base + AciaDevice::REG_DATA));
+		size_t drained = acia->drain(out);
+
+		// Then:
+		EXPECT_EQ(drained, 16);
+		EXPECT_EQ(acia->feed(in), 4);
+		rewind(out);
+		char text[32] = {};
+		fgets(text, sizeof(text), out);
+		EXPECT_STREQ(text, "0123456789ABCDEF");
+
+		fclose(in);
+		fclose(out);
+	}
+}
@@ -0,0 +1,139 @@
+#include <gmock/gmock.h>
+#include "types.h"
+#include "../machine_test.h"
+#include "devices/console_device.h"
+
+namespace E6502 {
+
+	class TestConsoleDevice : public TestMachine {
+	public:
+		const Byte page = 0xFD;
+		const Word base = 0xFD00;
+
+		FILE* output = nullptr;
+
+		virtual void SetUp() {
+			TestMachine::SetUp();
+			output = tmpfile();
+		}
+
+		virtual void TearDown() {
+			TestMachine::TearDown();
+			fclose(output);
+		}
+
+		/* Returns everything that has reached the output file */
+		std::string readOutput() {
+			long position = ftell(output);
+			rewind(output);
+			std::string result;
+			int c;
+			while ((c = fgetc(output)) != EOF) result += (char)c;
+			fseek(output, position, SEEK_SET);
+			return result;
+		}
+
+		/* Writes a string to the DATA register */
+		void writeString(ConsoleDevice& device, const char* text) {
+			for (int i = 0; text[i] != 0; i++)
+				device.write(base + ConsoleDevice::REG_DATA, text[i]);
+		}
+	};
+
+	/* Test output is held until the buffer fills or is flushed */
+	TEST_F(TestConsoleDevice, TestBuffering) {
+		// Given:
+		ConsoleDevice device(output, 8, false);
+
+		// When:
+		writeString(device, "Hello");
+
+		// Then: nothing has been written yet
+		EXPECT_EQ(readOutput(), "");
+
+		// When: the buffer fills
+		writeString(device, ", World");
+
+		// Then: the first full buffer has been written
+		EXPECT_EQ(readOutput(), "Hello, W");
+
+		// When:
+		device.write(base + ConsoleDevice::REG_FLUSH, 0x00);
+
+		// Then:
+		EXPECT_EQ(readOutput(), "Hello, World");
+	}
+
+	/* Test the background writer delivers every character in order */
+	TEST_F(TestConsoleDevice, TestBackgroundWriter) {
+		// Given:
+		ConsoleDevice device(output, 16, true);
+		std::string expected;
+		for (int i = 0; i < 1000; i++)
+			expected += (char)('A' + (i % 26));
+
+		// When:
+		writeString(device, expected.c_str());
+		device.flush();
+
+		// Then:
+		EXPECT_EQ(readOutput(), expected);
+	}
+
+	/* Test output still buffered when the device is destroyed is written */
+	TEST_F(TestConsoleDevice, TestFlushOnDestroy) {
+		// Given:
+		{
+			ConsoleDevice device(output, 4096, true);
+			writeString(device, "Bye");
+		}
+
+		// Then:
+		EXPECT_EQ(readOutput(), "Bye");
+	}
+
+	/* Test STATUS always reports ready and other registers read as zero */
+	TEST_F(TestConsoleDevice, TestStatus) {
+		// Given:
+		ConsoleDevice device(output, 16, false);
+
+		// Then:
+		EXPECT_EQ(device.read(base + ConsoleDevice::REG_STATUS), ConsoleDevice::STATUS_READY);
+		EXPECT_EQ(device.read(base + ConsoleDevice::REG_DATA), 0x00);
+	}
+
+	/* Test guest output is flushed when run() stops short of its budget */
+	TEST_F(TestConsoleDevice, TestFlushOnRunExit) {
+		// Given:
+		ConsoleDevice device(output, 4096, true);
+		memory->mapDevice(page, &device);
+		Byte program[] = {
+			INS_LDX_IMM.opcode, 0x00,
+			INS_LDA_ABSX.opcode, 0x00, 0x20,				// loop: LDA text,X
+			INS_BEQ_REL.opcode, 0x07,						// BEQ done
+			INS_STA_ABS.opcode, 0x00, 0xFD,				// STA DATA
+			INS_INX_IMP.opcode,
+			INS_JMP_ABS.opcode, 0x02, 0x10,				// JMP loop
+			INS_JMP_ABS.opcode, 0x0E, 0x10,				// done: JMP done
+		};
+		memory->loadProgram(0x1000, program, sizeof(program));
+		const char* text = "Hi there";
+		for (int i = 0; i <= 8; i++)
+			(*memory)[0x2000 + i] = text[i];
+
+		// When: the budget runs out in the idle loop
+		u8 reason = cpu->run(1000);
+
+		// Then: still buffered, as the run may only be one slice
+		EXPECT_EQ(reason, CPUInternal::STOP_BUDGET);
+		EXPECT_EQ(readOutput(), "");
+
+		// When: the idle loop stops the run
+		cpu->setIdleMode(CPUInternal::IDLE_HALT);
+		reason = cpu->run(1000);
+
+		// Then:
+		EXPECT_EQ(reason, CPUInternal::STOP_HALTED);
+		EXPECT_EQ(readOutput(), "Hi there");
+	}
+}
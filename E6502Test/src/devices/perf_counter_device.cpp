@@ -0,0 +1,126 @@
+#include <gmock/gmock.h>
+#include "types.h"
+#include "../machine_test.h"
+#include "devices/perf_counter_device.h"
+
+namespace E6502 {
+
+	class TestPerfCounterDevice : public TestMachine {
+	public:
+		const Byte page = 0xFD;
+		const Word base = 0xFD00;
+
+		PerfCounterDevice* device = nullptr;
+
+		virtual void SetUp() {
+			TestMachine::SetUp();
+			device = new PerfCounterDevice(cpu);
+			memory->mapDevice(page, device);
+		}
+
+		virtual void TearDown() {
+			delete device;
+			TestMachine::TearDown();
+		}
+
+		/* Reads the 8 byte counter at <reg> low byte first, as a guest would */
+		u64 readCounter(Byte reg) {
+			u64 value = 0;
+			for (int i = 0; i < 8; i++)
+				value |= (u64)device->read(base + reg + i) << (i * 8);
+			return value;
+		}
+	};
+
+	/* Test a guest can time a loop with the stopwatch */
+	TEST_F(TestPerfCounterDevice, TestGuestStopwatch) {
+		// Given:
+		Byte program[] = {
+			INS_LDA_IMM.opcode, PerfCounterDevice::STOPWATCH_START,
+			INS_STA_ABS.opcode, 0x18, 0xFD,				// $1002 STA CONTROL
+			INS_LDX_IMM.opcode, 0x05,					// $1005 LDX #5
+			INS_DEX_IMP.opcode,							// $1007 loop: DEX
+			INS_BNE_REL.opcode, 0xFD,					// $1008 BNE loop
+			INS_LDA_IMM.opcode, PerfCounterDevice::STOPWATCH_STOP,
+			INS_STA_ABS.opcode, 0x18, 0xFD,				// $100C STA CONTROL
+			INS_LDA_ABS.opcode, 0x10, 0xFD,				// $100F LDA STOPWATCH (latches)
+			INS_STA_ABS.opcode, 0x00, 0x02,
+			INS_LDA_ABS.opcode, 0x11, 0xFD,
+			INS_STA_ABS.opcode, 0x01, 0x02,
+			INS_LDA_ABS.opcode, 0x18, 0xFD,				// $101B LDA CONTROL
+			INS_STA_ABS.opcode, 0x02, 0x02,
+			INS_JMP_ABS.opcode, 0x21, 0x10,				// $1021 JMP $1021
+		};
+		memory->loadProgram(0x1000, program, sizeof(program));
+
+		// When:
+		cpu->run(1000);
+
+		// Then: STA + LDX + 5 DEX + 4 taken BNE + 1 not taken + LDA
+		u16 elapsed = (*memory)[0x0200] | ((*memory)[0x0201] << 8);
+		EXPECT_EQ(elapsed, 4 + 2 + 5 * 2 + 4 * 3 + 2 + 2);
+		EXPECT_EQ((*memory)[0x0202], 0);
+		EXPECT_EQ(device->stopwatchCycles(), elapsed);
+	}
+
+	/* Test the cycle counter is latched when its first byte is read */
+	TEST_F(TestPerfCounterDevice, TestCycleLatch) {
+		// Given:
+		cpu->setCycles(0x0123456789ABCDEF);
+
+		// When:
+		Byte low = device->read(base + PerfCounterDevice::REG_CYCLES);
+		cpu->setCycles(0);
+		u64 rest = 0;
+		for (int i = 1; i < 8; i++)
+			rest |= (u64)device->read(base + PerfCounterDevice::REG_CYCLES + i) << (i * 8);
+
+		// Then:
+		EXPECT_EQ(low | rest, 0x0123456789ABCDEF);
+		EXPECT_EQ(readCounter(PerfCounterDevice::REG_CYCLES), 0);
+	}
+
+	/* Test the stopwatch stops, resumes and restarts */
+	TEST_F(TestPerfCounterDevice, TestStopResume) {
+		// When:
+		cpu->setCycles(100);
+		device->write(base + PerfCounterDevice::REG_CONTROL, PerfCounterDevice::STOPWATCH_START);
+		cpu->setCycles(150);
+		u64 running = readCounter(PerfCounterDevice::REG_STOPWATCH);
+		device->write(base + PerfCounterDevice::REG_CONTROL, PerfCounterDevice::STOPWATCH_STOP);
+		cpu->setCycles(1000);
+		u64 stopped = readCounter(PerfCounterDevice::REG_STOPWATCH);
+		Byte control = device->read(base + PerfCounterDevice::REG_CONTROL);
+		device->write(base + PerfCounterDevice::REG_CONTROL, PerfCounterDevice::STOPWATCH_RESUME);
+		cpu->setCycles(1025);
+		u64 resumed = readCounter(PerfCounterDevice::REG_STOPWATCH);
+		device->write(base + PerfCounterDevice::REG_CONTROL, PerfCounterDevice::STOPWATCH_START);
+		cpu->setCycles(1030);
+		u64 restarted = readCounter(PerfCounterDevice::REG_STOPWATCH);
+
+		// Then:
+		EXPECT_EQ(running, 50);
+		EXPECT_EQ(stopped, 50);
+		EXPECT_EQ(control, 0);
+		EXPECT_EQ(resumed, 75);
+		EXPECT_EQ(restarted, 5);
+		EXPECT_EQ(device->read(base + PerfCounterDevice::REG_CONTROL), 1);
+	}
+
+	/* Test instructions retired come from the CPU's counters when they are built in */
+	TEST_F(TestPerfCounterDevice, TestInstructions) {
+		// Given:
+		Byte program[] = { INS_NOP_IMP.opcode, INS_NOP_IMP.opcode, INS_NOP_IMP.opcode };
+		memory->loadProgram(0x1000, program, sizeof(program));
+
+		// When:
+		cpu->execute(3);
+
+		// Then:
+#ifdef E6502_PERF_COUNTERS
+		EXPECT_EQ(readCounter(PerfCounterDevice::REG_INSTRUCTIONS), 3);
+#else
+		EXPECT_EQ(readCounter(PerfCounterDevice::REG_INSTRUCTIONS), 0);
+#endif
+	}
+}
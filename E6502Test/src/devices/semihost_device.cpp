@@ -0,0 +1,126 @@
+#include <gmock/gmock.h>
+#include "types.h"
+#include "../machine_test.h"
+#include "devices/semihost_device.h"
+
+namespace E6502 {
+
+	class TestSemihostDevice : public TestMachine {
+	public:
+		const Byte page = 0xFE;
+		const Word base = 0xFE00;
+
+		SemihostDevice* device = nullptr;
+		FILE* output = nullptr;
+
+		virtual void SetUp() {
+			TestMachine::SetUp();
+			output = tmpfile();
+			device = new SemihostDevice(cpu, memory, output);
+			memory->mapDevice(page, device);
+		}
+
+		virtual void TearDown() {
+			delete device;
+			TestMachine::TearDown();
+			fclose(output);
+		}
+
+		/* Returns everything the device has written so far */
+		std::string readOutput() {
+			fflush(output);
+			rewind(output);
+			std::string result;
+			int c;
+			while ((c = fgetc(output)) != EOF) result += (char)c;
+			return result;
+		}
+	};
+
+	/* Test a guest write to EXIT ends the run with the exit code */
+	TEST_F(TestSemihostDevice, TestExit) {
+		// Given:
+		Byte program[] = {
+			INS_LDA_IMM.opcode, 0x2A,
+			INS_STA_ABS.opcode, 0x00, 0xFE,				// STA EXIT
+			INS_JMP_ABS.opcode, 0x00, 0x10,				// Never reached
+		};
+		memory->loadProgram(0x1000, program, sizeof(program));
+
+		// When:
+		u8 reason = cpu->run(1000000);
+
+		// Then:
+		EXPECT_EQ(reason, CPUInternal::STOP_EXIT);
+		EXPECT_TRUE(device->hasExited());
+		EXPECT_EQ(device->getExitCode(), 0x2A);
+		EXPECT_EQ(state->PC, 0x1005);
+		EXPECT_EQ(cpu->getCycles(), 6);
+	}
+
+	/* Test characters written to PUTC reach the host */
+	TEST_F(TestSemihostDevice, TestPutc) {
+		// When:
+		device->write(base + SemihostDevice::REG_PUTC, 'H');
+		device->write(base + SemihostDevice::REG_PUTC, 'i');
+
+		// Then:
+		EXPECT_EQ(readOutput(), "Hi");
+		EXPECT_FALSE(device->hasExited());
+	}
+
+	/* Test buffers are written with a length or up to a zero byte */
+	TEST_F(TestSemihostDevice, TestWriteBuffer) {
+		// Given:
+		const char* text = "Hello, World!";
+		for (int i = 0; text[i] != 0; i++)
+			(*memory)[0x2000 + i] = text[i];
+		device->write(base + SemihostDevice::REG_PTR_LO, 0x00);
+		device->write(base + SemihostDevice::REG_PTR_HI, 0x20);
+
+		// Then: the pointer reads back
+		EXPECT_EQ(device->read(base + SemihostDevice::REG_PTR_LO), 0x00);
+		EXPECT_EQ(device->read(base + SemihostDevice::REG_PTR_HI), 0x20);
+
+		// When:
+		device->write(base + SemihostDevice::REG_WRITE, 5);
+		device->write(base + SemihostDevice::REG_WRITE, 0);
+
+		// Then:
+		EXPECT_EQ(readOutput(), "HelloHello, World!");
+	}
+
+	/* Test the cycle counter is latched when the low byte is read */
+	TEST_F(TestSemihostDevice, TestReadCycles) {
+		// Given:
+		for (Word i = 0x1000; i < 0x1100; i++)
+			(*memory)[i] = INS_NOP_IMP.opcode;
+		cpu->run(300);
+
+		// When:
+		Byte low = device->read(base + SemihostDevice::REG_CYCLES);
+		cpu->run(2);
+
+		// Then: higher bytes come from the latched value
+		EXPECT_EQ(low, 300 & 0xFF);
+		EXPECT_EQ(device->read(base + SemihostDevice::REG_CYCLES + 1), 300 >> 8);
+		for (Byte i = 2; i < 8; i++)
+			EXPECT_EQ(device->read(base + SemihostDevice::REG_CYCLES + i), 0x00);
+	}
+
+	/* Test the guest can read the counter through the CPU */
+	TEST_F(TestSemihostDevice, TestReadCyclesFromGuest) {
+		// Given:
+		Byte program[] = {
+			INS_NOP_IMP.opcode,
+			INS_LDA_ABS.opcode, 0x08, 0xFE,				// LDA CYCLES
+		};
+		memory->loadProgram(0x1000, program, sizeof(program));
+
+		// When:
+		cpu->execute(2);
+
+		// Then: the NOP (2 cycles) had finished when the LDA read the counter
+		EXPECT_EQ(state->A, 2);
+	}
+}
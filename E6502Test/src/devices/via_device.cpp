@@ -0,0 +1,183 @@
+#include <gmock/gmock.h>
+#include "types.h"
+#include "../machine_test.h"
+#include "devices/via_device.h"
+
+namespace E6502 {
+
+	class TestViaDevice : public TestMachine {
+	public:
+		const Byte page = 0xFC;
+		const Word base = 0xFC00;
+
+		ViaDevice* via = nullptr;
+
+		virtual void SetUp() {
+			TestMachine::SetUp();
+			via = new ViaDevice(cpu, 3);
+			memory->mapDevice(page, via);
+		}
+
+		virtual void TearDown() {
+			delete via;
+			TestMachine::TearDown();
+		}
+
+		/* Fills memory from 0x1000 with NOPs */
+		void loadNops() {
+			for (Word i = 0x1000; i < 0x2000; i++)
+				(*memory)[i] = INS_NOP_IMP.opcode;
+		}
+
+		/* Current value of timer 1 */
+		Word readT1() {
+			Word high = via->read(base + ViaDevice::REG_T1C_H);
+			return (high << 8) | via->read(base + ViaDevice::REG_T1C_L);
+		}
+
+		/**
+		 * Loads a program that puts T1 in free-run mode with a 100 cycle period, enables its interrupt then
+		 * waits in a JMP to itself. The handler counts interrupts at $10.
+		 */
+		void loadTimerProgram() {
+			Byte program[] = {
+				INS_LDA_IMM.opcode, ViaDevice::ACR_T1_FREE_RUN,
+				INS_STA_ABS.opcode, 0x0B, 0xFC,			// STA ACR
+				INS_LDA_IMM.opcode, 0xC0,
+				INS_STA_ABS.opcode, 0x0E, 0xFC,			// STA IER
+				INS_LDA_IMM.opcode, 98,
+				INS_STA_ABS.opcode, 0x04, 0xFC,			// STA T1C_L
+				INS_LDA_IMM.opcode, 0x00,
+				INS_STA_ABS.opcode, 0x05, 0xFC,			// STA T1C_H
+				INS_CLI_IMP.opcode,
+				INS_JMP_ABS.opcode, 0x15, 0x10,			// wait: JMP wait
+			};
+			Byte handler[] = {
+				INS_INC_ZP0.opcode, 0x10,
+				INS_LDA_ABS.opcode, 0x04, 0xFC,			// LDA T1C_L - acknowledges the interrupt
+				INS_RTI.opcode,
+			};
+			memory->loadProgram(0x1000, program, sizeof(program));
+			memory->loadProgram(0x2000, handler, sizeof(handler));
+			(*memory)[CPUInternal::IRQ_VECTOR] = 0x00;
+			(*memory)[CPUInternal::IRQ_VECTOR + 1] = 0x20;
+		}
+	};
+
+	/* Test the counter is worked out from the cycle counter */
+	TEST_F(TestViaDevice, TestCounterFromCycles) {
+		// Given:
+		loadNops();
+		via->write(base + ViaDevice::REG_T1C_L, 0xE8);
+		via->write(base + ViaDevice::REG_T1C_H, 0x03);		// 1000
+
+		// Then:
+		EXPECT_EQ(via->read(base + ViaDevice::REG_T1L_L), 0xE8);
+		EXPECT_EQ(via->read(base + ViaDevice::REG_T1L_H), 0x03);
+		EXPECT_EQ(readT1(), 1000);
+
+		// When:
+		cpu->execute(10);
+
+		// Then:
+		EXPECT_EQ(readT1(), 980);
+	}
+
+	/* Test a one shot underflow sets the flag, and only interrupts when enabled */
+	TEST_F(TestViaDevice, TestOneShotUnderflow) {
+		// Given:
+		loadNops();
+		state->FLAGS.bit.I = 1;
+		via->write(base + ViaDevice::REG_T1C_L, 9);
+		via->write(base + ViaDevice::REG_T1C_H, 0);
+
+		// When: 8 cycles, still counting
+		cpu->run(8);
+
+		// Then:
+		EXPECT_EQ(via->read(base + ViaDevice::REG_IFR), 0x00);
+		EXPECT_EQ(readT1(), 1);
+
+		// When: past zero
+		cpu->run(4);
+
+		// Then: the flag is set but nothing is enabled
+		EXPECT_EQ(via->read(base + ViaDevice::REG_IFR), ViaDevice::IFR_T1);
+		EXPECT_EQ(via->read(base + ViaDevice::REG_T1C_H), 0xFF);
+
+		// When: enabled
+		via->write(base + ViaDevice::REG_IER, 0x80 | ViaDevice::IFR_T1);
+
+		// Then:
+		EXPECT_EQ(via->read(base + ViaDevice::REG_IER), 0x80 | ViaDevice::IFR_T1);
+		EXPECT_EQ(via->read(base + ViaDevice::REG_IFR), ViaDevice::IFR_IRQ | ViaDevice::IFR_T1);
+
+		// When: reading the low counter clears the flag
+		via->read(base + ViaDevice::REG_T1C_L);
+
+		// Then: and a one shot timer doesn't set it again
+		EXPECT_EQ(via->read(base + ViaDevice::REG_IFR), 0x00);
+		cpu->run(1000);
+		EXPECT_EQ(via->read(base + ViaDevice::REG_IFR), 0x00);
+	}
+
+	/* Test timer 2 and clearing flags through IFR */
+	TEST_F(TestViaDevice, TestTimer2) {
+		// Given:
+		loadNops();
+		via->write(base + ViaDevice::REG_T2C_L, 3);
+		via->write(base + ViaDevice::REG_T2C_H, 0);
+
+		// When:
+		cpu->run(4);
+
+		// Then:
+		EXPECT_EQ(via->read(base + ViaDevice::REG_IFR), ViaDevice::IFR_T2);
+
+		// When:
+		via->write(base + ViaDevice::REG_IFR, ViaDevice::IFR_T2);
+
+		// Then:
+		EXPECT_EQ(via->read(base + ViaDevice::REG_IFR), 0x00);
+	}
+
+	/* Test the guest takes a free-running timer interrupt every period */
+	TEST_F(TestViaDevice, TestFreeRunInterrupts) {
+		// Given:
+		loadTimerProgram();
+
+		// When:
+		cpu->run(10000);
+
+		// Then: setup takes 22 cycles and the first underflow is 99 cycles after loading, then every 100
+		EXPECT_EQ((*memory)[0x10], 99);
+		EXPECT_EQ(state->FLAGS.bit.I, 0);
+		EXPECT_EQ(state->SP, 0xFF);
+	}
+
+	/* Test skipping the idle loop between interrupts gives exactly the same result as running it */
+	TEST_F(TestViaDevice, TestIdleSkipMatchesIgnore) {
+		// Given:
+		loadTimerProgram();
+		Memory ignoreMemory;
+		CPUState ignoreState;
+		CPUInternal ignoreCPU(&ignoreState, &ignoreMemory, &InstructionUtils::loader);
+		ignoreCPU.reset();
+		ignoreCPU.setIdleMode(CPUInternal::IDLE_IGNORE);
+		ViaDevice ignoreVia(&ignoreCPU);
+		ignoreMemory.mapDevice(page, &ignoreVia);
+		for (int i = 0; i < MAX_MEM; i++)
+			if (memory->deviceAt(i) == nullptr) ignoreMemory[i] = (*memory)[i];
+		ignoreState.PC = 0x1000;
+
+		// When:
+		cpu->run(54321);
+		ignoreCPU.run(54321);
+
+		// Then:
+		EXPECT_EQ(cpu->getCycles(), ignoreCPU.getCycles());
+		EXPECT_EQ((*memory)[0x10], ignoreMemory[0x10]);
+		EXPECT_EQ(*state, ignoreState);
+		EXPECT_EQ(readT1(), (Word)((ignoreVia.read(base + ViaDevice::REG_T1C_H) << 8) | ignoreVia.read(base + ViaDevice::REG_T1C_L)));
+	}
+}
@@ -0,0 +1,154 @@
+#include <gmock/gmock.h>
+#include <chrono>
+#include <functional>
+#include "types.h"
+#include "machine_test.h"
+#include "emulation_thread.h"
+
+namespace E6502 {
+
+	class TestEmulationThread : public TestMachine {
+	public:
+		EmulationThread* emulation = nullptr;
+		u32 posted = 0;
+
+		virtual void SetUp() {
+			TestMachine::SetUp();
+			for (Word i = 0x1000; i < 0x1100; i++)
+				(*memory)[i] = INS_NOP_IMP.opcode;
+			(*memory)[0x1100] = INS_JMP_ABS.opcode;	// Back to the start
+			(*memory)[0x1101] = 0x00;
+			(*memory)[0x1102] = 0x10;
+			emulation = new EmulationThread(cpu, state, memory);
+		}
+
+		virtual void TearDown() {
+			delete emulation;
+			TestMachine::TearDown();
+		}
+
+		/* Waits (up to 5s) until <done> is true for the published snapshot */
+		EmulationSnapshot waitFor(std::function<bool(const EmulationSnapshot&)> done) {
+			auto limit = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+			EmulationSnapshot snapshot = emulation->snapshot();
+			while (!done(snapshot) && std::chrono::steady_clock::now() < limit) {
+				std::this_thread::yield();
+				snapshot = emulation->snapshot();
+			}
+			return snapshot;
+		}
+
+		/* Waits until every command posted so far has been handled */
+		EmulationSnapshot waitForCommands() {
+			u32 expected = posted;
+			return waitFor([expected](const EmulationSnapshot& s) { return s.commandsDone >= expected; });
+		}
+	};
+
+	/* Test the initial state is published before the thread starts */
+	TEST_F(TestEmulationThread, TestInitialSnapshot) {
+		EmulationSnapshot snapshot = emulation->snapshot();
+		EXPECT_EQ(snapshot.state.PC, 0x1000);
+		EXPECT_FALSE(snapshot.running);
+		EXPECT_EQ(snapshot.commandsDone, 0);
+	}
+
+	/* Test stepping and poking while paused */
+	TEST_F(TestEmulationThread, TestStepAndPoke) {
+		// Given:
+		emulation->start();
+
+		// When:
+		emulation->step(3); posted++;
+		emulation->poke(0x2000, 0x5A); posted++;
+		EmulationSnapshot snapshot = waitForCommands();
+
+		// Then:
+		EXPECT_EQ(snapshot.commandsDone, 2);
+		EXPECT_EQ(snapshot.state.PC, 0x1003);
+		EXPECT_EQ(snapshot.cycles, 6);
+		EXPECT_FALSE(snapshot.running);
+
+		// When:
+		emulation->stop();
+
+		// Then: memory and registers belong to the caller again
+		EXPECT_EQ((*memory)[0x2000], 0x5A);
+		EXPECT_EQ(state->PC, 0x1003);
+	}
+
+	/* Test a run with a budget stops by itself */
+	TEST_F(TestEmulationThread, TestRunBudget) {
+		// Given:
+		emulation->setSliceCycles(100);
+		emulation->start();
+
+		// When:
+		emulation->run(1000); posted++;
+		EmulationSnapshot snapshot = waitFor([](const EmulationSnapshot& s) { return s.commandsDone == 1 && !s.running; });
+
+		// Then: the run ends after the instruction that reaches 1000 cycles (256 NOPs + JMP = 515, 243 NOPs more)
+		EXPECT_FALSE(snapshot.running);
+		EXPECT_EQ(snapshot.cycles, 1001);
+		EXPECT_EQ(snapshot.stopReason, CPUInternal::STOP_BUDGET);
+	}
+
+	/* Test an unlimited run can be observed and paused */
+	TEST_F(TestEmulationThread, TestRunPause) {
+		// Given:
+		emulation->start();
+
+		// When:
+		emulation->run(); posted++;
+		EmulationSnapshot first = waitFor([](const EmulationSnapshot& s) { return s.cycles > 100000; });
+		EmulationSnapshot second = waitFor([&first](const EmulationSnapshot& s) { return s.cycles > first.cycles; });
+
+		// Then: observers see it progress
+		EXPECT_TRUE(second.running);
+		EXPECT_GT(second.cycles, first.cycles);
+
+		// When:
+		emulation->pause(); posted++;
+		EmulationSnapshot paused = waitForCommands();
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		EmulationSnapshot later = emulation->snapshot();
+
+		// Then: nothing moves once paused
+		EXPECT_FALSE(paused.running);
+		EXPECT_EQ(later.cycles, paused.cycles);
+		EXPECT_GE(paused.state.PC, 0x1000);
+		EXPECT_LE(paused.state.PC, 0x1100);
+	}
+
+	/* Test a breakpoint pauses the thread */
+	TEST_F(TestEmulationThread, TestBreakpoint) {
+		// Given:
+		cpu->setBreakpoint(0x1080, true);
+		emulation->start();
+
+		// When:
+		emulation->run(); posted++;
+		EmulationSnapshot snapshot = waitFor([](const EmulationSnapshot& s) { return s.commandsDone == 1 && !s.running; });
+
+		// Then:
+		EXPECT_EQ(snapshot.stopReason, CPUInternal::STOP_BREAKPOINT);
+		EXPECT_EQ(snapshot.state.PC, 0x1080);
+	}
+
+	/* Test a breakpoint on the first instruction of a slice still pauses the thread */
+	TEST_F(TestEmulationThread, TestBreakpointSliceBoundary) {
+		// Given: the first slice ends on the breakpoint (32 NOPs)
+		cpu->setBreakpoint(0x1020, true);
+		emulation->setSliceCycles(64);
+		emulation->start();
+
+		// When:
+		emulation->run(); posted++;
+		EmulationSnapshot snapshot = waitFor([](const EmulationSnapshot& s) { return s.commandsDone == 1 && !s.running; });
+
+		// Then:
+		EXPECT_EQ(snapshot.stopReason, CPUInternal::STOP_BREAKPOINT);
+		EXPECT_EQ(snapshot.state.PC, 0x1020);
+		EXPECT_EQ(snapshot.cycles, 64);
+	}
+}
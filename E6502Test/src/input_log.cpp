@@ -0,0 +1,196 @@
+#include <gmock/gmock.h>
+#include <stdio.h>
+#include "types.h"
+#include "machine_test.h"
+#include "input_log.h"
+#include "devices/via_device.h"
+#include "devices/semihost_device.h"
+
+namespace E6502 {
+
+	class TestInputLog : public TestMachine {
+	public:
+		const Byte viaPage = 0xFC;
+		const Byte semihostPage = 0xFD;
+
+		ViaDevice* via = nullptr;
+		SemihostDevice* semihost = nullptr;
+		FILE* log = nullptr;
+
+		virtual void SetUp() {
+			TestMachine::SetUp();
+			via = new ViaDevice(cpu, 2);
+			semihost = new SemihostDevice(cpu, memory, nullptr);
+			memory->mapDevice(viaPage, via);
+			memory->mapDevice(semihostPage, semihost);
+			loadProgram(*memory);
+			log = tmpfile();
+			ASSERT_NE(log, nullptr);
+		}
+
+		virtual void TearDown() {
+			fclose(log);
+			delete semihost;
+			delete via;
+			TestMachine::TearDown();
+		}
+
+		/**
+		 * Starts T1 free running with a 200 cycle period and waits for interrupts. Each interrupt stores the low
+		 * byte of the counter at $20 + count, the 8th writes the count to the semihost EXIT register.
+		 */
+		void loadProgram(Memory& target) {
+			Byte program[] = {
+				INS_LDA_IMM.opcode, ViaDevice::ACR_T1_FREE_RUN,
+				INS_STA_ABS.opcode, 0x0B, 0xFC,			// STA ACR
+				INS_LDA_IMM.opcode, 0xC0,
+				INS_STA_ABS.opcode, 0x0E, 0xFC,			// STA IER
+				INS_LDA_IMM.opcode, 198,
+				INS_STA_ABS.opcode, 0x04, 0xFC,			// STA T1C_L
+				INS_LDA_IMM.opcode, 0x00,
+				INS_STA_ABS.opcode, 0x05, 0xFC,			// STA T1C_H
+				INS_CLI_IMP.opcode,
+				INS_JMP_ABS.opcode, 0x15, 0x10,			// wait: JMP wait
+			};
+			Byte handler[] = {
+				INS_INC_ZP0.opcode, 0x10,
+				INS_LDX_ZP.opcode, 0x10,
+				INS_LDA_ABS.opcode, 0x04, 0xFC,			// LDA T1C_L - acknowledges the interrupt
+				INS_STA_ZPX.opcode, 0x20,
+				INS_LDA_ZP.opcode, 0x10,
+				INS_AND_IMM.opcode, 0x07,
+				INS_BNE_REL.opcode, 0x03,
+				INS_STX_ABS.opcode, 0x00, 0xFD,			// STX EXIT every 8th interrupt
+				INS_RTI.opcode,
+			};
+			target.loadProgram(0x1000, program, sizeof(program));
+			target.loadProgram(0x2000, handler, sizeof(handler));
+			target[CPUInternal::IRQ_VECTOR] = 0x00;
+			target[CPUInternal::IRQ_VECTOR + 1] = 0x20;
+		}
+	};
+
+	/* Test a replay without the devices reproduces the recorded run exactly */
+	TEST_F(TestInputLog, TestReplayMatchesRecording) {
+		// Given: a run that takes interrupts, reads the timer and is stopped by the guest
+		InputRecorder recorder(cpu, memory, log);
+		ASSERT_TRUE(recorder.start());
+		u8 firstStop = cpu->run(100000);
+		u64 firstCycles = cpu->getCycles();
+		u8 secondStop = cpu->run(1000);
+		cpu->setIRQ(7, true);		// Host input between runs
+		u8 thirdStop = cpu->run(100000);
+		ASSERT_TRUE(recorder.finish());
+		ASSERT_EQ(firstStop, CPUInternal::STOP_EXIT);
+		ASSERT_EQ(secondStop, CPUInternal::STOP_BUDGET);
+		ASSERT_EQ(memory->mappedDevice(viaPage), via);		// Real devices are back
+
+		// When: the same program is replayed on a machine with no devices
+		Memory replayMemory;
+		CPUState replayState;
+		CPUInternal replayCPU(&replayState, &replayMemory, &InstructionUtils::loader);
+		replayCPU.reset();
+		loadProgram(replayMemory);
+		replayState.PC = 0x1000;
+		InputReplayer replayer(&replayCPU, &replayMemory);
+		rewind(log);
+		ASSERT_TRUE(replayer.load(log));
+		replayer.start();
+
+		// Then: every run ends in the same place
+		EXPECT_EQ(replayCPU.run(100000), firstStop);
+		EXPECT_EQ(replayCPU.getCycles(), firstCycles);
+		EXPECT_EQ(replayCPU.run(1000), secondStop);
+		EXPECT_EQ(replayCPU.run(100000), thirdStop);
+		EXPECT_EQ(replayCPU.getCycles(), cpu->getCycles());
+		EXPECT_EQ(replayState, *state);
+		for (Word address = 0x0000; address < 0x0100; address++)
+			ASSERT_EQ(replayMemory[address], (*memory)[address]) << "at " << address;
+		EXPECT_TRUE(replayer.isComplete());
+		EXPECT_FALSE(replayer.hasDiverged());
+		EXPECT_EQ(replayer.records(), recorder.records());
+
+		// When:
+		replayer.finish();
+
+		// Then:
+		EXPECT_EQ(replayMemory.mappedDevice(viaPage), nullptr);
+	}
+
+	/* Test the log is compact - a device read is a tag, a short cycle delta, the address and the value */
+	TEST_F(TestInputLog, TestRecordSize) {
+		// Given:
+		InputRecorder recorder(cpu, memory, log);
+		ASSERT_TRUE(recorder.start());
+
+		// When:
+		cpu->run(1500);
+		ASSERT_TRUE(recorder.finish());
+
+		// Then: 7 interrupts, each an IRQ assert 200 cycles after the last record (a two byte delta), the read of
+		// T1C_L and the release the read causes in the same instruction (a zero delta)
+		fseek(log, 0, SEEK_END);
+		EXPECT_EQ(recorder.records(), 21u);
+		EXPECT_EQ(ftell(log), InputLog::HEADER_SIZE + 7 * (4 + 5 + 3));
+	}
+
+	/* Test a replay that reads something else is reported as diverged */
+	TEST_F(TestInputLog, TestDivergence) {
+		// Given:
+		InputRecorder recorder(cpu, memory, log);
+		ASSERT_TRUE(recorder.start());
+		cpu->run(1000);
+		ASSERT_TRUE(recorder.finish());
+
+		Memory replayMemory;
+		CPUState replayState;
+		CPUInternal replayCPU(&replayState, &replayMemory, &InstructionUtils::loader);
+		replayCPU.reset();
+		loadProgram(replayMemory);
+		replayMemory[0x2005] = 0x05;		// Handler reads T1C_H instead
+		replayState.PC = 0x1000;
+		InputReplayer replayer(&replayCPU, &replayMemory);
+		rewind(log);
+		ASSERT_TRUE(replayer.load(log));
+		replayer.start();
+
+		// When:
+		replayCPU.run(1000);
+
+		// Then:
+		EXPECT_TRUE(replayer.hasDiverged());
+	}
+
+	/* Test a log cut short mid-record loads up to the last whole record, and other files are rejected */
+	TEST_F(TestInputLog, TestTruncatedAndInvalid) {
+		// Given:
+		InputRecorder recorder(cpu, memory, log);
+		ASSERT_TRUE(recorder.start());
+		cpu->run(1500);
+		ASSERT_TRUE(recorder.finish());
+		std::vector<Byte> bytes(InputLog::HEADER_SIZE + 7 * 12);
+		rewind(log);
+		ASSERT_EQ(fread(bytes.data(), 1, bytes.size(), log), bytes.size());
+
+		// When: the last record loses its final byte
+		FILE* truncated = tmpfile();
+		fwrite(bytes.data(), 1, bytes.size() - 1, truncated);
+		rewind(truncated);
+		InputReplayer replayer(cpu, memory);
+
+		// Then:
+		EXPECT_TRUE(replayer.load(truncated));
+		EXPECT_EQ(replayer.records(), 20u);
+		fclose(truncated);
+
+		// When: not a log
+		FILE* invalid = tmpfile();
+		bytes[0] = 'X';
+		fwrite(bytes.data(), 1, bytes.size(), invalid);
+		rewind(invalid);
+
+		// Then:
+		EXPECT_FALSE(replayer.load(invalid));
+		fclose(invalid);
+	}
+}
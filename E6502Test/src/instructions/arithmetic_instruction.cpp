@@ -22,6 +22,30 @@ namespace E6502 {
 			return (al & 0x00FF);									// Answer is lowets byte of AL
 		}
 
+		// Helper for calculating the result of a decimal subtract
+		Byte decimalSub(Byte operandA, Byte operandB, bool carry) {
+			int al = (operandA & 0x0F) - (operandB & 0x0F) + (carry ? 0 : -1);	// Subtract LSD
+			if (al < 0) al = ((al - 0x06) & 0x0F) - 0x10;			// if lsd borrowed, subtract 6 and borrow from next digit
+			al = (operandA & 0xF0) - (operandB & 0xF0) + al;		// Subtract MSD
+			if (al < 0) al = al - 0x60;								// if msd borrowed, subtract 6 from MSD
+			return (al & 0x00FF);
+		}
+
+		// Helper for calculating the expected result of ADC (addition = true) or SBC
+		Byte expectedResult(Byte operandA, Byte operandB, bool carry, bool decimal, bool addition) {
+			if (addition)
+				return decimal ? decimalAdd(operandA, operandB, carry) : (Byte)(operandA + operandB + carry);
+			return decimal ? decimalSub(operandA, operandB, carry) : (Byte)(operandA + (Byte)(~operandB) + carry);
+		}
+
+		// Sets the expectation for the accumulator operation used by the instruction under test
+		void expectAccumulatorCall(Byte testValue, bool addition) {
+			if (addition)
+				EXPECT_CALL(*mockCPU, addAccumulator(_, testValue)).Times(1);
+			else
+				EXPECT_CALL(*mockCPU, subAccumulator(_, testValue)).Times(1);
+		}
+
 		// Uses mocks to test correct function calls
 		void testImmFlow(InstructionHandler instruction, bool addition = true) {
 			// Given:
@@ -30,10 +54,7 @@ namespace E6502 {
 
 			// Then:
 			EXPECT_CALL(*mockCPU, readPCByte(_)).Times(1).WillOnce(Return(testValue));
-			if (addition)
-				EXPECT_CALL(*mockCPU, addAccumulator(_, testValue)).Times(1);
-			else
-				EXPECT_CALL(*mockCPU, subAccumulator(_, testValue)).Times(1);
+			expectAccumulatorCall(testValue, addition);
 			// When:
 			cpu->testExecute(1, mockCPU);
 		}
@@ -53,18 +74,14 @@ namespace E6502 {
 			u8 cycles = cpu->execute(1);
 
 			// Then:
-			Byte expectResult = 0;
-			if (addition)
-				expectResult = decimal ? decimalAdd(opA, opB, flag) : (Byte)(opA + opB + flag);
-			else
-				expectResult = decimal ? decimalAdd(opA, (~opB), flag) : (Byte)(opA + (~opB) + flag);
+			Byte expectResult = expectedResult(opA, opB, flag, decimal, addition);
 			EXPECT_EQ(state->A, expectResult);
 			EXPECT_EQ(cycles, 2);
 			state->FLAGS = initPS;	// Not interested in testing flags here as this is covered in CPU tests for addAccumulator
 		}
 
 		// Uses mocks to test correct function calls
-		void testAbsZPFlow(InstructionHandler instruction, bool isZeroPage = false, Byte* indexReg = nullptr) {
+		void testAbsZPFlow(InstructionHandler instruction, bool isZeroPage = false, Byte* indexReg = nullptr, bool addition = true) {
 			if (isZeroPage) dataSpace &= 0x00FF;
 
 			// Given:
@@ -89,14 +106,14 @@ namespace E6502 {
 				EXPECT_CALL(*mockCPU, readPCWord(_)).Times(1).WillOnce(Return(dataSpace));
 
 			EXPECT_CALL(*mockCPU, readReferenceByte(_, referencesAreEqual(CPU::REFERENCE_MEM, targetAddress))).Times(1).WillOnce(Return(testValue));
-			EXPECT_CALL(*mockCPU, addAccumulator(_, testValue)).Times(1);
+			expectAccumulatorCall(testValue, addition);
 
 			// When
 			u8 cycles = cpu->testExecute(1, mockCPU);
 		}
 
 		// Tests instruction actually produces correct result (Does not test flags, as this is handled in CPU tests)
-		void testAbsZPReal(InstructionHandler instruction, bool decimal, bool isZeroPage = false, bool crossBoundry = false, Byte* targetReg = nullptr) {
+		void testAbsZPReal(InstructionHandler instruction, bool decimal, bool isZeroPage = false, bool crossBoundry = false, Byte* targetReg = nullptr, bool addition = true) {
 			state->FLAGS.bit.D = decimal;
 			Byte expectedCycles = 4;
 			Byte index = rand();
@@ -139,14 +156,14 @@ namespace E6502 {
 			u8 cycles = cpu->execute(1);
 
 			// Then:
-			Byte expectResult = decimal ? decimalAdd(opA, opB, flag) : (Byte)(opA + opB + flag);
+			Byte expectResult = expectedResult(opA, opB, flag, decimal, addition);
 			EXPECT_EQ(state->A, expectResult);
 			EXPECT_EQ(cycles, expectedCycles);
 			state->FLAGS = initPS;		// Not interested in testing flags here as this is covered in CPU tests
 		}
 
 		// Uses mocks to test correct function calls
-		void testIndirectXFlow(InstructionHandler instruction) {
+		void testIndirectXFlow(InstructionHandler instruction, bool addition = true) {
 			// Given:
 			Byte testValue = rand();
 			Byte zpBase = rand();
@@ -161,14 +178,14 @@ namespace E6502 {
 			EXPECT_CALL(*mockCPU, regValue(_, CPU::REGISTER_X)).Times(1).WillOnce(Return(index));
 			EXPECT_CALL(*mockCPU, readWord(_, zpTarget)).Times(1).WillOnce(Return(dataSpace));
 			EXPECT_CALL(*mockCPU, readReferenceByte(_, referencesAreEqual(CPU::REFERENCE_MEM, dataSpace))).Times(1).WillOnce(Return(testValue));
-			EXPECT_CALL(*mockCPU, addAccumulator(_, testValue)).Times(1);
+			expectAccumulatorCall(testValue, addition);
 
 			// When:
 			cpu->testExecute(1, mockCPU);
 		}
 
 		// Tests instruction actually produces correct result (Does not test flags, as this is handled in CPU tests)
-		void testIndirectXReal(InstructionHandler instruction, bool decimal) {
+		void testIndirectXReal(InstructionHandler instruction, bool decimal, bool addition = true) {
 			// Given:
 			Byte opA = rand(), opB = rand();
 			Byte flag = (state->FLAGS.bit.C ? 1 : 0);
@@ -189,14 +206,14 @@ namespace E6502 {
 			u8 cycles = cpu->execute(1);
 
 			// Then:
-			Byte expectResult = decimal ? decimalAdd(opA, opB, flag) : (Byte)(opA + opB + flag);
+			Byte expectResult = expectedResult(opA, opB, flag, decimal, addition);
 			EXPECT_EQ(state->A, expectResult);
 			EXPECT_EQ(cycles, 6);
 			state->FLAGS = initPS;
 		}
 
 		// Uses mocks to test correct function calls
-		void testIndirectYFlow(InstructionHandler instruction) {
+		void testIndirectYFlow(InstructionHandler instruction, bool addition = true) {
 			// Given:
 			Byte testValue = rand();
 			Byte zpTarget = rand();
@@ -210,14 +227,14 @@ namespace E6502 {
 			EXPECT_CALL(*mockCPU, readWord(_, zpTarget)).Times(1).WillOnce(Return(dataSpace));
 			EXPECT_CALL(*mockCPU, regValue(_, CPU::REGISTER_Y)).Times(1).WillOnce(Return(index));
 			EXPECT_CALL(*mockCPU, readReferenceByte(_, referencesAreEqual(CPU::REFERENCE_MEM, opTarget))).Times(1).WillOnce(Return(testValue));
-			EXPECT_CALL(*mockCPU, addAccumulator(_, testValue)).Times(1);
+			expectAccumulatorCall(testValue, addition);
 
 			// When:
 			cpu->testExecute(1, mockCPU);
 		}
 
 		// Tests instruction actually produces correct result (Does not test flags, as this is handled in CPU tests)
-		void testIndirectYReal(InstructionHandler instruction, bool decimal, bool crossPage = false) {
+		void testIndirectYReal(InstructionHandler instruction, bool decimal, bool crossPage = false, bool addition = true) {
 			// Given:
 			Byte index = rand();
 			if (crossPage) {
@@ -246,7 +263,7 @@ namespace E6502 {
 			u8 cycles = cpu->execute(1);
 
 			// Then:
-			Byte expectResult = decimal ? decimalAdd(opA, opB, flag) : (Byte)(opA + opB + flag);
+			Byte expectResult = expectedResult(opA, opB, flag, decimal, addition);
 			EXPECT_EQ(state->A, expectResult);
 			EXPECT_EQ(cycles, crossPage ? 6 : 5);
 			state->FLAGS = initPS;
@@ -262,7 +279,8 @@ namespace E6502 {
 			{INS_ADC_ZP0, 0x65}, {INS_ADC_ZPX, 0x75}, {INS_ADC_INX, 0x61}, {INS_ADC_INY, 0x71},
 
 			// SBC Instructions
-			{INS_SBC_IMM, 0xE9},
+			{INS_SBC_IMM, 0xE9}, {INS_SBC_ABS, 0xED}, {INS_SBC_ABX, 0xFD}, {INS_SBC_ABY, 0xF9},
+			{INS_SBC_ZP0, 0xE5}, {INS_SBC_ZPX, 0xF5}, {INS_SBC_INX, 0xE1}, {INS_SBC_INY, 0xF1},
 
 		};
 		testInstructionDef(instructions, ArithmeticInstruction::addHandlers);
@@ -322,9 +340,51 @@ namespace E6502 {				// new scope allows for better readibility
 
 /***************** SBC TESTS *****************/
 namespace E6502 {				// new scope allows for better readibility
-	/** Immediate tests 
+	/** Immediate tests */
 	TEST_F(TestArithmeticInstruction, TestSBCImmediate) { testImmFlow(INS_SBC_IMM, false); }
 	TEST_F(TestArithmeticInstruction, TestSBCImmediateRealBinary) { testImmReal(INS_SBC_IMM, false, false); }
 	TEST_F(TestArithmeticInstruction, TestSBCImmediateRealDecimal) { testImmReal(INS_SBC_IMM, true, false); }
-	*/
-}
\ No newline at end of file
+
+	// Absolute flow tests
+	TEST_F(TestArithmeticInstruction, TestSBCAbsolute) { testAbsZPFlow(INS_SBC_ABS, false, nullptr, false); }
+	TEST_F(TestArithmeticInstruction, TestSBCAbsoluteX) { testAbsZPFlow(INS_SBC_ABX, false, &state->X, false); }
+	TEST_F(TestArithmeticInstruction, TestSBCAbsoluteY) { testAbsZPFlow(INS_SBC_ABY, false, &state->Y, false); }
+
+	// Absolute 'real' tests (Binary)
+	TEST_F(TestArithmeticInstruction, TestSBCAbsoluteRealBinary) { testAbsZPReal(INS_SBC_ABS, false, false, false, nullptr, false); }
+	TEST_F(TestArithmeticInstruction, TestSBCAbsoluteXRealBinary) { testAbsZPReal(INS_SBC_ABX, false, false, false, &state->X, false); }
+	TEST_F(TestArithmeticInstruction, TestSBCAbsoluteYRealBinary) { testAbsZPReal(INS_SBC_ABY, false, false, false, &state->Y, false); }
+	TEST_F(TestArithmeticInstruction, TestSBCAbsoluteXRealCrossBinary) { testAbsZPReal(INS_SBC_ABX, false, false, true, &state->X, false); }
+	TEST_F(TestArithmeticInstruction, TestSBCAbsoluteYRealCrossBinary) { testAbsZPReal(INS_SBC_ABY, false, false, true, &state->Y, false); }
+
+	// Absolute 'real' tests (Decimal)
+	TEST_F(TestArithmeticInstruction, TestSBCAbsoluteRealDecimal) { testAbsZPReal(INS_SBC_ABS, true, false, false, nullptr, false); }
+	TEST_F(TestArithmeticInstruction, TestSBCAbsoluteXRealDecimal) { testAbsZPReal(INS_SBC_ABX, true, false, false, &state->X, false); }
+	TEST_F(TestArithmeticInstruction, TestSBCAbsoluteYRealDecimal) { testAbsZPReal(INS_SBC_ABY, true, false, false, &state->Y, false); }
+	TEST_F(TestArithmeticInstruction, TestSBCAbsoluteXRealCrossDecimal) { testAbsZPReal(INS_SBC_ABX, true, false, true, &state->X, false); }
+	TEST_F(TestArithmeticInstruction, TestSBCAbsoluteYRealCrossDecimal) { testAbsZPReal(INS_SBC_ABY, true, false, true, &state->Y, false); }
+
+	// Zero Page flow tests
+	TEST_F(TestArithmeticInstruction, TestSBCZeroPage) { testAbsZPFlow(INS_SBC_ZP0, true, nullptr, false); }
+	TEST_F(TestArithmeticInstruction, TestSBCZeroPageX) { testAbsZPFlow(INS_SBC_ZPX, true, &state->X, false); }
+
+	// ZeroPAge 'real' tests (Binary)
+	TEST_F(TestArithmeticInstruction, TestSBCZeroPageRealBinary) { testAbsZPReal(INS_SBC_ZP0, false, true, false, nullptr, false); }
+	TEST_F(TestArithmeticInstruction, TestSBCZeroPageXRealBinary) { testAbsZPReal(INS_SBC_ZPX, false, true, false, &state->X, false); }
+
+	// ZeroPAge 'real' tests (Decimal)
+	TEST_F(TestArithmeticInstruction, TestSBCZeroPageRealDecimal) { testAbsZPReal(INS_SBC_ZP0, true, true, false, nullptr, false); }
+	TEST_F(TestArithmeticInstruction, TestSBCZeroPageXRealDecimal) { testAbsZPReal(INS_SBC_ZPX, true, true, false, &state->X, false); }
+
+	// X-Indexed Zero Page Indirect flow
+	TEST_F(TestArithmeticInstruction, TestSBCIndirectX) { testIndirectXFlow(INS_SBC_INX, false); }
+	TEST_F(TestArithmeticInstruction, TestSBCIndirectXRealBinary) { testIndirectXReal(INS_SBC_INX, false, false); }
+	TEST_F(TestArithmeticInstruction, TestSBCIndirectXRealDecimal) { testIndirectXReal(INS_SBC_INX, true, false); }
+
+	// Zero Page Indirect Y-Indexed tests
+	TEST_F(TestArithmeticInstruction, TestSBCIndirectY) { testIndirectYFlow(INS_SBC_INY, false); }
+	TEST_F(TestArithmeticInstruction, TestSBCIndirectYRealBinaryNoPage) { testIndirectYReal(INS_SBC_INY, false, false, false); }
+	TEST_F(TestArithmeticInstruction, TestSBCIndirectYRealDecimalNoPage) { testIndirectYReal(INS_SBC_INY, true, false, false); }
+	TEST_F(TestArithmeticInstruction, TestSBCIndirectYRealBinaryPage) { testIndirectYReal(INS_SBC_INY, false, true, false); }
+	TEST_F(TestArithmeticInstruction, TestSBCIndirectYRealDecimalPage) { testIndirectYReal(INS_SBC_INY, true, true, false); }
+}
@@ -12,6 +12,7 @@ namespace E6502 {
 			{INS_JMP_ABS, 0x4C},
 			{INS_JMP_ABIN, 0x6C},
 			{INS_RTS, 0x60},
+			{INS_RTI, 0x40},
 		};
 
 		testInstructionDef(instructions, JumpInstruction::addHandlers);
@@ -89,4 +90,25 @@ namespace E6502 {
 		EXPECT_EQ(state->SP, 0xFF);			// Stack incremented 2
 		EXPECT_EQ(cycles, expectedCycles);
 	}
+
+	/* Test RTI Implied execution */
+	TEST_F(TestJSRInstruction, TestRTIImplied) {
+		// Given: flags and return address as pushed by an interrupt
+		(*memory)[programSpace] = INS_RTI.opcode;
+		(*memory)[0x1FF] = 0x34;
+		(*memory)[0x1FE] = 0x12;
+		(*memory)[0x1FD] = 0xFF;	// All flags set
+		state->SP = 0xFC;
+		state->FLAGS.byte = 0x20;
+
+		// When:
+		Byte cycles = cpu->execute(1);
+
+		// Then: the return address is not incremented and B / unused are unchanged
+		EXPECT_EQ(state->PC, 0x1234);
+		EXPECT_EQ(state->SP, 0xFF);
+		EXPECT_EQ(state->FLAGS.byte, 0xEF);
+		EXPECT_EQ(cycles, 6);
+		state->FLAGS.byte = initPS.byte;	// Prevents parent class thorwing an error due to flag changes
+	}
 }
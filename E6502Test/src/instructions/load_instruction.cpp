@@ -253,9 +253,11 @@ namespace E6502 {
 			(*memory)[testAddresses[i]] = testValues[i];
 			*registers[i] = ~testValues[i];
 			u8 cycles = 0;
+			cpu->loadState();
 
 			// When:
 			LoadInstruction::fetchAndSaveToRegister(cycles, cpu, testAddresses[i], registerNames[i]);
+			cpu->syncState();
 
 			// Then:
 			testAndResetStatusFlags(testValues[i]);
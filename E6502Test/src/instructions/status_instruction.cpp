@@ -9,7 +9,9 @@ namespace E6502 {
 		void testFlagInstruction(InstructionHandler instruction, u8 flag, bool set) {
 			// Given:
 			Byte cycles = 0;
+			cpu->loadState();
 			cpu->setFlag(cycles, flag, !set);
+			cpu->syncState();
 			(*memory)[programSpace] = instruction.opcode;
 			cycles = 0;
 
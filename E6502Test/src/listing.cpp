@@ -0,0 +1,91 @@
+#include <gmock/gmock.h>
+#include <string>
+#include "types.h"
+#include "listing.h"
+
+namespace E6502 {
+
+	class TestListing : public testing::Test {
+	public:
+		Listing listing;
+
+		void load(const std::string& text) {
+			listing.load(text.data(), text.size());
+		}
+
+		void expectLine(size_t index, s32 address, u16 size, bool instruction, bool equate = false) {
+			const ListingLine& line = listing.line(index);
+			EXPECT_EQ(line.address, address) << "line " << index + 1;
+			EXPECT_EQ(line.size, size) << "line " << index + 1;
+			EXPECT_EQ(line.instruction, instruction) << "line " << index + 1;
+			EXPECT_EQ(line.equate, equate) << "line " << index + 1;
+		}
+	};
+
+	/* Test a numbered listing, including a continuation line and CRLF line endings */
+	TEST_F(TestListing, TestNumbered) {
+		// Given:
+		load(
+			"   1                   * = $1000\r\n"
+			"   2                   start\r\n"
+			"   3 1000 a6 00        \tldx $00\t\t\t; set x to 0\r\n"
+			"   4 1002 20 0c 10     \tjsr pushchar\r\n"
+			"   5                   ;\tbeq end\r\n"
+			"   6 1100 48 65 6c 6c  .byte 72, 101, 108, 108, 111, 32\r\n"
+			"     1104 6f 20 \r\n"
+		);
+
+		// Then:
+		ASSERT_EQ(listing.size(), 7);
+		expectLine(0, -1, 0, false);
+		expectLine(1, -1, 0, false);
+		expectLine(2, 0x1000, 2, true);
+		expectLine(3, 0x1002, 3, true);
+		expectLine(4, -1, 0, false);
+		expectLine(5, 0x1100, 4, false);
+		expectLine(6, 0x1104, 2, false);
+		EXPECT_EQ(listing.sourceText(1), "start");
+		EXPECT_EQ(listing.sourceText(3), "\tjsr pushchar");
+		EXPECT_EQ(listing.lineText(6), "     1104 6f 20 ");
+	}
+
+	/* Test an AS65 listing with labels, macro expansion, equates and page headers */
+	TEST_F(TestListing, TestAS65) {
+		// Given:
+		load(
+			"AS65 Assembler for R6502 [1.42].  Copyright 1994-2007, Frank A. Kingswood      Page    1\n"
+			"0010 =                  zp1     equ $10\n"
+			"0400 : d8               start   cld\n"
+			"041a :                  psb_forw\n"
+			"041f : f017                     beq psb_fwok\n"
+			"0421 : 4c2104          >        jmp *           ;failed anyway\n"
+			"0424 : ca                       dex\n"
+			"0425 : 4c6f6f70         loop    db \"loop\"\n"
+			"                        ; comment only\n"
+		);
+
+		// Then:
+		ASSERT_EQ(listing.size(), 9);
+		expectLine(0, -1, 0, false);
+		expectLine(1, 0x0010, 0, false, true);
+		expectLine(2, 0x0400, 1, true);
+		expectLine(3, 0x041A, 0, false);
+		expectLine(4, 0x041F, 2, true);
+		expectLine(5, 0x0421, 3, true);
+		expectLine(6, 0x0424, 1, true);
+		expectLine(7, 0x0425, 4, false);
+		expectLine(8, -1, 0, false);
+		EXPECT_EQ(listing.sourceText(2), "start   cld");
+		EXPECT_EQ(listing.sourceText(8), "; comment only");
+	}
+
+	/* Test mnemonics are recognised in any case and nothing else is */
+	TEST_F(TestListing, TestMnemonics) {
+		EXPECT_TRUE(Listing::isMnemonic("LDA", 3));
+		EXPECT_TRUE(Listing::isMnemonic("bne", 3));
+		EXPECT_TRUE(Listing::isMnemonic("Tya", 3));
+		EXPECT_FALSE(Listing::isMnemonic("db", 2));
+		EXPECT_FALSE(Listing::isMnemonic("equ", 3));
+		EXPECT_FALSE(Listing::isMnemonic("LDAX", 4));
+	}
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <gmock/gmock.h>
+#include "types.h"
+#include "cpu.h"
+#include "instructions/instruction_utils.h"
+
+namespace E6502 {
+
+	/**
+	* Parent class for tests that run programs on a whole machine
+	*	- Creates a Memory, CPUState and CPUInternal on SetUp, with the CPU reset and PC at 0x1000
+	*	- Deletes them on TearDown, so derived classes release anything using them first
+	*/
+	class TestMachine : public testing::Test {
+	public:
+		Memory* memory = nullptr;
+		CPUState* state = nullptr;
+		CPUInternal* cpu = nullptr;
+
+		virtual void SetUp() {
+			memory = new Memory();
+			state = new CPUState;
+			cpu = new CPUInternal(state, memory, &InstructionUtils::loader);
+			cpu->reset();
+			state->PC = 0x1000;
+		}
+
+		virtual void TearDown() {
+			delete cpu;
+			delete state;
+			delete memory;
+		}
+	};
+}
@@ -4,16 +4,45 @@
 
 namespace E6502 {
 
+	struct MockDevice : public Device {
+		MOCK_METHOD(Byte, read, (Word address));
+		MOCK_METHOD(void, write, (Word address, Byte value));
+	};
+
 	class TestMemory : public testing::Test {
 	public:
 		Memory memory;
+		std::string imageName;
+		const char* imagePath = nullptr;
 
 		virtual void SetUp() {
+			// One file per test as ctest runs tests in parallel
+			imageName = std::string("e6502_image_") + testing::UnitTest::GetInstance()->current_test_info()->name() + ".bin";
+			imagePath = imageName.c_str();
 		}
 
 		virtual void TearDown() {
+			remove(imagePath);
 		}
 
+		/* Writes a <size> byte image where each byte is (address * 7) & 0xFF */
+		void writeImage(u32 size) {
+			FILE* fp = NULL;
+			ASSERT_EQ(fopen_s(&fp, imagePath, "wb"), 0);
+			for (u32 i = 0; i < size; i++)
+				fputc((i * 7) & 0xFF, fp);
+			fclose(fp);
+		}
+
+		/* Reads a byte straight from the image file */
+		Byte readImage(u32 offset) {
+			FILE* fp = NULL;
+			fopen_s(&fp, imagePath, "rb");
+			fseek(fp, offset, SEEK_SET);
+			Byte value = (Byte)fgetc(fp);
+			fclose(fp);
+			return value;
+		}
 	};
 
 	/* Test the memory initialisation function */
@@ -64,4 +93,182 @@ namespace E6502 {
 			EXPECT_EQ(memory[nextAddr], expect);
 		}
 	}
+
+	/* Test devices are mapped to whole pages */
+	TEST_F(TestMemory, TestMapDevice) {
+		// Given:
+		MockDevice device;
+		EXPECT_EQ(memory.deviceAt(0xC000), nullptr);
+
+		// When:
+		memory.mapDevice(0xC0, &device);
+
+		// Then:
+		EXPECT_EQ(memory.deviceAt(0xC000), &device);
+		EXPECT_EQ(memory.deviceAt(0xC0FF), &device);
+		EXPECT_EQ(memory.deviceAt(0xBFFF), nullptr);
+		EXPECT_EQ(memory.deviceAt(0xC100), nullptr);
+
+		// When: the same device is mapped to a second page
+		memory.mapDevice(0xC1, &device);
+
+		// Then: it is only listed once
+		ASSERT_EQ(memory.mappedDevices().size(), 1);
+		EXPECT_EQ(memory.mappedDevices()[0], &device);
+
+		// When:
+		memory.mapDevice(0xC0, nullptr);
+		memory.mapDevice(0xC1, nullptr);
+
+		// Then:
+		EXPECT_EQ(memory.deviceAt(0xC000), nullptr);
+		EXPECT_TRUE(memory.mappedDevices().empty());
+	}
+
+	/* Test a copy on write image is read without changing the file */
+	TEST_F(TestMemory, TestMapImageCopyOnWrite) {
+		// Given:
+		writeImage(MAX_MEM);
+
+		// When:
+		ASSERT_TRUE(memory.mapImage(imagePath));
+
+		// Then:
+		EXPECT_EQ(memory[0x0001], 7);
+		EXPECT_EQ(memory[0xFFFF], (0xFFFF * 7) & 0xFF);
+
+		// When: written
+		memory[0x0001] = 0xAA;
+
+		// Then: the file and other instances still see the image
+		Memory other;
+		ASSERT_TRUE(other.mapImage(imagePath));
+		EXPECT_EQ(memory[0x0001], 0xAA);
+		EXPECT_EQ(other[0x0001], 7);
+		EXPECT_EQ(readImage(0x0001), 7);
+
+		// When: reset
+		memory.reset();
+
+		// Then: the image is gone
+		EXPECT_EQ(memory[0x0001], 0x00);
+		EXPECT_EQ(memory[0xFFFF], 0x00);
+	}
+
+	/* Test write through images are visible outside the instance */
+	TEST_F(TestMemory, TestMapImageWriteThrough) {
+		// Given:
+		writeImage(MAX_MEM);
+		if (Memory::mapGranularity() == 0x100) GTEST_SKIP() << "No mmap on this host";
+		ASSERT_TRUE(memory.mapImage(imagePath, Memory::MAP_WRITE_THROUGH));
+		Memory observer;
+		ASSERT_TRUE(observer.mapImage(imagePath, Memory::MAP_WRITE_THROUGH));
+
+		// When:
+		memory[0x1234] = 0x55;
+
+		// Then:
+		EXPECT_EQ(observer[0x1234], 0x55);
+		memory.reset();
+		observer.reset();
+		EXPECT_EQ(readImage(0x1234), 0x55);
+	}
+
+	/* Test part of memory can be mapped from part of a file */
+	TEST_F(TestMemory, TestMapImageRegion) {
+		// Given: an image with a ROM in its second granule
+		u32 granule = Memory::mapGranularity();
+		writeImage(granule * 2);
+		Word address = (Word)(MAX_MEM - granule);
+		memory[address - 1] = 0x11;
+
+		// When:
+		ASSERT_TRUE(memory.mapImage(imagePath, Memory::MAP_COPY_ON_WRITE, address, granule, granule));
+
+		// Then:
+		EXPECT_EQ(memory[address - 1], 0x11);
+		EXPECT_EQ(memory[address], (granule * 7) & 0xFF);
+		EXPECT_EQ(memory[0xFFFF], ((granule * 2 - 1) * 7) & 0xFF);
+	}
+
+	/* Test bad mappings are refused and leave memory alone */
+	TEST_F(TestMemory, TestMapImageInvalid) {
+		// Given:
+		writeImage(MAX_MEM / 2);
+		memory[0x0000] = 0x42;
+
+		// Then: short file, missing file, past the end of memory
+		EXPECT_FALSE(memory.mapImage(imagePath));
+		EXPECT_FALSE(memory.mapImage("e6502_no_such_file.bin"));
+		EXPECT_FALSE(memory.mapImage(imagePath, Memory::MAP_COPY_ON_WRITE, 0x8000, MAX_MEM));
+
+		// Then: misaligned
+		if (Memory::mapGranularity() > 1) {
+			EXPECT_FALSE(memory.mapImage(imagePath, Memory::MAP_COPY_ON_WRITE, 0x0001, Memory::mapGranularity()));
+		}
+		EXPECT_EQ(memory[0x0000], 0x42);
+	}
+
+	/* Test page types and where CPU writes to each page go */
+	TEST_F(TestMemory, TestPageTypes) {
+		// Given: all RAM
+		EXPECT_EQ(memory.pageType(0x1234), Memory::PAGE_RAM);
+		EXPECT_EQ(memory.pageAt(0x1234).write, &memory[0x1200]);
+
+		// When:
+		memory.setRegionType(0xE000, 0x2000, Memory::PAGE_ROM);
+		memory.setPageType(0x80, Memory::PAGE_UNMAPPED);
+
+		// Then:
+		EXPECT_EQ(memory.pageType(0xDFFF), Memory::PAGE_RAM);
+		EXPECT_EQ(memory.pageType(0xE000), Memory::PAGE_ROM);
+		EXPECT_EQ(memory.pageType(0xFFFF), Memory::PAGE_ROM);
+		EXPECT_EQ(memory.pageType(0x8000), Memory::PAGE_UNMAPPED);
+
+		// When: written through the page table
+		memory[0xFFFC] = 0x12;					// Host writes always land
+		memory.pageAt(0xFFFC).write[0xFC] = 0x34;
+		memory.pageAt(0x80FF).write[0xFF] = 0x56;
+
+		// Then: protected pages are unchanged
+		EXPECT_EQ(memory[0xFFFC], 0x12);
+		EXPECT_EQ(memory[0x80FF], 0x00);
+		EXPECT_NE(memory.pageAt(0xFFFC).write, &memory[0xFF00]);
+
+		// When: back to RAM
+		memory.setPageType(0xFF, Memory::PAGE_RAM);
+		memory.pageAt(0xFFFC).write[0xFC] = 0x34;
+
+		// Then:
+		EXPECT_EQ(memory[0xFFFC], 0x34);
+	}
+
+	/* Test protected page writes can be trapped, and devices take priority */
+	TEST_F(TestMemory, TestWriteTrap) {
+		// Given:
+		MockDevice trap, device;
+		memory.setPageType(0xC0, Memory::PAGE_ROM);
+		memory.setPageType(0xC1, Memory::PAGE_ROM);
+		memory.mapDevice(0xC1, &device);
+		memory[0xC010] = 0x99;
+
+		// When:
+		memory.setWriteTrap(&trap);
+
+		// Then: reads of the ROM still see its data, writes go to the trap
+		Device* stand = memory.deviceAt(0xC010);
+		ASSERT_NE(stand, nullptr);
+		EXPECT_EQ(stand->read(0xC010), 0x99);
+		EXPECT_CALL(trap, write(0xC010, 0x42)).Times(1);
+		stand->write(0xC010, 0x42);
+		EXPECT_EQ(memory.deviceAt(0xC100), &device);
+		EXPECT_EQ(memory.deviceAt(0x1000), nullptr);
+		EXPECT_EQ(memory.mappedDevices().size(), 1);
+
+		// When:
+		memory.setWriteTrap(nullptr);
+
+		// Then:
+		EXPECT_EQ(memory.deviceAt(0xC010), nullptr);
+	}
 }
@@ -0,0 +1,100 @@
+#include <gmock/gmock.h>
+#include "types.h"
+#include "machine_test.h"
+#include "pacer.h"
+
+namespace E6502 {
+
+	class TestPacer : public TestMachine {
+	public:
+		virtual void SetUp() {
+			TestMachine::SetUp();
+			(*memory)[0x1000] = INS_JMP_ABS.opcode;	// Idle loop
+			(*memory)[0x1001] = 0x00;
+			(*memory)[0x1002] = 0x10;
+		}
+	};
+
+	/* Test the monotonic clock and sleeping to an absolute deadline */
+	TEST_F(TestPacer, TestSleepUntil) {
+		// Given:
+		u64 start = Pacer::now();
+
+		// When:
+		Pacer::sleepUntil(start + 5000000);
+		Pacer::sleepUntil(start);				// Already passed, returns straight away
+
+		// Then:
+		EXPECT_GE(Pacer::now() - start, 5000000);
+	}
+
+	/* Test 50ms of 1MHz cycles takes about 50ms */
+	TEST_F(TestPacer, TestRealTime) {
+		// Given:
+		Pacer pacer(cpu, Pacer::CLOCK_1MHZ, 1000);
+
+		// When:
+		u64 start = Pacer::now();
+		u8 reason = pacer.run(50000);
+		u64 elapsed = Pacer::now() - start;
+
+		// Then: never early, and generous on late for a busy host
+		const PacingStats& stats = pacer.getStats();
+		EXPECT_EQ(reason, CPUInternal::STOP_BUDGET);
+		EXPECT_GE(elapsed, 50000000);
+		EXPECT_LT(elapsed, 500000000);
+		EXPECT_EQ(stats.slices, 50);
+		EXPECT_EQ(stats.sleeps + stats.lateSlices, 50);
+		EXPECT_EQ(stats.emulated, 50001000);			// 16667 iterations of the 3 cycle loop
+		EXPECT_GE(stats.drift(), 0);
+		EXPECT_GE(stats.jitter(), 0);
+		EXPECT_GE((double)stats.maxWakeError, stats.meanWakeError());
+	}
+
+	/* Test a clock the host can't keep up with never sleeps and resyncs once too far behind */
+	TEST_F(TestPacer, TestLateness) {
+		// Given: 1ms of lateness allowed at an impossible clock rate
+		(*memory)[0x1000] = INS_NOP_IMP.opcode;
+		for (Word i = 0x1001; i < 0x1100; i++)
+			(*memory)[i] = INS_NOP_IMP.opcode;
+		(*memory)[0x1100] = INS_JMP_ABS.opcode;
+		(*memory)[0x1101] = 0x00;
+		(*memory)[0x1102] = 0x10;
+		cpu->setIdleMode(CPUInternal::IDLE_IGNORE);
+		Pacer pacer(cpu, 1000000000000ULL, 100000, 1000000);
+
+		// When:
+		pacer.run(2000000);
+
+		// Then:
+		const PacingStats& stats = pacer.getStats();
+		EXPECT_EQ(stats.sleeps, 0);
+		EXPECT_EQ(stats.lateSlices, stats.slices);
+		EXPECT_GT(stats.resyncs, 0);
+		EXPECT_GT(stats.drift(), 0);
+
+		// When:
+		pacer.resetStats();
+
+		// Then:
+		EXPECT_EQ(pacer.getStats().slices, 0);
+	}
+
+	/* Test a breakpoint on the first instruction of a slice stops the run */
+	TEST_F(TestPacer, TestBreakpointSliceBoundary) {
+		// Given: the first slice ends on the breakpoint (32 NOPs) at a fast clock
+		for (Word i = 0x1000; i < 0x1100; i++)
+			(*memory)[i] = INS_NOP_IMP.opcode;
+		cpu->setBreakpoint(0x1020, true);
+		Pacer pacer(cpu, 1000000000ULL, 64);
+
+		// When:
+		u8 reason = pacer.run(1000);
+
+		// Then:
+		EXPECT_EQ(reason, CPUInternal::STOP_BREAKPOINT);
+		EXPECT_EQ(state->PC, 0x1020);
+		EXPECT_EQ(cpu->getCycles(), 64);
+		EXPECT_EQ(pacer.getStats().slices, 2);			// The second stops before running anything
+	}
+}
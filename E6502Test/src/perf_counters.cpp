@@ -0,0 +1,118 @@
+#include <gmock/gmock.h>
+#include "types.h"
+#include "machine_test.h"
+#include "perf_counters.h"
+
+namespace E6502 {
+
+	class TestPerfCounters : public TestMachine {
+	public:
+		virtual void SetUp() {
+			TestMachine::SetUp();
+
+			Byte program[] = {
+				INS_LDX_IMM.opcode, 0x0F,				// $1000 LDX #$0F
+				INS_LDA_ABSX.opcode, 0xF0, 0x30,		// $1002 LDA $30F0,X	$30FF, same page
+				INS_INX_IMP.opcode,						// $1005 INX
+				INS_LDA_ABSX.opcode, 0xF0, 0x30,		// $1006 LDA $30F0,X	$3100, crosses (A = 0)
+				INS_INC_ABX.opcode, 0xF0, 0x30,			// $1009 INC $30F0,X	always 7 cycles
+				INS_JSR.opcode, 0x00, 0x20,				// $100C JSR $2000
+				INS_BEQ_REL.opcode, 0x00,				// $100F BEQ +0			taken
+				INS_BNE_REL.opcode, 0x00,				// $1011 BNE +0			not taken
+			};
+			Byte sub[] = { INS_PHA.opcode, INS_PLA.opcode, INS_RTS.opcode };
+			memory->loadProgram(0x1000, program, sizeof(program));
+			memory->loadProgram(0x2000, sub, sizeof(sub));
+		}
+	};
+
+#ifdef E6502_PERF_COUNTERS
+	/* Test each counter against a short program */
+	TEST_F(TestPerfCounters, TestCounters) {
+		// When:
+		u64 start = cpu->getCycles();
+		cpu->execute(11);
+		PerfCounters counters = cpu->getCounters();
+
+		// Then:
+		EXPECT_EQ(state->PC, 0x1013);
+		EXPECT_EQ(counters.instructions, 11);
+		EXPECT_EQ(counters.cycles, cpu->getCycles() - start);
+		EXPECT_EQ(counters.opcodes[INS_LDA_ABSX.opcode], 2);
+		EXPECT_EQ(counters.opcodes[INS_RTS.opcode], 1);
+		EXPECT_EQ(counters.pageCrosses, 1);
+		EXPECT_EQ(counters.branchesTaken, 1);
+		EXPECT_EQ(counters.branchesNotTaken, 1);
+		EXPECT_EQ(counters.interrupts, 0);
+		EXPECT_EQ(counters.stackLowWater, 0xFC);		// Return address then A
+		EXPECT_EQ(counters.stackHighWater(), 3);
+
+		// When:
+		cpu->resetCounters();
+
+		// Then:
+		EXPECT_EQ(cpu->getCounters().instructions, 0);
+		EXPECT_EQ(cpu->getCounters().opcodes[INS_LDA_ABSX.opcode], 0);
+	}
+
+	/* Test a taken branch into the next page and IRQ entry */
+	TEST_F(TestPerfCounters, TestBranchPageAndInterrupt) {
+		// Given:
+		(*memory)[0x10FD] = INS_BEQ_REL.opcode;
+		(*memory)[0x10FE] = 0x02;
+		(*memory)[CPUInternal::IRQ_VECTOR] = 0x00;
+		(*memory)[CPUInternal::IRQ_VECTOR + 1] = 0x40;
+		state->PC = 0x10FD;
+		state->FLAGS.bit.Z = 1;
+		state->FLAGS.bit.I = 0;
+
+		// When:
+		u8 branchCycles = cpu->execute(1);
+		cpu->setIRQ(0, true);
+		u8 irqCycles = cpu->execute(1);
+		PerfCounters counters = cpu->getCounters();
+
+		// Then:
+		EXPECT_EQ(state->PC, 0x4000);
+		EXPECT_EQ(counters.instructions, 1);
+		EXPECT_EQ(counters.branchesTaken, 1);
+		EXPECT_EQ(counters.pageCrosses, 1);
+		EXPECT_EQ(counters.interrupts, 1);
+		EXPECT_EQ(counters.cycles, branchCycles + irqCycles);
+		EXPECT_EQ(counters.stackHighWater(), 3);
+	}
+
+	/* Test fast forwarded idle loops count as the instructions they stand for */
+	TEST_F(TestPerfCounters, TestIdleSkip) {
+		// Given:
+		Byte loop[] = { INS_JMP_ABS.opcode, 0x00, 0x50 };
+		memory->loadProgram(0x5000, loop, sizeof(loop));
+		state->PC = 0x5000;
+
+		// When:
+		cpu->run(300);
+		PerfCounters counters = cpu->getCounters();
+
+		// Then:
+		EXPECT_EQ(counters.instructions, 100);
+		EXPECT_EQ(counters.opcodes[INS_JMP_ABS.opcode], 100);
+		EXPECT_EQ(counters.cycles, 300);
+		EXPECT_EQ(counters.branchesTaken, 0);
+	}
+#else
+	/* Test snapshots are empty when the counters aren't built in */
+	TEST_F(TestPerfCounters, TestCountersDisabled) {
+		// When:
+		cpu->execute(11);
+		PerfCounters counters = cpu->getCounters();
+
+		// Then:
+		EXPECT_EQ(state->PC, 0x1013);
+		EXPECT_EQ(counters.instructions, 0);
+		EXPECT_EQ(counters.cycles, 0);
+		EXPECT_EQ(counters.pageCrosses, 0);
+		EXPECT_EQ(counters.opcodes[INS_LDA_ABSX.opcode], 0);
+		EXPECT_EQ(counters.stackHighWater(), 0);
+	}
+#endif
+}
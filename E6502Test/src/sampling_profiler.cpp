@@ -0,0 +1,145 @@
+#include <gmock/gmock.h>
+#include <stdio.h>
+#include <string>
+#include "types.h"
+#include "machine_test.h"
+#include "call_profiler.h"
+#include "sampling_profiler.h"
+
+namespace E6502 {
+
+	class TestSamplingProfiler : public TestMachine {
+	public:
+		/* Everything written to <file> */
+		static std::string contents(FILE* file) {
+			std::string text(ftell(file), ' ');
+			rewind(file);
+			EXPECT_EQ(fread(&text[0], 1, text.size(), file), text.size());
+			fclose(file);
+			return text;
+		}
+	};
+
+	/* Test samples are taken at randomised intervals averaging the one asked for */
+	TEST_F(TestSamplingProfiler, TestInterval) {
+		// Given:
+		Byte program[] = {
+			INS_NOP_IMP.opcode,						// $1000 NOP
+			INS_JMP_ABS.opcode, 0x00, 0x10,			// $1001 JMP $1000
+		};
+		memory->loadProgram(0x1000, program, sizeof(program));
+		SamplingProfiler profiler(cpu, state, memory, 1000);
+		profiler.start();
+
+		// When:
+		cpu->run(1000000);
+		profiler.stop();
+		cpu->run(100000);
+
+		// Then:
+		const std::vector<Sample>& samples = profiler.getSamples();
+		EXPECT_NEAR((double)samples.size(), 1000.0, 50.0);
+		u64 shortest = ~0ULL;
+		u64 longest = 0;
+		for (size_t i = 0; i < samples.size(); i++) {
+			const Sample& sample = samples[i];
+			EXPECT_TRUE(sample.pc == 0x1000 || sample.pc == 0x1001);
+			EXPECT_EQ(sample.opcode, (*memory)[sample.pc]);
+			EXPECT_EQ(sample.function, -1);
+			if (i == 0) continue;
+			u64 gap = sample.cycle - samples[i - 1].cycle;
+			shortest = gap < shortest ? gap : shortest;
+			longest = gap > longest ? gap : longest;
+		}
+		EXPECT_GE(shortest, 500);
+		EXPECT_LT(shortest, 600);
+		EXPECT_GT(longest, 1400);
+		EXPECT_LE(longest, 1503);
+	}
+
+	/* Test samples are attributed to the subroutine the call profiler has on top of its stack */
+	TEST_F(TestSamplingProfiler, TestFunctions) {
+		// Given: main calls a subroutine that loops 255 times
+		Byte program[] = {
+			INS_JSR.opcode, 0x00, 0x20,				// $1000 JSR $2000
+			INS_JMP_ABS.opcode, 0x00, 0x10,			// $1003 JMP $1000
+		};
+		Byte sub[] = {
+			INS_DEX_IMP.opcode,						// $2000 DEX
+			INS_BNE_REL.opcode, 0xFD,				// $2001 BNE $2000
+			INS_RTS.opcode,							// $2003 RTS
+		};
+		memory->loadProgram(0x1000, program, sizeof(program));
+		memory->loadProgram(0x2000, sub, sizeof(sub));
+		CallProfiler calls(cpu);
+		calls.start();
+		SamplingProfiler profiler(cpu, state, memory, 100);
+		profiler.setCallProfiler(&calls);
+		profiler.start();
+
+		// When:
+		cpu->run(200000);
+		calls.finish();
+
+		// Then:
+		u64 inSub = 0;
+		for (const Sample& sample : profiler.getSamples()) {
+			if (sample.pc >= 0x2000) {
+				EXPECT_EQ(sample.function, 0x2000);
+				inSub++;
+			}
+			else {
+				EXPECT_EQ(sample.function, -1);
+			}
+		}
+		EXPECT_GT(inSub, profiler.getSamples().size() * 95 / 100);
+
+		FILE* file = tmpfile();
+		profiler.writeFunctions(file);
+		EXPECT_THAT(contents(file), testing::StartsWith("$2000 " + std::to_string(inSub) + " "));
+	}
+
+	/* Test samples are written against the listing, an idle loop being skipped still gets its share */
+	TEST_F(TestSamplingProfiler, TestListing) {
+		// Given:
+		Byte program[] = {
+			INS_LDX_IMM.opcode, 0x00,				// $1000 LDX #0
+			INS_JMP_ABS.opcode, 0x02, 0x10,			// $1002 end: JMP end
+		};
+		memory->loadProgram(0x1000, program, sizeof(program));
+		std::string text =
+			"   4 1000 a2 00        \tldx #0\n"
+			"   5                   end\n"
+			"   6 1002 4c 02 10     \tJMP end\n";
+		Listing listing;
+		listing.load(text.data(), text.size());
+		SamplingProfiler profiler(cpu, state, memory, 1000);
+		profiler.start();
+
+		// When:
+		cpu->run(100000);
+		Byte other[] = { INS_NOP_IMP.opcode, INS_JMP_ABS.opcode, 0x00, 0x30 };
+		memory->loadProgram(0x3000, other, sizeof(other));
+		state->PC = 0x3000;
+		cpu->run(2000);
+		profiler.stop();
+		FILE* file = tmpfile();
+		profiler.writeListing(listing, file);
+		std::string written = contents(file);
+
+		// Then:
+		const std::vector<Sample>& samples = profiler.getSamples();
+		u32 idle = 0;
+		for (const Sample& sample : samples)
+			if (sample.pc == 0x1002) idle++;
+		EXPECT_NEAR((double)idle, 100.0, 10.0);
+		EXPECT_LT(idle, samples.size());
+
+		char expected[200];
+		snprintf(expected, sizeof(expected), "%6u %5.1f%%    6 1002 4c 02 10     \tJMP end\n", idle, 100.0 * idle / samples.size());
+		EXPECT_THAT(written, testing::StartsWith("; " + std::to_string(samples.size()) + " samples, one every 1000 cycles on average\n"
+			"                 4 1000 a2 00        \tldx #0\n"
+			"                 5                   end\n" + expected + "; Not in the listing:\n"));
+		EXPECT_THAT(written, testing::HasSubstr("% $300"));
+	}
+}
@@ -0,0 +1,139 @@
+#include <gmock/gmock.h>
+#include <string.h>
+#include "types.h"
+#include "machine_test.h"
+#include "save_state.h"
+
+namespace E6502 {
+
+	class TestSaveState : public TestMachine {
+	public:
+		/* A loop that keeps changing registers and a page of memory */
+		void loadCounterProgram(Memory& target) {
+			Byte program[] = {
+				INS_INC_ABX.opcode, 0x00, 0x30,			// loop: INC $3000,X
+				INS_INX_IMP.opcode,
+				INS_JMP_ABS.opcode, 0x00, 0x10,			// JMP loop
+			};
+			target.loadProgram(0x1000, program, sizeof(program));
+		}
+	};
+
+	/* Test registers, cycles and memory survive a round trip */
+	TEST_F(TestSaveState, TestRoundTrip) {
+		// Given:
+		state->PC = 0x1234; state->SP = 0xAB; state->A = 1; state->X = 2; state->Y = 3; state->FLAGS.byte = 0xC3;
+		(*memory)[0x0000] = 0x11;
+		(*memory)[0x8080] = 0x22;
+		(*memory)[0xFFFF] = 0x33;
+
+		// When:
+		std::vector<Byte> buffer = SaveState::save(*state, *memory, 0x123456789ULL);
+		Memory restored;
+		restored[0x5000] = 0xEE;		// Should be cleared by the load
+		CPUState restoredState;
+		u64 cycles = 0;
+		bool ok = SaveState::load(buffer.data(), buffer.size(), restoredState, restored, cycles);
+
+		// Then: only three pages are stored
+		ASSERT_TRUE(ok);
+		EXPECT_EQ(buffer.size(), SaveState::HEADER_SIZE + SaveState::REGISTER_SIZE + SaveState::BITMAP_SIZE + 3 * 0x100);
+		EXPECT_EQ(restoredState, *state);
+		EXPECT_EQ(cycles, 0x123456789ULL);
+		EXPECT_EQ(memcmp(&restored[0], &(*memory)[0], MAX_MEM), 0);
+	}
+
+	/* Test an empty memory needs no pages */
+	TEST_F(TestSaveState, TestEmptyMemory) {
+		std::vector<Byte> buffer = SaveState::save(*state, *memory, 0);
+		EXPECT_EQ(buffer.size(), 64);
+		EXPECT_EQ(memcmp(buffer.data(), "E65S", 4), 0);
+	}
+
+	/* Test damaged or foreign buffers are rejected without changing anything */
+	TEST_F(TestSaveState, TestInvalid) {
+		// Given:
+		(*memory)[0x4000] = 0x99;
+		std::vector<Byte> buffer = SaveState::save(*state, *memory, 42);
+		CPUState target;
+		target.A = 0x77;
+		Memory targetMemory;
+		u64 cycles = 7;
+
+		// Then: truncated
+		EXPECT_FALSE(SaveState::load(buffer.data(), buffer.size() - 1, target, targetMemory, cycles));
+		EXPECT_FALSE(SaveState::load(buffer.data(), 10, target, targetMemory, cycles));
+
+		// Then: corrupted
+		std::vector<Byte> corrupt = buffer;
+		corrupt[corrupt.size() - 1] ^= 0x01;
+		EXPECT_FALSE(SaveState::load(corrupt.data(), corrupt.size(), target, targetMemory, cycles));
+
+		// Then: wrong magic and version
+		corrupt = buffer;
+		corrupt[0] = 'X';
+		EXPECT_FALSE(SaveState::load(corrupt.data(), corrupt.size(), target, targetMemory, cycles));
+		corrupt = buffer;
+		corrupt[4] = 99;
+		EXPECT_FALSE(SaveState::load(corrupt.data(), corrupt.size(), target, targetMemory, cycles));
+
+		// Then: nothing was touched
+		EXPECT_EQ(target.A, 0x77);
+		EXPECT_EQ(targetMemory[0x4000], 0x00);
+		EXPECT_EQ(cycles, 7);
+	}
+
+	/* Test a restored machine carries on exactly as the original */
+	TEST_F(TestSaveState, TestResume) {
+		// Given: a warmed up machine, saved
+		loadCounterProgram(*memory);
+		cpu->run(5000);
+		std::vector<Byte> buffer = SaveState::save(*state, *memory, cpu->getCycles());
+
+		// When: the original carries on
+		cpu->run(5000);
+
+		// And: a new machine is restored from the save and does the same
+		Memory copyMemory;
+		CPUState copyState;
+		CPUInternal copy(&copyState, &copyMemory, &InstructionUtils::loader);
+		u64 cycles = 0;
+		ASSERT_TRUE(SaveState::load(buffer.data(), buffer.size(), copyState, copyMemory, cycles));
+		copy.setCycles(cycles);
+		copy.run(5000);
+
+		// Then:
+		EXPECT_EQ(copyState, *state);
+		EXPECT_EQ(copy.getCycles(), cpu->getCycles());
+		EXPECT_EQ(memcmp(&copyMemory[0], &(*memory)[0], MAX_MEM), 0);
+	}
+
+	/* Test saving to and loading from a file */
+	TEST_F(TestSaveState, TestFile) {
+		// Given:
+		const char* path = "e6502_save_state_test.bin";
+		state->A = 0x42;
+		(*memory)[0x0200] = 0x24;
+
+		// When:
+		ASSERT_TRUE(SaveState::saveFile(path, *state, *memory, 1000));
+		CPUState loaded;
+		Memory loadedMemory;
+		u64 cycles = 0;
+		bool ok = SaveState::loadFile(path, loaded, loadedMemory, cycles);
+		remove(path);
+
+		// Then:
+		ASSERT_TRUE(ok);
+		EXPECT_EQ(loaded.A, 0x42);
+		EXPECT_EQ(loadedMemory[0x0200], 0x24);
+		EXPECT_EQ(cycles, 1000);
+		EXPECT_FALSE(SaveState::loadFile(path, loaded, loadedMemory, cycles));
+	}
+
+	/* Test the checksum against the known Adler-32 of "Wikipedia" */
+	TEST_F(TestSaveState, TestChecksum) {
+		EXPECT_EQ(SaveState::checksum((const Byte*)"Wikipedia", 9), 0x11E60398);
+		EXPECT_EQ(SaveState::checksum(nullptr, 0), 1);
+	}
+}
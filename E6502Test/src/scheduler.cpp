@@ -0,0 +1,143 @@
+#include <gmock/gmock.h>
+#include "types.h"
+#include "scheduler.h"
+
+namespace E6502 {
+
+	/* Event that records the order events fire in */
+	class OrderEvent : public Event {
+	public:
+		int id;
+		std::vector<int>* order;
+		OrderEvent(int id = 0, std::vector<int>* order = nullptr) : id(id), order(order) {}
+		virtual void fire(u64) { if (order != nullptr) order->push_back(id); }
+	};
+
+	/* Event that reschedules itself every <period> cycles */
+	class PeriodicEvent : public Event {
+	public:
+		Scheduler* scheduler;
+		u64 period;
+		int count = 0;
+		PeriodicEvent(Scheduler* scheduler, u64 period) : scheduler(scheduler), period(period) {}
+		virtual void fire(u64) {
+			count++;
+			scheduler->schedule(this, getDeadline() + period);
+		}
+	};
+
+	class TestScheduler : public testing::Test {
+	public:
+		Scheduler scheduler;
+		std::vector<int> order;
+	};
+
+	/* Test an empty scheduler has nothing due */
+	TEST_F(TestScheduler, TestEmpty) {
+		EXPECT_EQ(scheduler.size(), 0);
+		EXPECT_EQ(scheduler.nextDeadline(), Scheduler::NEVER);
+		scheduler.runDue(Scheduler::NEVER - 1);
+	}
+
+	/* Test events fire in deadline order and only once due */
+	TEST_F(TestScheduler, TestFireOrder) {
+		// Given:
+		const int count = 50;
+		std::vector<OrderEvent> events;
+		for (int i = 0; i < count; i++)
+			events.push_back(OrderEvent(i, &order));
+		for (int i = 0; i < count; i++)
+			scheduler.schedule(&events[i], 1000 + ((i * 37) % count) * 10);	// Scrambled deadlines
+
+		// Then:
+		EXPECT_EQ(scheduler.size(), count);
+		EXPECT_EQ(scheduler.nextDeadline(), 1000);
+
+		// When:
+		scheduler.runDue(999);
+
+		// Then: nothing is due yet
+		EXPECT_TRUE(order.empty());
+
+		// When:
+		scheduler.runDue(1245);
+
+		// Then: deadlines 1000 .. 1240
+		ASSERT_EQ(order.size(), 25);
+		for (size_t i = 1; i < order.size(); i++)
+			EXPECT_LT(events[order[i - 1]].getDeadline(), events[order[i]].getDeadline());
+		EXPECT_EQ(scheduler.nextDeadline(), 1250);
+
+		// When:
+		scheduler.runDue(Scheduler::NEVER - 1);
+
+		// Then:
+		EXPECT_EQ(order.size(), count);
+		EXPECT_EQ(scheduler.size(), 0);
+		for (int i = 0; i < count; i++)
+			EXPECT_FALSE(events[i].isScheduled());
+	}
+
+	/* Test a cancelled event never fires */
+	TEST_F(TestScheduler, TestCancel) {
+		// Given:
+		OrderEvent a(1, &order), b(2, &order), c(3, &order);
+		scheduler.schedule(&a, 10);
+		scheduler.schedule(&b, 20);
+		scheduler.schedule(&c, 30);
+
+		// When:
+		scheduler.cancel(&a);
+		scheduler.cancel(&a);		// Cancelling twice is harmless
+
+		// Then:
+		EXPECT_FALSE(a.isScheduled());
+		EXPECT_EQ(scheduler.size(), 2);
+		EXPECT_EQ(scheduler.nextDeadline(), 20);
+
+		// When:
+		scheduler.runDue(100);
+
+		// Then:
+		EXPECT_EQ(order, std::vector<int>({ 2, 3 }));
+	}
+
+	/* Test rescheduling moves an event earlier or later */
+	TEST_F(TestScheduler, TestReschedule) {
+		// Given:
+		OrderEvent a(1, &order), b(2, &order), c(3, &order);
+		scheduler.schedule(&a, 10);
+		scheduler.schedule(&b, 20);
+		scheduler.schedule(&c, 30);
+
+		// When:
+		scheduler.schedule(&a, 40);
+		scheduler.schedule(&c, 5);
+
+		// Then:
+		EXPECT_EQ(scheduler.size(), 3);
+		EXPECT_EQ(scheduler.nextDeadline(), 5);
+		EXPECT_EQ(a.getDeadline(), 40);
+
+		// When:
+		scheduler.runDue(100);
+
+		// Then:
+		EXPECT_EQ(order, std::vector<int>({ 3, 2, 1 }));
+	}
+
+	/* Test an event can reschedule itself while firing */
+	TEST_F(TestScheduler, TestPeriodic) {
+		// Given:
+		PeriodicEvent event(&scheduler, 100);
+		scheduler.schedule(&event, 100);
+
+		// When:
+		scheduler.runDue(1050);
+
+		// Then: fired at 100, 200 .. 1000 and is waiting for 1100
+		EXPECT_EQ(event.count, 10);
+		EXPECT_TRUE(event.isScheduled());
+		EXPECT_EQ(scheduler.nextDeadline(), 1100);
+	}
+}
@@ -0,0 +1,61 @@
+#include <gmock/gmock.h>
+#include <thread>
+#include <atomic>
+#include "types.h"
+#include "seqlock.h"
+
+namespace E6502 {
+
+	/* Value whose fields must always match each other */
+	struct SeqlockTestValue {
+		u64 a;
+		u32 b;
+		Byte c;
+	};
+
+	/* Test a stored value reads back */
+	TEST(TestSeqlock, TestStoreLoad) {
+		// Given:
+		Seqlock<SeqlockTestValue> lock;
+		EXPECT_EQ(lock.version(), 0);
+
+		// When:
+		lock.store(SeqlockTestValue{ 0x1122334455667788ULL, 0xAABBCCDD, 0x42 });
+
+		// Then:
+		SeqlockTestValue value = lock.load();
+		EXPECT_EQ(value.a, 0x1122334455667788ULL);
+		EXPECT_EQ(value.b, 0xAABBCCDD);
+		EXPECT_EQ(value.c, 0x42);
+		EXPECT_EQ(lock.version(), 1);
+	}
+
+	/* Test readers never see a half written value */
+	TEST(TestSeqlock, TestNoTornReads) {
+		// Given:
+		Seqlock<SeqlockTestValue> lock;
+		std::atomic<bool> done{ false };
+		std::atomic<int> torn{ 0 };
+		std::atomic<int> reads{ 0 };
+
+		// When: two readers sample while the writer publishes
+		auto reader = [&] {
+			while (!done) {
+				SeqlockTestValue value = lock.load();
+				if (value.b != (u32)value.a || value.c != (Byte)value.a) torn++;
+				reads++;
+			}
+		};
+		std::thread first(reader), second(reader);
+		for (u64 i = 1; i <= 200000; i++)
+			lock.store(SeqlockTestValue{ i, (u32)i, (Byte)i });
+		done = true;
+		first.join();
+		second.join();
+
+		// Then:
+		EXPECT_EQ(torn, 0);
+		EXPECT_GT(reads, 0);
+		EXPECT_EQ(lock.load().a, 200000);
+	}
+}
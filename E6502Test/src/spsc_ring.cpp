@@ -0,0 +1,79 @@
+#include <gmock/gmock.h>
+#include <thread>
+#include "types.h"
+#include "spsc_ring.h"
+
+namespace E6502 {
+
+	/* Test capacity is rounded up to a power of two */
+	TEST(TestSpscRing, TestCapacity) {
+		SpscRing<int> ring(5);
+		EXPECT_EQ(ring.capacity(), 8);
+		SpscRing<int> exact(16);
+		EXPECT_EQ(exact.capacity(), 16);
+	}
+
+	/* Test items come out in order and full / empty are reported */
+	TEST(TestSpscRing, TestPushPop) {
+		// Given:
+		SpscRing<int> ring(4);
+		int value = 0;
+		EXPECT_TRUE(ring.empty());
+		EXPECT_FALSE(ring.pop(value));
+		EXPECT_EQ(ring.peek(), nullptr);
+
+		// When:
+		for (int i = 0; i < 4; i++)
+			EXPECT_TRUE(ring.push(i));
+
+		// Then:
+		EXPECT_TRUE(ring.full());
+		EXPECT_FALSE(ring.push(99));
+		EXPECT_EQ(ring.size(), 4);
+		ASSERT_NE(ring.peek(), nullptr);
+		EXPECT_EQ(*ring.peek(), 0);
+
+		// When: wrapping around many times
+		for (int i = 4; i < 100; i++) {
+			ASSERT_TRUE(ring.pop(value));
+			EXPECT_EQ(value, i - 4);
+			ASSERT_TRUE(ring.push(i));
+		}
+
+		// Then:
+		for (int i = 96; i < 100; i++) {
+			ASSERT_TRUE(ring.pop(value));
+			EXPECT_EQ(value, i);
+		}
+		EXPECT_TRUE(ring.empty());
+	}
+
+	/* Test a producer and consumer on different threads see every item once and in order */
+	TEST(TestSpscRing, TestTwoThreads) {
+		// Given:
+		const int count = 200000;
+		SpscRing<int> ring(64);
+
+		// When:
+		std::thread producer([&ring] {
+			for (int i = 0; i < count; i++)
+				while (!ring.push(i)) std::this_thread::yield();
+		});
+		int expected = 0;
+		bool inOrder = true;
+		while (expected < count) {
+			int value;
+			if (!ring.pop(value)) {
+				std::this_thread::yield();
+				continue;
+			}
+			if (value != expected) inOrder = false;
+			expected++;
+		}
+		producer.join();
+
+		// Then:
+		EXPECT_TRUE(inOrder);
+		EXPECT_TRUE(ring.empty());
+	}
+}
@@ -0,0 +1,90 @@
+#include <gmock/gmock.h>
+#include <string>
+#include "types.h"
+#include "listing.h"
+#include "symbol_table.h"
+
+namespace E6502 {
+
+	class TestSymbolTable : public testing::Test {
+	public:
+		SymbolTable symbols;
+	};
+
+	/* Test labels on lines of their own take the next address in a numbered listing */
+	TEST_F(TestSymbolTable, TestHelloWorld) {
+		// Given:
+		Listing listing;
+		ASSERT_TRUE(listing.load(E6502_ASSEMBLY_DIR "helloworld.lst"));
+
+		// When:
+		symbols.add(listing);
+
+		// Then:
+		ASSERT_EQ(symbols.size(), 5);
+		EXPECT_EQ(symbols.value("start"), 0x1000);
+		EXPECT_EQ(symbols.value("loop"), 0x1002);
+		EXPECT_EQ(symbols.value("end"), 0x1009);
+		EXPECT_EQ(symbols.value("pushchar"), 0x100C);
+		EXPECT_EQ(symbols.value("data"), 0x1100);
+		EXPECT_EQ(symbols.symbolize(0x1000), "start");
+		EXPECT_EQ(symbols.symbolize(0x1005), "loop+$3");
+		EXPECT_EQ(symbols.symbolize(0x1108), "data+$8");
+		EXPECT_EQ(symbols.symbolize(0x0FFF), "$0FFF");
+		EXPECT_EQ(symbols.symbolize(0x1201), "$1201");
+
+		EXPECT_EQ(listing.lineAt(0x1003), 6);
+		EXPECT_EQ(listing.sourceText(listing.lineAt(0x1012 - 1)), "\trts;\t\t\t; return from subroutine");
+		EXPECT_EQ(listing.lineAt(0x1106), 25);
+		EXPECT_EQ(listing.lineAt(0x1012), -1);
+		EXPECT_EQ(listing.lineAt(0x0000), -1);
+	}
+
+	/* Test the functional test's AS65 listing, labels and equates come from the lines that define them */
+	TEST_F(TestSymbolTable, TestFunctionalTest) {
+		// When:
+		ASSERT_TRUE(symbols.load(E6502_ASSEMBLY_DIR "func_test.lst"));
+
+		// Then:
+		EXPECT_GT(symbols.size(), 300);
+		EXPECT_EQ(symbols.value("start"), 0x0400);
+		EXPECT_EQ(symbols.value("zpt"), 0x000C);
+		EXPECT_EQ(symbols.value("test_case"), 0x0200);
+		EXPECT_EQ(symbols.value("carry"), 0x01);
+		EXPECT_EQ(symbols.value("nosuchlabel"), -1);
+		EXPECT_EQ(symbols.symbolize(0x000C), "zpt");
+		EXPECT_EQ(symbols.symbolize(0x041F), "psb_forw+$5");
+		EXPECT_EQ(symbols.lookup(0x0001), nullptr);
+
+		const std::vector<Symbol>& labels = symbols.getLabels();
+		for (size_t i = 1; i < labels.size(); i++)
+			EXPECT_LE(labels[i - 1].address, labels[i].address);
+	}
+
+	/* Test symbols added by hand, the first name at an address and the first value of a name win */
+	TEST_F(TestSymbolTable, TestAdd) {
+		// When:
+		symbols.add("second", 0x2000);
+		symbols.add("first", 0x1000);
+		symbols.add("alias", 0x1000);
+		symbols.add("first", 0x3000);
+		symbols.add("constant", 0x1800, true);
+
+		// Then:
+		ASSERT_EQ(symbols.size(), 3);
+		EXPECT_EQ(symbols.lookup(0x1000)->name, "first");
+		EXPECT_EQ(symbols.symbolize(0x1801), "$1801");
+		EXPECT_EQ(symbols.symbolize(0x1801, 0x1000), "first+$801");
+		EXPECT_EQ(symbols.symbolize(0x2000), "second");
+		EXPECT_EQ(symbols.value("first"), 0x1000);
+		EXPECT_EQ(symbols.value("alias"), 0x1000);
+		EXPECT_EQ(symbols.value("constant"), 0x1800);
+
+		// When:
+		symbols.clear();
+
+		// Then:
+		EXPECT_EQ(symbols.size(), 0);
+		EXPECT_EQ(symbols.value("first"), -1);
+	}
+}
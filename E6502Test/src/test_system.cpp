@@ -15,6 +15,25 @@ namespace E6502 {
 
 	};
 
+	/* Test the vector page is only write protected when asked, as the protection covers all of $FF00-$FFFF */
+	TEST_F(TestSystem, TestProtectVectors) {
+		// Given:
+		char filename[] = E6502_ASSEMBLY_DIR "func_test.bin";
+		System plain(filename);
+		System protect(filename, true);
+
+		// When: the CPU writes below the vectors
+		plain.memory->pageAt(0xFF00).write[0x00] = 0x42;
+		protect.memory->pageAt(0xFF00).write[0x00] = 0x42;
+
+		// Then:
+		EXPECT_EQ(plain.memory->pageType(0xFF00), Memory::PAGE_RAM);
+		EXPECT_EQ((*plain.memory)[0xFF00], 0x42);
+		EXPECT_EQ(protect.memory->pageType(0xFF00), Memory::PAGE_ROM);
+		EXPECT_EQ((*protect.memory)[0xFF00], 0x00);
+		EXPECT_EQ((*protect.memory)[CPUState::DEFAULT_RESET_VECTOR], INS_JSR.opcode);
+	}
+
 	/* Test WIP Need at least Branch and inc sections before we can run the functional tests 
 	TEST_F(TestSystem, TestSystem) {
 		char* filename = "C:\\Users\\Chris\\source\\repos\\6502Emulator\\6502Emulator\\Assembly\\func_test.bin";
@@ -0,0 +1,177 @@
+#include <gmock/gmock.h>
+#include <string.h>
+#include "types.h"
+#include "machine_test.h"
+#include "time_travel.h"
+
+namespace E6502 {
+
+	class TestTimeTravel : public TestMachine {
+	public:
+		virtual void SetUp() {
+			TestMachine::SetUp();
+			loadProgram(*memory);
+		}
+
+		/* Clears X then loops incrementing a byte in page $30, 12 cycles per loop */
+		void loadProgram(Memory& target) {
+			Byte program[] = {
+				INS_LDX_IMM.opcode, 0x00,
+				INS_INC_ABX.opcode, 0x00, 0x30,			// loop: INC $3000,X
+				INS_INX_IMP.opcode,
+				INS_JMP_ABS.opcode, 0x02, 0x10,			// JMP loop
+			};
+			target.loadProgram(0x1000, program, sizeof(program));
+		}
+
+		/* A second machine running the same program one instruction at a time to <cycle> */
+		struct Reference {
+			Memory memory;
+			CPUState state;
+			CPUInternal cpu;
+
+			Reference(TestTimeTravel* test, u64 cycle) : cpu(&state, &memory, &InstructionUtils::loader) {
+				cpu.reset();
+				test->loadProgram(memory);
+				state.PC = 0x1000;
+				while (cpu.getCycles() < cycle) cpu.execute(1);
+			}
+		};
+
+		/* Checks the machine matches a reference run to the same cycle */
+		void expectMatchesReference() {
+			Reference reference(this, cpu->getCycles());
+			EXPECT_EQ(reference.cpu.getCycles(), cpu->getCycles());
+			EXPECT_EQ(reference.state, *state);
+			EXPECT_EQ(memcmp(&reference.memory[0x0000], &(*memory)[0x0000], MAX_MEM), 0);
+		}
+	};
+
+	/* Test stepping back returns to the instruction before, repeatedly and across checkpoints */
+	TEST_F(TestTimeTravel, TestStepBack) {
+		// Given: checkpoints every 1000 cycles
+		TimeTravel travel(cpu, state, memory, 1000);
+		travel.run(5000);
+		u64 end = cpu->getCycles();
+
+		// When:
+		ASSERT_TRUE(travel.stepBack());
+
+		// Then: the last instruction was one of the loop's
+		EXPECT_LT(cpu->getCycles(), end);
+		EXPECT_GE(cpu->getCycles(), end - 7);
+		expectMatchesReference();
+
+		// When: back past a checkpoint
+		for (int i = 0; i < 200; i++)
+			ASSERT_TRUE(travel.stepBack());
+
+		// Then:
+		EXPECT_LT(cpu->getCycles(), end - 600);
+		expectMatchesReference();
+
+		// When: running forward again
+		u64 back = cpu->getCycles();
+		travel.run(end - back);
+
+		// Then:
+		EXPECT_EQ(cpu->getCycles(), end);
+		expectMatchesReference();
+	}
+
+	/* Test stepping back from the start fails without changing anything */
+	TEST_F(TestTimeTravel, TestStepBackAtStart) {
+		// Given:
+		TimeTravel travel(cpu, state, memory, 1000);
+		travel.run(0);
+
+		// Then:
+		EXPECT_EQ(travel.size(), 1u);
+		EXPECT_FALSE(travel.stepBack());
+		EXPECT_EQ(cpu->getCycles(), 0u);
+		EXPECT_EQ(state->PC, 0x1000);
+	}
+
+	/* Test running back finds the most recent breakpoint, even when it is several checkpoints back */
+	TEST_F(TestTimeTravel, TestRunBackToBreakpoint) {
+		// Given:
+		TimeTravel travel(cpu, state, memory, 1000);
+		travel.run(10000);
+		u64 end = cpu->getCycles();
+
+		// When: the INX is reached 7 cycles into each 12 cycle loop (after the 2 cycle LDX)
+		cpu->setBreakpoint(0x1005, true);
+		ASSERT_TRUE(travel.runBackToBreakpoint());
+
+		// Then:
+		EXPECT_EQ(state->PC, 0x1005);
+		EXPECT_EQ((cpu->getCycles() - 2) % 12, 7u);
+		EXPECT_LT(cpu->getCycles(), end);
+		EXPECT_GE(cpu->getCycles(), end - 12);
+		expectMatchesReference();
+
+		// When: again, from on the breakpoint
+		u64 first = cpu->getCycles();
+		ASSERT_TRUE(travel.runBackToBreakpoint());
+
+		// Then: the loop before
+		EXPECT_EQ(cpu->getCycles(), first - 12);
+
+		// When: only the first instruction has a breakpoint
+		cpu->setBreakpoint(0x1005, false);
+		cpu->setBreakpoint(0x1000, true);
+		ASSERT_TRUE(travel.runBackToBreakpoint());
+
+		// Then:
+		EXPECT_EQ(cpu->getCycles(), 0u);
+		expectMatchesReference();
+	}
+
+	/* Test the machine is left alone when no breakpoint was reached */
+	TEST_F(TestTimeTravel, TestRunBackNoBreakpoint) {
+		// Given:
+		TimeTravel travel(cpu, state, memory, 1000);
+		travel.run(3500);
+		u64 end = cpu->getCycles();
+		cpu->setBreakpoint(0x2000, true);
+
+		// When:
+		bool found = travel.runBackToBreakpoint();
+
+		// Then:
+		EXPECT_FALSE(found);
+		EXPECT_EQ(cpu->getCycles(), end);
+		expectMatchesReference();
+	}
+
+	/* Test the ring is bounded by count and by memory, dropping the oldest checkpoints */
+	TEST_F(TestTimeTravel, TestBounded) {
+		// Given:
+		TimeTravel counted(cpu, state, memory, 1000, 4);
+
+		// When:
+		counted.run(20000);
+
+		// Then:
+		EXPECT_EQ(counted.size(), 4u);
+		EXPECT_GE(counted.oldestCycle(), 16000u);
+
+		// Given: room for the shadow copy and two pages of undo records
+		counted.clear();
+		TimeTravel sized(cpu, state, memory, 1000, 256, MAX_MEM + 2 * 0x101);
+
+		// When:
+		sized.run(20000);
+
+		// Then: each checkpoint only changes page $30, so two records fit
+		EXPECT_EQ(sized.size(), 3u);
+		EXPECT_LE(sized.bytesUsed(), (size_t)MAX_MEM + 2 * 0x101);
+
+		// When: stepping back past the oldest
+		while (sized.stepBack()) {}
+
+		// Then:
+		EXPECT_EQ(cpu->getCycles(), sized.oldestCycle());
+		expectMatchesReference();
+	}
+}
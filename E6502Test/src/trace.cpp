@@ -0,0 +1,186 @@
+#include <gmock/gmock.h>
+#include <stdio.h>
+#include "types.h"
+#include "machine_test.h"
+#include "trace.h"
+
+namespace E6502 {
+
+	class TestTrace : public TestMachine {
+	public:
+		FILE* file = nullptr;
+
+		/* Passes each instruction on to the writer and keeps a copy to check the file against */
+		struct Recorder : public Tracer {
+			Tracer* writer = nullptr;
+			std::vector<TraceRecord> records;
+			virtual void trace(const CPUState& state, u64 cycle, Byte opcode) {
+				TraceRecord record;
+				record.state = state;
+				record.cycle = cycle;
+				record.opcode = opcode;
+				records.push_back(record);
+				writer->trace(state, cycle, opcode);
+			}
+		};
+
+		virtual void SetUp() {
+			TestMachine::SetUp();
+			file = tmpfile();
+			ASSERT_NE(file, nullptr);
+
+			// Counts through page $30 with A and Y changing along the way
+			Byte program[] = {
+				INS_LDX_IMM.opcode, 0x00,
+				INS_INC_ABX.opcode, 0x00, 0x30,			// loop: INC $3000,X
+				INS_LDA_ABSX.opcode, 0x00, 0x30,		// LDA $3000,X
+				INS_INX_IMP.opcode,
+				INS_BNE_REL.opcode, 0xF7,				// BNE loop
+				INS_INY_IMP.opcode,
+				INS_JMP_ABS.opcode, 0x02, 0x10,			// JMP loop
+			};
+			memory->loadProgram(0x1000, program, sizeof(program));
+		}
+
+		virtual void TearDown() {
+			fclose(file);
+			TestMachine::TearDown();
+		}
+
+		/* The whole file */
+		std::vector<Byte> readFile() {
+			fseek(file, 0, SEEK_END);
+			std::vector<Byte> bytes(ftell(file));
+			rewind(file);
+			EXPECT_EQ(fread(bytes.data(), 1, bytes.size(), file), bytes.size());
+			return bytes;
+		}
+
+		static void expectSame(const TraceRecord& expected, const TraceRecord& actual) {
+			EXPECT_EQ(expected.cycle, actual.cycle);
+			EXPECT_EQ(expected.state, actual.state);
+			EXPECT_EQ(expected.opcode, actual.opcode);
+		}
+	};
+
+	/* Test the codec round trips repetitive and random data */
+	TEST_F(TestTrace, TestCompression) {
+		// Given:
+		std::vector<Byte> repetitive;
+		for (int i = 0; i < 100000; i++) repetitive.push_back((Byte)(i % 7 == 0 ? i / 7 : i % 7));
+		std::vector<Byte> random;
+		u32 seed = 12345;
+		for (int i = 0; i < 10000; i++) {
+			seed = seed * 1103515245 + 12345;
+			random.push_back((Byte)(seed >> 16));
+		}
+
+		for (const std::vector<Byte>* input : { &repetitive, &random }) {
+			// When:
+			std::vector<Byte> compressed;
+			TraceFormat::compress(input->data(), input->size(), compressed);
+			std::vector<Byte> output(input->size());
+			bool ok = TraceFormat::decompress(compressed.data(), compressed.size(), output.data(), output.size());
+
+			// Then:
+			EXPECT_TRUE(ok);
+			EXPECT_EQ(output, *input);
+		}
+
+		// Then: corrupt data is rejected rather than overrunning the output
+		std::vector<Byte> compressed;
+		TraceFormat::compress(repetitive.data(), repetitive.size(), compressed);
+		std::vector<Byte> small(100);
+		EXPECT_FALSE(TraceFormat::decompress(compressed.data(), compressed.size(), small.data(), small.size()));
+	}
+
+	/* Test every instruction is written and read back, across chunks */
+	TEST_F(TestTrace, TestRoundTrip) {
+		// Given:
+		TraceWriter writer(file, 1000);
+		Recorder recorder;
+		recorder.writer = &writer;
+		cpu->setTracer(&recorder);
+		ASSERT_TRUE(writer.start());
+
+		// When:
+		cpu->run(100000);
+		ASSERT_TRUE(writer.finish());
+		std::vector<Byte> bytes = readFile();
+		TraceReader reader;
+
+		// Then:
+		ASSERT_TRUE(reader.open(bytes.data(), bytes.size()));
+		EXPECT_EQ(reader.records(), recorder.records.size());
+		EXPECT_EQ(writer.records(), recorder.records.size());
+		EXPECT_EQ(writer.bytesWritten(), bytes.size());
+		EXPECT_EQ(reader.chunkCount(), (recorder.records.size() + 999) / 1000);
+		size_t next = 0;
+		std::vector<TraceRecord> records;
+		for (size_t chunk = 0; chunk < reader.chunkCount(); chunk++) {
+			ASSERT_TRUE(reader.readChunk(chunk, records));
+			for (const TraceRecord& record : records)
+				expectSame(recorder.records[next++], record);
+		}
+		EXPECT_EQ(next, recorder.records.size());
+
+		// Then: even with small chunks, under 2 bytes an instruction (a whole record is 16)
+		EXPECT_LT(bytes.size(), recorder.records.size() * 2);
+	}
+
+	/* Test seeking to a cycle decodes the instruction running then */
+	TEST_F(TestTrace, TestSeek) {
+		// Given:
+		TraceWriter writer(file, 500);
+		Recorder recorder;
+		recorder.writer = &writer;
+		cpu->setTracer(&recorder);
+		writer.start();
+		cpu->run(50000);
+		writer.finish();
+		std::vector<Byte> bytes = readFile();
+		TraceReader reader;
+		ASSERT_TRUE(reader.open(bytes.data(), bytes.size()));
+
+		// When:
+		TraceRecord found;
+		for (size_t i : { (size_t)0, (size_t)499, (size_t)500, (size_t)3210, recorder.records.size() - 1 }) {
+			const TraceRecord& expected = recorder.records[i];
+
+			// Then: at the start of the instruction and during it
+			ASSERT_TRUE(reader.seek(expected.cycle, found));
+			expectSame(expected, found);
+			ASSERT_TRUE(reader.seek(expected.cycle + 1, found));
+			expectSame(expected, found);
+		}
+		EXPECT_EQ(reader.findChunk(recorder.records[3210].cycle), 6);
+	}
+
+	/* Test a trace whose writer didn't finish is read by walking the chunks */
+	TEST_F(TestTrace, TestUnfinished) {
+		// Given:
+		TraceWriter writer(file, 100);
+		cpu->setTracer(&writer);
+		writer.start();
+		cpu->run(5000);
+		u64 traced = writer.records();
+		writer.finish();
+		std::vector<Byte> bytes = readFile();
+
+		// When: the index and footer are lost, along with part of the last chunk
+		TraceReader reader;
+		size_t chunks = (size_t)((traced + 99) / 100);
+		size_t indexSize = chunks * TraceFormat::INDEX_ENTRY_SIZE + TraceFormat::FOOTER_SIZE;
+		bool ok = reader.open(bytes.data(), bytes.size() - indexSize - 1);
+
+		// Then:
+		ASSERT_TRUE(ok);
+		EXPECT_EQ(reader.chunkCount(), chunks - 1);
+
+		// When: not a trace
+		bytes[0] = 'X';
+
+		// Then:
+		EXPECT_FALSE(reader.open(bytes.data(), bytes.size()));
+	}
+}
@@ -0,0 +1,201 @@
+#include <gmock/gmock.h>
+#include <stdio.h>
+#include <string>
+#include "types.h"
+#include "cpu.h"
+#include "trace.h"
+#include "trace_analysis.h"
+#include "mapped_file.h"
+#include "instructions/instruction_utils.h"
+
+namespace E6502 {
+
+	class TestTraceAnalysis : public testing::Test {
+	public:
+
+		/* Keeps a copy of each instruction as well as writing it */
+		struct Recorder : public Tracer {
+			Tracer* writer = nullptr;
+			std::vector<TraceRecord> records;
+			virtual void trace(const CPUState& state, u64 cycle, Byte opcode) {
+				TraceRecord record;
+				record.state = state;
+				record.cycle = cycle;
+				record.opcode = opcode;
+				records.push_back(record);
+				writer->trace(state, cycle, opcode);
+			}
+		};
+
+		/* A finished trace and the instructions that went into it */
+		struct Traced {
+			std::vector<Byte> bytes;
+			std::vector<TraceRecord> records;
+			TraceReader reader;
+		};
+
+		/**
+		 * Traces <cycles> of a loop counting through page $30 in chunks of <chunkRecords>. If <pokeCycle> is
+		 * set, $3005 is changed once the CPU gets there, so the trace differs from then on.
+		 */
+		static void traceProgram(Traced& out, u64 cycles, size_t chunkRecords, u64 pokeCycle = 0) {
+			Memory memory;
+			CPUState state;
+			CPUInternal cpu(&state, &memory, &InstructionUtils::loader);
+			cpu.reset();
+			state.PC = 0x1000;
+			Byte program[] = {
+				INS_LDX_IMM.opcode, 0x00,
+				INS_INC_ABX.opcode, 0x00, 0x30,			// loop: INC $3000,X
+				INS_LDA_ABSX.opcode, 0x00, 0x30,		// LDA $3000,X
+				INS_INX_IMP.opcode,
+				INS_BNE_REL.opcode, 0xF7,				// BNE loop
+				INS_INY_IMP.opcode,
+				INS_JMP_ABS.opcode, 0x02, 0x10,			// JMP loop
+			};
+			memory.loadProgram(0x1000, program, sizeof(program));
+
+			FILE* file = tmpfile();
+			ASSERT_NE(file, nullptr);
+			TraceWriter writer(file, chunkRecords);
+			Recorder recorder;
+			recorder.writer = &writer;
+			cpu.setTracer(&recorder);
+			ASSERT_TRUE(writer.start());
+			if (pokeCycle != 0) {
+				cpu.run(pokeCycle);
+				memory[0x3005] = 0x80;
+				cpu.run(cycles - pokeCycle);
+			}
+			else {
+				cpu.run(cycles);
+			}
+			ASSERT_TRUE(writer.finish());
+
+			fseek(file, 0, SEEK_END);
+			out.bytes.resize(ftell(file));
+			rewind(file);
+			ASSERT_EQ(fread(out.bytes.data(), 1, out.bytes.size(), file), out.bytes.size());
+			fclose(file);
+			out.records = recorder.records;
+			ASSERT_TRUE(out.reader.open(out.bytes.data(), out.bytes.size()));
+		}
+	};
+
+	/* Test the profile counts every instruction the same however many threads share the chunks */
+	TEST_F(TestTraceAnalysis, TestProfile) {
+		// Given:
+		Traced traced;
+		traceProgram(traced, 50000, 700);
+		TraceProfile expected;
+		for (size_t i = 0; i < traced.records.size(); i++) {
+			const TraceRecord& record = traced.records[i];
+			expected.opcodeCounts[record.opcode]++;
+			expected.executed[record.state.PC]++;
+			expected.stackDepth[record.state.SP]++;
+			if (i + 1 < traced.records.size())
+				expected.opcodeCycles[record.opcode] += traced.records[i + 1].cycle - record.cycle;
+		}
+
+		for (unsigned threads = 1; threads <= 4; threads += 3) {
+			// When:
+			TraceProfile profile;
+			ASSERT_TRUE(TraceAnalysis::profile(traced.reader, profile, threads));
+
+			// Then:
+			EXPECT_EQ(profile.instructions, traced.records.size());
+			EXPECT_EQ(profile.cycles, traced.records.back().cycle - traced.records.front().cycle);
+			for (int i = 0; i < 0x100; i++) {
+				EXPECT_EQ(profile.opcodeCounts[i], expected.opcodeCounts[i]);
+				EXPECT_EQ(profile.opcodeCycles[i], expected.opcodeCycles[i]);
+				EXPECT_EQ(profile.stackDepth[i], expected.stackDepth[i]);
+			}
+			EXPECT_EQ(profile.executed, expected.executed);
+		}
+	}
+
+	/* Test hot spots come busiest first, ties by address */
+	TEST_F(TestTraceAnalysis, TestHotSpots) {
+		// Given:
+		Traced traced;
+		traceProgram(traced, 20000, 1000);
+		TraceProfile profile;
+		ASSERT_TRUE(TraceAnalysis::profile(traced.reader, profile, 2));
+
+		// When:
+		std::vector<HotSpot> spots = TraceAnalysis::hotSpots(profile, 4);
+		std::vector<HotSpot> all = TraceAnalysis::hotSpots(profile, 100);
+
+		// Then: the four loop instructions run equally often (give or take the loop being cut off)
+		ASSERT_EQ(spots.size(), 4);
+		EXPECT_EQ(spots[0].address, 0x1002);
+		for (const HotSpot& spot : spots) {
+			EXPECT_GE(spot.address, 0x1002);
+			EXPECT_LE(spot.address, 0x1009);
+			EXPECT_EQ(spot.count, profile.executed[spot.address]);
+		}
+
+		// Then: every executed address is listed, LDX and INY/JMP below the loop
+		ASSERT_EQ(all.size(), 7);
+		for (size_t i = 1; i < all.size(); i++) {
+			EXPECT_GE(all[i - 1].count, all[i].count);
+			if (all[i - 1].count == all[i].count) {
+				EXPECT_LT(all[i - 1].address, all[i].address);
+			}
+		}
+		EXPECT_EQ(all.back().address, 0x1000);
+		EXPECT_EQ(all.back().count, 1);
+	}
+
+	/* Test the first difference between traces is found wherever it falls */
+	TEST_F(TestTraceAnalysis, TestFirstDivergence) {
+		// Given: the same run, a shorter run and one where memory is changed part way through
+		Traced traced, same, shorter, changed;
+		traceProgram(traced, 60000, 500);
+		traceProgram(same, 60000, 300);
+		traceProgram(shorter, 30000, 500);
+		traceProgram(changed, 60000, 500, 40000);
+		s64 expectedChange = -1;
+		for (size_t i = 0; i < changed.records.size() && expectedChange < 0; i++)
+			if (!(changed.records[i].state == traced.records[i].state)) expectedChange = (s64)i;
+		ASSERT_GT(expectedChange, 0);
+
+		// When/Then: chunk sizes don't have to line up
+		for (unsigned threads = 1; threads <= 4; threads += 3) {
+			EXPECT_EQ(TraceAnalysis::firstDivergence(traced.reader, same.reader, threads), -1);
+			EXPECT_EQ(TraceAnalysis::firstDivergence(traced.reader, shorter.reader, threads), (s64)shorter.records.size());
+			EXPECT_EQ(TraceAnalysis::firstDivergence(shorter.reader, traced.reader, threads), (s64)shorter.records.size());
+			EXPECT_EQ(TraceAnalysis::firstDivergence(traced.reader, changed.reader, threads), expectedChange);
+			EXPECT_EQ(TraceAnalysis::firstDivergence(changed.reader, traced.reader, threads), expectedChange);
+		}
+	}
+
+	/* Test a trace can be read straight from a mapped file */
+	TEST_F(TestTraceAnalysis, TestMappedFile) {
+		// Given:
+		Traced traced;
+		traceProgram(traced, 10000, 1000);
+		std::string path = "trace_analysis_mapped.e65t";
+		FILE* fp;
+		ASSERT_EQ(fopen_s(&fp, path.c_str(), "wb"), 0);
+		fwrite(traced.bytes.data(), 1, traced.bytes.size(), fp);
+		fclose(fp);
+
+		// When:
+		MappedFile file;
+		bool opened = file.open(path.c_str());
+		TraceReader reader;
+		bool read = opened && reader.open(file.data(), file.size());
+
+		// Then:
+		EXPECT_TRUE(opened);
+		EXPECT_EQ(file.size(), traced.bytes.size());
+		EXPECT_TRUE(read);
+		EXPECT_EQ(reader.records(), traced.records.size());
+		EXPECT_EQ(TraceAnalysis::firstDivergence(reader, traced.reader), -1);
+		EXPECT_FALSE(file.open("no_such_trace.e65t"));
+		EXPECT_EQ(file.size(), 0);
+		file.close();
+		remove(path.c_str());
+	}
+}
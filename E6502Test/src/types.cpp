@@ -25,6 +25,10 @@ namespace E6502 {
 		EXPECT_EQ(sizeof(s8), 1);
 		EXPECT_EQ(sizeof(u16), 2);
 		EXPECT_EQ(sizeof(s16), 2);
+		EXPECT_EQ(sizeof(u32), 4);
+		EXPECT_EQ(sizeof(s32), 4);
+		EXPECT_EQ(sizeof(u64), 8);
+		EXPECT_EQ(sizeof(s64), 8);
 	}
 
 	/* Test unsigned types are indeed unsigned */
@@ -40,6 +44,10 @@ namespace E6502 {
 
 		u16 test16 = -1;
 		EXPECT_TRUE(test16 >= 0);
+
+		u64 test64 = -1;
+		EXPECT_EQ(test64, 0xFFFFFFFFFFFFFFFFULL);
+		EXPECT_EQ(sizeof(u64), 8);
 	}
 
 	/* Test signed types are indeed signed */
@@ -49,6 +57,12 @@ namespace E6502 {
 
 		s16 test16 = -1;
 		EXPECT_TRUE(test16 < 0);
+
+		s32 test32 = -1;
+		EXPECT_TRUE(test32 < 0);
+
+		s64 test64 = -1;
+		EXPECT_TRUE(test64 < 0);
 	}
 	
 	/* Test CPUState reset */
@@ -0,0 +1,104 @@
+#include <gmock/gmock.h>
+#include "types.h"
+#include "machine_test.h"
+#include "write_log.h"
+
+namespace E6502 {
+
+	class TestWriteLog : public TestMachine {};
+
+	/* Test the CPU logs instruction writes with the instruction's address and cycle */
+	TEST_F(TestWriteLog, TestCPUWrites) {
+		// Given: a loop incrementing each byte of page $30 in turn, 12 cycles a loop
+		Byte program[] = {
+			INS_LDX_IMM.opcode, 0x00,
+			INS_INC_ABX.opcode, 0x00, 0x30,			// loop: INC $3000,X
+			INS_INX_IMP.opcode,
+			INS_JMP_ABS.opcode, 0x02, 0x10,			// JMP loop
+		};
+		memory->loadProgram(0x1000, program, sizeof(program));
+		WriteLog log;
+		cpu->setWriteLog(&log);
+
+		// When: 600 loops, X wraps twice
+		cpu->run(2 + 600 * 12);
+
+		// Then: only the INC writes
+		EXPECT_EQ(log.size(), 600u);
+		std::vector<WriteRecord> writers;
+		ASSERT_EQ(log.lastWriters(0x3005, 10, writers), 3u);
+		for (int i = 0; i < 3; i++) {
+			EXPECT_EQ(writers[i].pc, 0x1002);
+			EXPECT_EQ(writers[i].address, 0x3005);
+			EXPECT_EQ(writers[i].newValue, 3 - i);
+			EXPECT_EQ(writers[i].oldValue, 2 - i);
+			EXPECT_EQ(writers[i].cycle, 2u + (5 + 256 * (2 - i)) * 12);
+		}
+		EXPECT_EQ(log.lastWriters(0x3100, 10, writers), 0u);
+		EXPECT_TRUE(writers.empty());
+
+		// When: only the last one is wanted
+		log.lastWriters(0x3005, 1, writers);
+
+		// Then:
+		ASSERT_EQ(writers.size(), 1u);
+		EXPECT_EQ(writers[0].newValue, 3);
+
+		// When: logging is turned off
+		cpu->setWriteLog(nullptr);
+		cpu->run(120);
+
+		// Then:
+		EXPECT_EQ(log.size(), 600u);
+	}
+
+	/* Test lookups follow the links across chunks */
+	TEST_F(TestWriteLog, TestAcrossChunks) {
+		// Given: 4 chunks of writes, $1234 written every 1000
+		WriteLog log;
+		u64 total = WriteLog::CHUNK_SIZE * 4;
+		for (u64 i = 0; i < total; i++) {
+			Word address = (i % 1000 == 0) ? 0x1234 : (Word)(0x2000 + i % 0x800);
+			log.record(i, 0x0400, address, (Byte)(i - 1), (Byte)i);
+		}
+
+		// When:
+		std::vector<WriteRecord> writers;
+		size_t found = log.lastWriters(0x1234, 1000, writers);
+
+		// Then: every one of them, newest first
+		EXPECT_EQ(found, (size_t)((total + 999) / 1000));
+		u64 expected = ((total - 1) / 1000) * 1000;
+		for (const WriteRecord& record : writers) {
+			ASSERT_EQ(record.cycle, expected);
+			expected -= 1000;
+		}
+		EXPECT_EQ(log.at(12345).cycle, 12345u);
+	}
+
+	/* Test a bounded log drops the oldest chunk and lookups stop at it */
+	TEST_F(TestWriteLog, TestBounded) {
+		// Given:
+		WriteLog log(2);
+
+		// When: three chunks and a bit
+		u64 total = WriteLog::CHUNK_SIZE * 3 + 10;
+		for (u64 i = 0; i < total; i++)
+			log.record(i, 0x0400, (Word)(i % 0x100), 0, 0);
+
+		// Then: the first two chunks are gone
+		EXPECT_EQ(log.size(), total);
+		EXPECT_EQ(log.firstIndex(), WriteLog::CHUNK_SIZE * 2);
+		std::vector<WriteRecord> writers;
+		log.lastWriters(0x0005, 100000, writers);
+		EXPECT_EQ(writers.size(), (WriteLog::CHUNK_SIZE + 10) / 0x100 + 1);
+		EXPECT_GE(writers.back().cycle, (u64)WriteLog::CHUNK_SIZE * 2);
+
+		// When:
+		log.clear();
+
+		// Then:
+		EXPECT_EQ(log.size(), 0u);
+		EXPECT_EQ(log.lastWriters(0x0005, 10, writers), 0u);
+	}
+}
@@ -0,0 +1,181 @@
+/**
+ * e6502trace - offline analysis of trace files written by TraceWriter.
+ *
+ *   e6502trace [-j threads] stats <trace>              Instruction and cycle totals, opcode histogram, stack use
+ *   e6502trace [-j threads] hot <trace> [count]        Addresses the most instructions started at
+ *   e6502trace [-j threads] heatmap <trace> [out.csv]  Fetch heatmap, a row of 256 counts per page
+ *   e6502trace [-j threads] diff <trace> <trace>       First instruction that differs between two traces
+ *
+ * -l <listing> names addresses in hot and diff output after the labels in an assembler listing (AS65 or numbered).
+ * Traces are mapped rather than read in and chunks are analysed in parallel (one thread per core by default).
+ * Exit status is 0 on success (or identical traces), 2 if diff found a difference and 1 on an error.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "mapped_file.h"
+#include "trace.h"
+#include "trace_analysis.h"
+#include "symbol_table.h"
+
+using namespace E6502;
+
+static int usage() {
+	fprintf(stderr,
+		"usage: e6502trace [-j threads] [-l listing] stats <trace>\n"
+		"       e6502trace [-j threads] [-l listing] hot <trace> [count]\n"
+		"       e6502trace [-j threads] [-l listing] heatmap <trace> [out.csv]\n"
+		"       e6502trace [-j threads] [-l listing] diff <trace> <trace>\n");
+	return 1;
+}
+
+/* Maps and opens a trace, reporting any problem */
+static bool openTrace(const char* path, MappedFile& file, TraceReader& reader) {
+	if (!file.open(path)) {
+		fprintf(stderr, "%s: can't read file\n", path);
+		return false;
+	}
+	if (!reader.open(file.data(), file.size())) {
+		fprintf(stderr, "%s: not a trace file\n", path);
+		return false;
+	}
+	return true;
+}
+
+static bool loadProfile(const char* path, unsigned threads, TraceProfile& profile) {
+	MappedFile file;
+	TraceReader reader;
+	if (!openTrace(path, file, reader)) return false;
+	if (!TraceAnalysis::profile(reader, profile, threads)) {
+		fprintf(stderr, "%s: trace is corrupt\n", path);
+		return false;
+	}
+	return true;
+}
+
+static int stats(const char* path, unsigned threads) {
+	TraceProfile profile;
+	if (!loadProfile(path, threads, profile)) return 1;
+
+	printf("instructions  %llu\n", (unsigned long long)profile.instructions);
+	printf("cycles        %llu\n", (unsigned long long)profile.cycles);
+	if (profile.instructions > 1)
+		printf("cycles/instr  %.3f\n", (double)profile.cycles / (profile.instructions - 1));
+
+	int lowestSP = -1;
+	for (int sp = 0; sp < 0x100 && lowestSP < 0; sp++)
+		if (profile.stackDepth[sp] != 0) lowestSP = sp;
+	if (lowestSP >= 0)
+		printf("stack used    %d bytes (SP low water $%02X)\n", 0xFF - lowestSP, lowestSP);
+
+	std::vector<int> opcodes;
+	for (int opcode = 0; opcode < 0x100; opcode++)
+		if (profile.opcodeCounts[opcode] != 0) opcodes.push_back(opcode);
+	std::sort(opcodes.begin(), opcodes.end(), [&](int a, int b) { return profile.opcodeCounts[a] > profile.opcodeCounts[b]; });
+
+	printf("\nopcode        count       %%      cycles\n");
+	for (int opcode : opcodes) {
+		u64 count = profile.opcodeCounts[opcode];
+		printf("  $%02X  %12llu  %6.2f  %12llu\n", opcode, (unsigned long long)count,
+			100.0 * count / profile.instructions, (unsigned long long)profile.opcodeCycles[opcode]);
+	}
+	return 0;
+}
+
+static int hot(const char* path, size_t count, unsigned threads, const SymbolTable& symbols) {
+	TraceProfile profile;
+	if (!loadProfile(path, threads, profile)) return 1;
+	printf("address        count       %%\n");
+	for (const HotSpot& spot : TraceAnalysis::hotSpots(profile, count)) {
+		printf("  $%04X  %12llu  %6.2f", spot.address, (unsigned long long)spot.count, 100.0 * spot.count / profile.instructions);
+		if (symbols.size() != 0) printf("  %s", symbols.symbolize(spot.address).c_str());
+		putchar('\n');
+	}
+	return 0;
+}
+
+static int heatmap(const char* path, const char* outPath, unsigned threads) {
+	TraceProfile profile;
+	if (!loadProfile(path, threads, profile)) return 1;
+	FILE* out = stdout;
+	if (outPath != nullptr && fopen_s(&out, outPath, "w")) {
+		fprintf(stderr, "%s: can't write file\n", outPath);
+		return 1;
+	}
+	TraceAnalysis::writeHeatmap(profile, out);
+	if (out != stdout) fclose(out);
+	return 0;
+}
+
+static int diff(const char* pathA, const char* pathB, unsigned threads, const SymbolTable& symbols) {
+	MappedFile fileA, fileB;
+	TraceReader readerA, readerB;
+	if (!openTrace(pathA, fileA, readerA) || !openTrace(pathB, fileB, readerB)) return 1;
+
+	s64 index = TraceAnalysis::firstDivergence(readerA, readerB, threads);
+	if (index == -2) {
+		fprintf(stderr, "trace is corrupt\n");
+		return 1;
+	}
+	if (index == -1) {
+		printf("traces are identical (%llu instructions)\n", (unsigned long long)readerA.records());
+		return 0;
+	}
+
+	printf("traces differ at instruction %lld\n", (long long)index);
+	const TraceReader* readers[] = { &readerA, &readerB };
+	const char* paths[] = { pathA, pathB };
+	for (int i = 0; i < 2; i++) {
+		// Find the record through its chunk, one trace may have ended
+		const TraceReader& reader = *readers[i];
+		if ((u64)index >= reader.records()) {
+			printf("  %s: ended\n", paths[i]);
+			continue;
+		}
+		u64 start = 0;
+		size_t chunk = 0;
+		while (start + reader.chunk(chunk).records <= (u64)index) start += reader.chunk(chunk++).records;
+		std::vector<TraceRecord> records;
+		if (!reader.readChunk(chunk, records)) return 1;
+		const TraceRecord& record = records[(size_t)(index - start)];
+		printf("  %s: cycle %llu PC=$%04X op=$%02X A=$%02X X=$%02X Y=$%02X SP=$%02X P=$%02X", paths[i],
+			(unsigned long long)record.cycle, record.state.PC, record.opcode, record.state.A, record.state.X,
+			record.state.Y, record.state.SP, record.state.FLAGS.byte);
+		if (symbols.size() != 0) printf(" (%s)", symbols.symbolize(record.state.PC).c_str());
+		putchar('\n');
+	}
+	return 2;
+}
+
+int main(int argc, char** argv) {
+	unsigned threads = 0;
+	SymbolTable symbols;
+	int arg = 1;
+	while (arg + 1 < argc && argv[arg][0] == '-') {
+		if (strcmp(argv[arg], "-j") == 0) {
+			threads = (unsigned)atoi(argv[arg + 1]);
+		}
+		else if (strcmp(argv[arg], "-l") == 0) {
+			if (!symbols.load(argv[arg + 1])) {
+				fprintf(stderr, "%s: can't read file\n", argv[arg + 1]);
+				return 1;
+			}
+		}
+		else {
+			return usage();
+		}
+		arg += 2;
+	}
+	if (arg + 1 >= argc) return usage();
+
+	const char* command = argv[arg];
+	const char* path = argv[arg + 1];
+	const char* extra = arg + 2 < argc ? argv[arg + 2] : nullptr;
+	if (strcmp(command, "stats") == 0) return stats(path, threads);
+	if (strcmp(command, "hot") == 0) return hot(path, extra != nullptr ? (size_t)atoi(extra) : 20, threads, symbols);
+	if (strcmp(command, "heatmap") == 0) return heatmap(path, extra, threads);
+	if (strcmp(command, "diff") == 0 && extra != nullptr) return diff(path, extra, threads, symbols);
+	return usage();
+}